@@ -0,0 +1,152 @@
+#include "batch_cpu.h"
+#include "controller.h"
+#include "emulator.h"
+
+#include <fmt/core.h>
+
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+static constexpr std::string_view usage =
+    "usage: nesemul_batch_bench <rom> [options]\n"
+    "  --lanes K              number of instances (default 256)\n"
+    "  --cycles N             cpu cycles to run on every instance (default 1000000)\n"
+    "\n"
+    "Compares the batched lock-step cpu against K Emulator cpus stepped through their own bus.\n"
+    "Neither side runs the PPU or the APU, only NROM images are supported.\n";
+
+struct Options
+{
+    stdfs::path rom_;
+    size_t lanes_ = 256;
+    uint64_t cycles_ = 1'000'000;
+};
+
+template <std::integral T>
+static bool parse_int(std::string_view sv, T& value)
+{
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    return ec == std::errc{} && ptr == sv.data() + sv.size();
+}
+
+static bool parse_args(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--lanes" && has_value)
+        {
+            if (!parse_int(argv[++i], options.lanes_) || options.lanes_ == 0)
+                return false;
+        }
+        else if (arg == "--cycles" && has_value)
+        {
+            if (!parse_int(argv[++i], options.cycles_))
+                return false;
+        }
+        else if (!arg.starts_with("--") && options.rom_.empty())
+            options.rom_ = arg;
+        else
+            return false;
+    }
+
+    return !options.rom_.empty();
+}
+
+// Every instance holds a different set of buttons
+static byte_t lane_buttons(size_t lane)
+{
+    return static_cast<byte_t>(lane * 0x9E3779B1u >> 24);
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse_args(argc, argv, options))
+    {
+        std::cerr << usage;
+        return 2;
+    }
+
+    try
+    {
+        const size_t lanes = options.lanes_;
+        const double total_cycles = static_cast<double>(lanes) * options.cycles_;
+
+        std::vector<std::unique_ptr<Emulator>> emulators;
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            auto& emul = emulators.emplace_back(std::make_unique<Emulator>());
+            emul->set_verbose(lane == 0);
+            emul->read_rom(options.rom_.wstring());
+            emul->get_bus()->ctrl_.set_state(lane_buttons(lane));
+        }
+
+        // Batched: the lanes share the first emulator's cartridge
+        BatchCPU batch(lanes, *emulators.front()->get_cart());
+
+        std::vector<Controller> controllers(lanes);
+        for (size_t lane = 0; lane < lanes; ++lane)
+            controllers[lane].set_state(lane_buttons(lane));
+
+        batch.set_io_handlers(&controllers,
+            [](void* context, size_t lane, address_t addr)
+            {
+                byte_t value = 0;
+                (*static_cast<std::vector<Controller>*>(context))[lane].on_read(addr, value);
+                return value;
+            },
+            [](void* context, size_t lane, address_t addr, byte_t value)
+            {
+                (*static_cast<std::vector<Controller>*>(context))[lane].on_write(addr, value);
+            });
+
+        auto start = Clock::now();
+        batch.run_until(options.cycles_);
+        const double batch_ms = elapsed_ms(start);
+
+        const BatchStats& stats = batch.get_stats();
+        fmt::print("batched   {:>5} lanes: {:>9.1f} ms  {:>8.2f} Mcycles/s  lock-step {:>5.1f}%  {:.2f} groups/step\n",
+            lanes, batch_ms, total_cycles / (batch_ms * 1000.0),
+            100.0 * stats.lockstep_steps_ / std::max<uint64_t>(stats.steps_, 1),
+            static_cast<double>(stats.groups_) / std::max<uint64_t>(stats.steps_, 1));
+
+        // Reference: the same cycles on every emulator's cpu, one after the other
+        start = Clock::now();
+        for (auto& emul : emulators)
+        {
+            CPU& cpu = *emul->get_cpu();
+            while (cpu.get_state().cycle_ < options.cycles_)
+                cpu.step();
+        }
+        const double emul_ms = elapsed_ms(start);
+
+        fmt::print("emulators {:>5} x cpu: {:>9.1f} ms  {:>8.2f} Mcycles/s\n",
+            lanes, emul_ms, total_cycles / (emul_ms * 1000.0));
+
+        fmt::print("speedup: {:.2f}x\n", emul_ms / batch_ms);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,538 @@
+#include "audio_sink.h"
+#include "bus.h"
+#include "cartridge.h"
+#include "cpu.h"
+#include "emulator.h"
+#include "movie.h"
+#include "ppu.h"
+
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+namespace nl = nlohmann;
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+static constexpr std::string_view usage =
+    "usage: nesemul_bench [rom [--movie FILE]]... [options]\n"
+    "  --movie FILE           input for the preceding rom (.fm2 or the binary format)\n"
+    "  --frames N             frames per rom without a movie (default 600)\n"
+    "  --filter TEXT          only the benchmarks whose name contains TEXT\n"
+    "  --min-time S           seconds spent on each benchmark (default 0.5)\n"
+    "  --out FILE             write the results as json\n"
+    "  --baseline FILE        compare against results written by --out\n"
+    "  --tolerance PCT        slowdown reported as a regression (default 10)\n"
+    "\n"
+    "Micro benchmarks of the cpu, ppu, bus and mapper hot paths, then full frames on every rom.\n"
+    "All values are rates, higher is better. Exits with 1 when a baseline comparison regresses.\n";
+
+struct RomRun
+{
+    stdfs::path rom_;
+    stdfs::path movie_;
+};
+
+struct Options
+{
+    std::vector<RomRun> roms_;
+    uint64_t frames_ = 600;
+    std::string filter_;
+    double min_time_ = 0.5;
+    stdfs::path out_;
+    stdfs::path baseline_;
+    double tolerance_ = 10.0;
+};
+
+template <typename T>
+static bool parse_number(std::string_view sv, T& value)
+{
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    return ec == std::errc{} && ptr == sv.data() + sv.size();
+}
+
+static bool parse_args(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--movie" && has_value)
+        {
+            if (options.roms_.empty() || !options.roms_.back().movie_.empty())
+                return false;
+            options.roms_.back().movie_ = argv[++i];
+        }
+        else if (arg == "--frames" && has_value)
+        {
+            if (!parse_number(argv[++i], options.frames_) || options.frames_ == 0)
+                return false;
+        }
+        else if (arg == "--filter" && has_value)
+            options.filter_ = argv[++i];
+        else if (arg == "--min-time" && has_value)
+        {
+            if (!parse_number(argv[++i], options.min_time_) || options.min_time_ <= 0.0)
+                return false;
+        }
+        else if (arg == "--out" && has_value)
+            options.out_ = argv[++i];
+        else if (arg == "--baseline" && has_value)
+            options.baseline_ = argv[++i];
+        else if (arg == "--tolerance" && has_value)
+        {
+            if (!parse_number(argv[++i], options.tolerance_) || options.tolerance_ < 0.0)
+                return false;
+        }
+        else if (!arg.starts_with("--"))
+            options.roms_.push_back({ arg, {} });
+        else
+            return false;
+    }
+
+    return true;
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_s(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Keeps the benchmarked reads from being optimized out
+static volatile uint64_t g_sink = 0;
+
+// Runs n iterations, returns the operations done
+using BenchBody = std::function<uint64_t(uint64_t n)>;
+
+struct BenchResult
+{
+    std::string name_;
+    std::string unit_;
+    double value_ = 0.0;
+};
+
+// Batches are sized to ~10ms, the best of three slices of min_time is kept.
+static double measure(const BenchBody& body, double min_time)
+{
+    uint64_t batch = 1;
+    for (;;)
+    {
+        const auto start = Clock::now();
+        body(batch);
+        if (elapsed_s(start) >= 0.01 || batch >= (1ull << 40))
+            break;
+        batch *= 2;
+    }
+
+    constexpr int slices = 3;
+    double best = 0.0;
+
+    for (int slice = 0; slice < slices; ++slice)
+    {
+        uint64_t ops = 0;
+        const auto start = Clock::now();
+        double elapsed = 0.0;
+
+        do
+        {
+            ops += body(batch);
+            elapsed = elapsed_s(start);
+        } while (elapsed < min_time / slices);
+
+        best = std::max(best, ops / elapsed);
+    }
+
+    return best;
+}
+
+// NROM with an idle loop at $8000 and busy CHR, so the ppu and bus benchmarks have a
+// cartridge behind them without shipping a ROM.
+static stdfs::path write_synthetic_rom()
+{
+    std::vector<byte_t> image(16 + 0x4000 + 0x2000, 0);
+
+    constexpr std::array<byte_t, 8> header = { 'N', 'E', 'S', 0x1A, 1, 1, 0x01, 0 };
+    std::ranges::copy(header, image.begin());
+
+    byte_t* prg = image.data() + 16;
+    prg[0] = 0x4C; // JMP $8000
+    prg[1] = 0x00;
+    prg[2] = 0x80;
+    prg[0x3FFC] = 0x00; // reset
+    prg[0x3FFD] = 0x80;
+
+    byte_t* chr = prg + 0x4000;
+    for (size_t i = 0; i < 0x2000; ++i)
+        chr[i] = static_cast<byte_t>(i * 0x9E3779B1u >> 24);
+
+    const stdfs::path path = stdfs::temp_directory_path() / "nesemul_bench.nes";
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(image.data()), image.size());
+
+    if (!ofs)
+        throw std::runtime_error(fmt::format("Can't write {}", path.string()));
+
+    return path;
+}
+
+struct CpuMix
+{
+    std::string_view name_;
+    std::vector<byte_t> program_; // at $8000, loops forever
+};
+
+static const std::array<CpuMix, 4> cpu_mixes = { {
+    // LDA #, ADC #, EOR #, AND #, ORA zp, ASL A, INX, JMP
+    { "alu", { 0xA9, 0x55, 0x69, 0x01, 0x49, 0xAA, 0x29, 0xF0, 0x05, 0x10, 0x0A, 0xE8, 0x4C, 0x00, 0x80 } },
+    // LDA abs,X, STA zp, LDY zp, STA abs,Y, INC zp, LDA (zp),Y, INX, JMP
+    { "memory", { 0xBD, 0x00, 0x02, 0x85, 0x10, 0xA4, 0x10, 0x99, 0x00, 0x03, 0xE6, 0x20, 0xB1, 0x30, 0xE8, 0x4C, 0x00, 0x80 } },
+    // DEX, BNE -3, INY, BEQ +2, BNE -8, JMP
+    { "branch", { 0xCA, 0xD0, 0xFD, 0xC8, 0xF0, 0x02, 0xD0, 0xF8, 0x4C, 0x00, 0x80 } },
+    // JSR $800A, PHA, PHP, PLP, PLA, JMP $8000, RTS
+    { "stack", { 0x20, 0x0A, 0x80, 0x48, 0x08, 0x28, 0x68, 0x4C, 0x00, 0x80, 0x60 } },
+} };
+
+struct BusRegion
+{
+    std::string_view name_;
+    address_t first_;
+    address_t last_;
+};
+
+// $4014 (OAM DMA) and the controller ports are left out of the io region
+static constexpr std::array<BusRegion, 5> bus_regions = { {
+    { "ram", 0x0000, 0x1FFF },
+    { "ppu", 0x2000, 0x3FFF },
+    { "io", 0x4000, 0x4013 },
+    { "wram", 0x6000, 0x7FFF },
+    { "prg", 0x8000, 0xFFFF },
+} };
+
+class BenchSuite
+{
+public:
+    explicit BenchSuite(const Options& options)
+        : options_(options)
+    {
+    }
+
+    void run()
+    {
+        run_cpu_();
+
+        const stdfs::path rom = write_synthetic_rom();
+        try
+        {
+            run_ppu_(rom);
+            run_bus_(rom);
+        }
+        catch (...)
+        {
+            stdfs::remove(rom);
+            throw;
+        }
+        stdfs::remove(rom);
+
+        run_memory_map_();
+
+        for (const RomRun& run : options_.roms_)
+            run_frames_(run);
+    }
+
+    const std::vector<BenchResult>& results() const { return results_; }
+
+private:
+    bool selected_(std::string_view name) const
+    {
+        return options_.filter_.empty() || name.find(options_.filter_) != std::string_view::npos;
+    }
+
+    void add_(std::string name, std::string unit, const BenchBody& body)
+    {
+        if (!selected_(name))
+            return;
+
+        const double value = measure(body, options_.min_time_);
+        fmt::print("{:<32} {:>14.0f} {}\n", name, value, unit);
+        results_.push_back({ std::move(name), std::move(unit), value });
+    }
+
+    // The interpreter alone: the bus is a flat memory, no device is reached
+    void run_cpu_()
+    {
+        std::vector<byte_t> memory(0x10000, 0);
+
+        Emulator emul;
+        emul.set_verbose(false);
+        emul.get_bus()->set_flat_memory(memory.data());
+        CPU& cpu = *emul.get_cpu();
+
+        for (const CpuMix& mix : cpu_mixes)
+        {
+            std::ranges::fill(memory, 0);
+            std::ranges::copy(mix.program_, memory.begin() + 0x8000);
+
+            CPU_State state;
+            state.state_ = CPU_State::kFetching;
+            state.program_counter_ = 0x8000;
+            cpu.set_state(state);
+
+            add_(fmt::format("cpu_step/{}", mix.name_), "instr/s", [&](uint64_t n)
+            {
+                uint64_t instructions = 0;
+                for (uint64_t i = 0; i < n; ++i)
+                {
+                    cpu.step();
+                    instructions += cpu.get_state().state_ == CPU_State::kFetching;
+                }
+                return instructions;
+            });
+        }
+    }
+
+    void run_ppu_(const stdfs::path& rom)
+    {
+        Emulator emul;
+        emul.set_verbose(false);
+        emul.read_rom(rom.wstring());
+
+        BUS& bus = *emul.get_bus();
+        PPU& ppu = *emul.get_ppu();
+
+        // Some of every tile and palette on screen, sprites scattered
+        bus.write_cpu(0x2006, 0x20);
+        bus.write_cpu(0x2006, 0x00);
+        for (int i = 0; i < 0x400; ++i)
+            bus.write_cpu(0x2007, static_cast<byte_t>(i * 7));
+
+        bus.write_cpu(0x2006, 0x3F);
+        bus.write_cpu(0x2006, 0x00);
+        for (int i = 0; i < 0x20; ++i)
+            bus.write_cpu(0x2007, static_cast<byte_t>(i * 5 & 0x3F));
+
+        for (int i = 0; i < 0x100; ++i)
+            ppu.oam_data()[i] = static_cast<byte_t>(i * 0x9E3779B1u >> 24);
+
+        for (const bool rendering : { false, true })
+        {
+            bus.write_cpu(0x2001, rendering ? 0x1E : 0x00);
+
+            add_(fmt::format("ppu_step/{}", rendering ? "rendering" : "blank"), "dots/s", [&](uint64_t n)
+            {
+                for (uint64_t i = 0; i < n; ++i)
+                    ppu.step();
+                return n;
+            });
+        }
+
+        bus.write_cpu(0x2001, 0x1E);
+        add_("ppu_read_palette", "calls/s", [&](uint64_t n)
+        {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; ++i)
+                sum += ppu_read_palette(bus, static_cast<int>(i & 7)).get(1).r;
+            g_sink = sum;
+            return n;
+        });
+    }
+
+    void run_bus_(const stdfs::path& rom)
+    {
+        Emulator emul;
+        emul.set_verbose(false);
+        emul.read_rom(rom.wstring());
+
+        BUS& bus = *emul.get_bus();
+
+        for (const BusRegion& region : bus_regions)
+        {
+            const uint32_t span = region.last_ - region.first_ + 1;
+
+            // Strided so the whole region is visited, not one cached address
+            auto address = [&](uint64_t i) { return static_cast<address_t>(region.first_ + i * 97 % span); };
+
+            add_(fmt::format("bus_read/{}", region.name_), "reads/s", [&](uint64_t n)
+            {
+                uint64_t sum = 0;
+                for (uint64_t i = 0; i < n; ++i)
+                    sum += bus.read_cpu(address(i));
+                g_sink = sum;
+                return n;
+            });
+
+            add_(fmt::format("bus_write/{}", region.name_), "writes/s", [&](uint64_t n)
+            {
+                for (uint64_t i = 0; i < n; ++i)
+                    bus.write_cpu(address(i), static_cast<byte_t>(i));
+                return n;
+            });
+        }
+    }
+
+    // Eight 1KB banks, the CHR layout of the switching mappers
+    void run_memory_map_()
+    {
+        std::vector<byte_t> chr(0x2000);
+
+        MemoryMap map;
+        for (int bank = 0; bank < 8; ++bank)
+            map[bank] = { std::span(chr).subspan(bank * 0x400, 0x400), static_cast<address_t>(bank * 0x400) };
+
+        add_("memory_map/get_mapping", "lookups/s", [&](uint64_t n)
+        {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; ++i)
+                sum += map.get_mapping(static_cast<address_t>(i * 0x9E3779B1u >> 19)).addr_;
+            g_sink = sum;
+            return n;
+        });
+    }
+
+    void run_frames_(const RomRun& run)
+    {
+        const std::string name = fmt::format("frames/{}", run.rom_.stem().string());
+        if (!selected_(name))
+            return;
+
+        Emulator emul;
+        emul.set_verbose(false);
+        emul.set_host_break(false);
+        emul.read_rom(run.rom_.wstring());
+
+        NullAudioSink null_audio;
+        emul.set_audio_sink(&null_audio);
+
+        Movie movie;
+        if (!run.movie_.empty())
+            movie = Movie::load(run.movie_);
+
+        const uint64_t frames = run.movie_.empty() ? options_.frames_ : movie.frames_.size();
+
+        // Every pass replays the same input from power on, the best pass is kept
+        double best = 0.0;
+        const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options_.min_time_));
+
+        do
+        {
+            emul.power_on();
+            std::optional<MoviePlayer> player;
+            if (!run.movie_.empty())
+                player.emplace(movie, emul);
+
+            const auto start = Clock::now();
+            for (uint64_t frame = 0; frame < frames && !emul.is_debugging(); ++frame)
+            {
+                if (player)
+                    player->apply(emul);
+                emul.update();
+            }
+
+            if (emul.is_debugging())
+                throw std::runtime_error(fmt::format("{} halted", run.rom_.string()));
+
+            best = std::max(best, frames / elapsed_s(start));
+        } while (Clock::now() < deadline);
+
+        fmt::print("{:<32} {:>14.1f} {}\n", name, best, "frames/s");
+        results_.push_back({ name, "frames/s", best });
+    }
+
+    const Options& options_;
+    std::vector<BenchResult> results_;
+};
+
+static void write_results(const stdfs::path& path, const std::vector<BenchResult>& results)
+{
+    nl::json json;
+    json["version"] = 1;
+
+    nl::json& entries = json["results"];
+    for (const BenchResult& result : results)
+        entries[result.name_] = { { "value", result.value_ }, { "unit", result.unit_ } };
+
+    std::ofstream ofs(path);
+    ofs << json.dump(4) << '\n';
+
+    if (!ofs)
+        throw std::runtime_error(fmt::format("Can't write {}", path.string()));
+}
+
+// Prints the change of every benchmark also in the baseline, returns the number of regressions.
+static int compare_baseline(const stdfs::path& path, const std::vector<BenchResult>& results, double tolerance)
+{
+    std::ifstream ifs(path);
+    if (!ifs)
+        throw std::runtime_error(fmt::format("Can't read {}", path.string()));
+
+    const nl::json baseline = nl::json::parse(ifs);
+    const nl::json& entries = baseline.at("results");
+
+    fmt::print("\n{:<32} {:>14} {:>14} {:>8}\n", "vs baseline", "baseline", "current", "change");
+
+    int regressions = 0;
+    for (const BenchResult& result : results)
+    {
+        if (!entries.contains(result.name_))
+            continue;
+
+        const double base = entries.at(result.name_).at("value").get<double>();
+        const double change = base > 0.0 ? 100.0 * (result.value_ / base - 1.0) : 0.0;
+        const bool regressed = change < -tolerance;
+        regressions += regressed ? 1 : 0;
+
+        fmt::print("{:<32} {:>14.0f} {:>14.0f} {:>+7.1f}%{}\n", result.name_, base, result.value_, change, regressed ? "  REGRESSION" : "");
+    }
+
+    return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse_args(argc, argv, options))
+    {
+        std::cerr << usage;
+        return 2;
+    }
+
+    try
+    {
+        BenchSuite suite(options);
+        suite.run();
+
+        if (!options.out_.empty())
+            write_results(options.out_, suite.results());
+
+        if (!options.baseline_.empty())
+        {
+            const int regressions = compare_baseline(options.baseline_, suite.results(), options.tolerance_);
+            if (regressions > 0)
+            {
+                fmt::print("{} regression(s) over {:.0f}%\n", regressions, options.tolerance_);
+                return 1;
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,484 @@
+#include "audio_sink.h"
+#include "emulator.h"
+#include "hash.h"
+#include "movie.h"
+#include "run_ahead.h"
+#include "trace_diff.h"
+
+#include <fmt/core.h>
+
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+static constexpr std::string_view usage =
+    "usage: nesemul_headless <rom> [options]\n"
+    "  --frames N             number of frames to run (default 600, or the movie length)\n"
+    "  --until ADDR=VALUE     stop early once the cpu byte at ADDR equals VALUE (hex, RAM or cartridge)\n"
+    "  --ram FILE             write the 2KB internal RAM\n"
+    "  --wram FILE            write the cartridge RAM ($6000-$7FFF)\n"
+    "  --screenshot FILE      write the last frame as a binary PPM\n"
+    "  --wav FILE             capture the audio output\n"
+    "  --hash                 print hashes of the last frame and machine state\n"
+    "  --frame-hashes FILE    write the frame and state hashes of every frame (CSV)\n"
+    "  --timings FILE         write the host time and event counts per subsystem of every frame (CSV)\n"
+    "  --timings-period N     time one call in N per subsystem (default 16, 1 times every call)\n"
+    "  --perf                 read the cpu hardware counters (Linux perf_event), prints IPC and miss rates\n"
+    "  --profile N            print the N addresses the emulated cpu spent the most cycles in\n"
+    "  --folded FILE          write the emulated call stacks as folded stacks, for flame graphs\n"
+    "  --load-state FILE      start from a save state of the same ROM\n"
+    "  --save-state FILE      write a save state after the last frame\n"
+    "  --run-ahead N          show frames emulated N frames ahead, prints the added cost\n"
+    "  --run-ahead-shadow     run the speculative frames on a second instance\n"
+    "  --movie FILE           play back a movie (.fm2 or the binary format) from power on\n"
+    "  --record FILE          record the input latched by the game as a binary movie\n"
+    "  --start-pc ADDR        start at ADDR instead of the reset vector (hex, C000 for nestest)\n"
+    "  --trace FILE           write the CPU trace, one nestest style line per instruction\n"
+    "  --trace-diff FILE      compare the CPU trace with a reference log, stops at the first difference\n";
+
+struct Options
+{
+    stdfs::path rom_;
+    std::optional<uint64_t> frames_;
+    std::optional<std::pair<address_t, byte_t>> until_;
+    stdfs::path ram_;
+    stdfs::path wram_;
+    stdfs::path screenshot_;
+    stdfs::path wav_;
+    bool hash_ = false;
+    stdfs::path frame_hashes_;
+    stdfs::path timings_;
+    uint32_t timings_period_ = 16;
+    bool perf_ = false;
+    size_t profile_ = 0;
+    stdfs::path folded_;
+    stdfs::path load_state_;
+    stdfs::path save_state_;
+    int run_ahead_ = 0;
+    bool run_ahead_shadow_ = false;
+    stdfs::path movie_;
+    stdfs::path record_;
+    std::optional<address_t> start_pc_;
+    stdfs::path trace_;
+    stdfs::path trace_diff_;
+};
+
+template <std::integral T>
+static bool parse_int(std::string_view sv, T& value, int base = 10)
+{
+    if (base == 16 && sv.starts_with('$'))
+        sv.remove_prefix(1);
+
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value, base);
+    return ec == std::errc{} && ptr == sv.data() + sv.size();
+}
+
+static bool parse_args(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--frames" && has_value)
+        {
+            if (!parse_int(argv[++i], options.frames_.emplace()))
+                return false;
+        }
+        else if (arg == "--until" && has_value)
+        {
+            const std::string_view cond = argv[++i];
+            const size_t eq = cond.find('=');
+            address_t addr;
+            byte_t value;
+
+            if (eq == std::string_view::npos || !parse_int(cond.substr(0, eq), addr, 16) || !parse_int(cond.substr(eq + 1), value, 16))
+                return false;
+
+            // Reading the registers would change the machine state
+            if (addr >= 0x2000 && addr < 0x6000)
+                return false;
+
+            options.until_.emplace(addr, value);
+        }
+        else if (arg == "--ram" && has_value)
+            options.ram_ = argv[++i];
+        else if (arg == "--wram" && has_value)
+            options.wram_ = argv[++i];
+        else if (arg == "--screenshot" && has_value)
+            options.screenshot_ = argv[++i];
+        else if (arg == "--wav" && has_value)
+            options.wav_ = argv[++i];
+        else if (arg == "--hash")
+            options.hash_ = true;
+        else if (arg == "--frame-hashes" && has_value)
+            options.frame_hashes_ = argv[++i];
+        else if (arg == "--timings" && has_value)
+            options.timings_ = argv[++i];
+        else if (arg == "--timings-period" && has_value)
+        {
+            if (!parse_int(argv[++i], options.timings_period_) || options.timings_period_ == 0)
+                return false;
+        }
+        else if (arg == "--perf")
+            options.perf_ = true;
+        else if (arg == "--profile" && has_value)
+        {
+            if (!parse_int(argv[++i], options.profile_) || options.profile_ == 0)
+                return false;
+        }
+        else if (arg == "--folded" && has_value)
+            options.folded_ = argv[++i];
+        else if (arg == "--load-state" && has_value)
+            options.load_state_ = argv[++i];
+        else if (arg == "--save-state" && has_value)
+            options.save_state_ = argv[++i];
+        else if (arg == "--run-ahead" && has_value)
+        {
+            if (!parse_int(argv[++i], options.run_ahead_))
+                return false;
+        }
+        else if (arg == "--run-ahead-shadow")
+            options.run_ahead_shadow_ = true;
+        else if (arg == "--movie" && has_value)
+            options.movie_ = argv[++i];
+        else if (arg == "--record" && has_value)
+            options.record_ = argv[++i];
+        else if (arg == "--start-pc" && has_value)
+        {
+            if (!parse_int(argv[++i], options.start_pc_.emplace(), 16))
+                return false;
+        }
+        else if (arg == "--trace" && has_value)
+            options.trace_ = argv[++i];
+        else if (arg == "--trace-diff" && has_value)
+            options.trace_diff_ = argv[++i];
+        else if (!arg.starts_with("--") && options.rom_.empty())
+            options.rom_ = arg;
+        else
+            return false;
+    }
+
+    // A single tracer
+    if (!options.trace_.empty() && !options.trace_diff_.empty())
+        return false;
+
+    return !options.rom_.empty();
+}
+
+// Streams the CPU trace to a file
+class TraceWriter final : public CpuTracer
+{
+public:
+    explicit TraceWriter(std::ostream& os)
+        : os_(os)
+    {
+    }
+
+    void on_instruction(std::string_view line) override { os_ << line << '\n'; }
+
+private:
+    std::ostream& os_;
+};
+
+static bool write_file(const stdfs::path& filepath, const void* data, size_t size)
+{
+    std::ofstream ofs(filepath, std::ios::binary);
+    if (!ofs.is_open())
+        return false;
+
+    ofs.write(static_cast<const char*>(data), size);
+    return !ofs.bad();
+}
+
+static bool write_ppm(const stdfs::path& filepath, const PPU::Output& image)
+{
+    std::ofstream ofs(filepath, std::ios::binary);
+    if (!ofs.is_open())
+        return false;
+
+    ofs << "P6\n" << PPU::Output::Width << ' ' << PPU::Output::Height << "\n255\n";
+
+    // The output is RGBA, PPM wants RGB.
+    const byte_t* pixels = image.data();
+    for (size_t i = 0; i < image.size(); i += sizeof(Color))
+        ofs.write(reinterpret_cast<const char*>(pixels + i), 3);
+
+    return !ofs.bad();
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse_args(argc, argv, options))
+    {
+        std::cerr << usage;
+        return 2;
+    }
+
+    int exit_code = 0;
+
+    try
+    {
+        Emulator emul;
+        emul.set_host_break(false);
+        emul.read_rom(options.rom_.wstring());
+
+        if (!options.load_state_.empty())
+        {
+            std::ifstream ifs(options.load_state_, std::ios::binary);
+            if (!ifs.is_open())
+                throw std::runtime_error(fmt::format("Can't read {}", options.load_state_.string()));
+
+            const std::vector<char> blob { std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+            emul.load_state({ reinterpret_cast<const byte_t*>(blob.data()), blob.size() });
+        }
+
+        if (options.start_pc_)
+            emul.get_cpu()->set_program_counter(*options.start_pc_);
+
+        std::ofstream trace_file;
+        std::optional<TraceWriter> trace_writer;
+        if (!options.trace_.empty())
+        {
+            trace_file.open(options.trace_);
+            if (!trace_file.is_open())
+                throw std::runtime_error(fmt::format("Can't write {}", options.trace_.string()));
+
+            emul.get_cpu()->set_tracer(&trace_writer.emplace(trace_file));
+        }
+
+        std::ifstream trace_reference;
+        std::optional<TraceDiff> trace_diff;
+        if (!options.trace_diff_.empty())
+        {
+            trace_reference.open(options.trace_diff_);
+            if (!trace_reference.is_open())
+                throw std::runtime_error(fmt::format("Can't read {}", options.trace_diff_.string()));
+
+            trace_diff.emplace(trace_reference);
+            trace_diff->set_on_stop([&emul] { emul.debugger_.break_now(); });
+            emul.get_cpu()->set_tracer(&*trace_diff);
+        }
+
+        NullAudioSink null_audio;
+        WavAudioSink wav_audio;
+
+        if (!options.wav_.empty())
+        {
+            if (!wav_audio.open(options.wav_))
+                throw std::runtime_error(fmt::format("Can't open {}", options.wav_.string()));
+
+            emul.set_audio_sink(&wav_audio);
+        }
+        else
+        {
+            emul.set_audio_sink(&null_audio);
+        }
+
+        BUS& bus = *emul.get_bus();
+        RunAhead run_ahead(options.run_ahead_, options.run_ahead_shadow_);
+
+        Movie movie;
+        std::optional<MoviePlayer> player;
+        if (!options.movie_.empty())
+        {
+            movie = Movie::load(options.movie_);
+            player.emplace(movie, emul);
+        }
+
+        MovieRecorder recorder;
+        recorder.begin(emul);
+
+        const uint64_t frames = options.frames_.value_or(player ? movie.frames_.size() : 600);
+
+        std::ofstream frame_hashes;
+        if (!options.frame_hashes_.empty())
+        {
+            frame_hashes.open(options.frame_hashes_);
+            if (!frame_hashes.is_open())
+                throw std::runtime_error(fmt::format("Can't write {}", options.frame_hashes_.string()));
+
+            frame_hashes << "frame,output,state\n";
+            emul.set_frame_hashing(true);
+        }
+
+        Instrumentation& instrumentation = emul.get_instrumentation();
+        if (options.perf_ && !instrumentation.set_perf_counters(true))
+            fmt::print("perf: counters unavailable, {}\n", instrumentation.perf_error());
+
+        std::ofstream timings;
+        if (!options.timings_.empty())
+        {
+            timings.open(options.timings_);
+            if (!timings.is_open())
+                throw std::runtime_error(fmt::format("Can't write {}", options.timings_.string()));
+
+            Instrumentation::write_csv_header(timings, instrumentation.has_perf_counters());
+        }
+
+        if (timings.is_open() || instrumentation.has_perf_counters())
+        {
+            instrumentation.set_sample_period(options.timings_period_);
+            emul.set_instrumented(true);
+        }
+
+        if (options.profile_ > 0)
+            emul.set_profiling(true);
+
+        if (!options.folded_.empty())
+            emul.set_call_profiling(true);
+
+        PerfSample perf_total;
+        std::array<PerfSample, subsystem_count> perf_subsystems;
+
+        uint64_t frame = 0;
+        while (frame < frames)
+        {
+            if (player)
+                player->apply(emul);
+
+            run_ahead.update(emul);
+            recorder.on_frame(emul);
+            ++frame;
+
+            if (frame_hashes.is_open())
+            {
+                const FrameHashes& hashes = emul.get_frame_hashes();
+                frame_hashes << fmt::format("{},{:016x},{:016x}\n", hashes.frame_, hashes.output_, hashes.state_);
+            }
+
+            const FrameCounters& counters = instrumentation.last_frame();
+            if (timings.is_open())
+                Instrumentation::write_csv_row(timings, counters);
+
+            if (counters.has_perf_)
+            {
+                perf_total += counters.perf_;
+                for (size_t i = 0; i < subsystem_count; ++i)
+                    perf_subsystems[i] += counters.subsystem_perf_[i];
+            }
+
+            byte_t until_value;
+            if (options.until_ && bus.peek_cpu(options.until_->first, until_value) && until_value == options.until_->second)
+                break;
+
+            if (trace_diff && trace_diff->is_stopped())
+                break;
+
+            if (emul.is_debugging())
+            {
+                const address_t pc = emul.get_cpu()->get_state().program_counter_;
+                throw std::runtime_error(fmt::format("Emulation stopped at ${:04X} on frame {}: {}", pc, frame, emul.get_error()));
+            }
+        }
+
+        emul.set_audio_sink(nullptr);
+        wav_audio.close();
+
+        fmt::print("frames: {}\n", frame);
+
+        if (trace_diff)
+        {
+            trace_diff->print_report(std::cout);
+            exit_code = trace_diff->has_diverged() ? 1 : 0;
+        }
+
+        if (!options.record_.empty())
+        {
+            recorder.movie().save(options.record_);
+            fmt::print("recorded: {} frames, {} lag\n", recorder.movie().frames_.size(), recorder.lag_frames());
+        }
+
+        if (run_ahead.get_frames() > 0)
+        {
+            const RunAheadStats stats = run_ahead.get_stats();
+            fmt::print("run-ahead: {} frames{}, frame {:.1f} us, added {:.1f} us, shadow {:.1f} us, failures {}\n",
+                stats.frames_, stats.shadow_ ? " (shadow)" : "", stats.frame_us_, stats.cost_us_, stats.shadow_us_, stats.failures_);
+        }
+
+        if (instrumentation.has_perf_counters())
+        {
+            auto print_perf = [](std::string_view name, const PerfSample& perf)
+            {
+                fmt::print("perf {:<5} IPC {:.2f}, branch misses {:.2f}/kinstr, L1D misses {:.2f}/kinstr, {} instructions\n",
+                    name, perf.ipc(), perf.branch_mpki(), perf.l1d_mpki(), perf[PerfEvent::Instructions]);
+            };
+
+            print_perf("frame", perf_total);
+
+            if (!instrumentation.has_subsystem_perf())
+                fmt::print("perf: no rdpmc access, the subsystems are not counted\n");
+
+            for (size_t i = 0; i < subsystem_count && instrumentation.has_subsystem_perf(); ++i)
+                print_perf(subsystem_name(static_cast<Subsystem>(i)), perf_subsystems[i]);
+        }
+
+        if (options.profile_ > 0)
+        {
+            const HotspotProfiler& profiler = emul.get_profiler();
+            const uint64_t total = profiler.total_cycles();
+            fmt::print("profile: {} cycles, {} DMA\n", total, profiler.dma_cycles());
+
+            for (const HotSpot& spot : profiler.top(options.profile_))
+            {
+                fmt::print("  {:04X} bank {:>3} {:>12} cycles {:6.2f}% {:>10} executed\n",
+                    spot.pc_, spot.bank_ >= 0 ? fmt::format("{:02X}", spot.bank_) : "--",
+                    spot.cycles_, 100.0 * spot.cycles_ / total, spot.count_);
+            }
+        }
+
+        if (!options.folded_.empty())
+        {
+            std::ofstream folded(options.folded_);
+            emul.get_call_profiler().write_folded(folded);
+
+            if (!folded)
+                throw std::runtime_error(fmt::format("Can't write {}", options.folded_.string()));
+
+            fmt::print("call profile: {} cycles, {} calling contexts\n", emul.get_call_profiler().total_cycles(), emul.get_call_profiler().nodes().size());
+        }
+
+        if (options.hash_)
+        {
+            const PPU::Output& output = emul.get_ppu()->output();
+            fmt::print("frame hash: {:016x}\n", hash_bytes({ output.data(), output.size() }));
+            fmt::print("state hash: {:016x}\n", emul.hash_state());
+        }
+
+        if (!options.ram_.empty() && !write_file(options.ram_, emul.get_ram()->data(), 0x800))
+            throw std::runtime_error(fmt::format("Can't write {}", options.ram_.string()));
+
+        if (!options.wram_.empty())
+        {
+            const std::array<byte_t, 0x2000>& wram = bus.cart_->wram_;
+            if (!write_file(options.wram_, wram.data(), wram.size()))
+                throw std::runtime_error(fmt::format("Can't write {}", options.wram_.string()));
+        }
+
+        if (!options.save_state_.empty())
+        {
+            std::vector<byte_t> blob;
+            emul.save_state(blob);
+            if (!write_file(options.save_state_, blob.data(), blob.size()))
+                throw std::runtime_error(fmt::format("Can't write {}", options.save_state_.string()));
+        }
+
+        if (!options.screenshot_.empty() && !write_ppm(options.screenshot_, emul.get_ppu()->output()))
+            throw std::runtime_error(fmt::format("Can't write {}", options.screenshot_.string()));
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return exit_code;
+}
@@ -1,10 +1,15 @@
-#include "clock.h"
 #include "emulator.h"
+#include "frame_pacer.h"
+#include "rewind.h"
+#include "run_ahead.h"
 #include "platform/platform_defines.h"
+#include "sfml_audio.h"
 #include "sfml_renderer.h"
 #include "ui/global.h"
 
+#include <cstdlib>
 #include <iostream>
+#include <string_view>
 
 int main(int argc, char* argv[])
 {
@@ -16,21 +21,73 @@ int main(int argc, char* argv[])
         Emulator emul;
         SFMLRenderer renderer(&emul);
 
-        Timer timer(sixtieth_us);
+        SFMLAudioSink audio;
+        emul.set_audio_sink(&audio);
+        audio.play();
+
+        // --run-ahead N [--run-ahead-shadow] [--pacing audio|timer|vsync]
+        RunAhead run_ahead;
+        FramePacer::Mode pacing = FramePacer::Mode::Audio;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+            if (arg == "--run-ahead" && i + 1 < argc)
+                run_ahead.set_frames(std::atoi(argv[++i]));
+            else if (arg == "--run-ahead-shadow")
+                run_ahead.set_shadow(true);
+            else if (arg == "--pacing" && i + 1 < argc)
+            {
+                const std::string_view mode = argv[++i];
+                if (mode == "timer")
+                    pacing = FramePacer::Mode::Timer;
+                else if (mode == "vsync")
+                    pacing = FramePacer::Mode::VSync;
+            }
+        }
+
+        // The pacer doesn't block in VSync mode, presenting the frame does
+        renderer.set_vsync(pacing == FramePacer::Mode::VSync);
+
+        FramePacer pacer(&emul, pacing);
+        RewindBuffer rewind;
 
         for (;;)
         {
-            if (timer.expired())
+            pacer.wait();
+
+            if (renderer.is_rewinding())
             {
-                emul.update();
-                if (!renderer.update())
-                    break;
+                // The picture is not part of the snapshot, emulate a frame to redraw it
+                if (rewind.step_back(emul))
+                    emul.update();
             }
+            else
+            {
+                run_ahead.update(emul);
+                rewind.on_frame(emul);
+            }
+            pacer.frame_done();
 
-            time_unit remaining_us = std::max(sixtieth_us - timer.elapsed_us(), 0ll);
-            sf::sleep(sf::microseconds(remaining_us));
+            if (!renderer.update())
+                break;
         }
 
+        // Over the last frames
+        const FrameTimingStats pacing_stats = pacer.get_stats();
+        std::cout << "pacing: frame " << pacing_stats.mean_us_ << " us, stddev " << pacing_stats.stddev_us_ << " us, max "
+                  << pacing_stats.max_us_ << " us, " << pacing_stats.late_frames_ << " late frames, audio rate ratio "
+                  << pacing_stats.rate_adjust_ << std::endl;
+
+        if (run_ahead.get_frames() > 0)
+        {
+            const RunAheadStats stats = run_ahead.get_stats();
+            std::cout << "run-ahead: " << stats.frames_ << " frames, added " << stats.cost_us_ << " us per frame ("
+                      << stats.shadow_us_ << " us on the shadow thread)" << std::endl;
+        }
+
+        audio.stop();
+        emul.set_audio_sink(nullptr);
+
         if (emul.get_cart() && emul.get_cart()->battery_)
             emul.get_cart()->battery_->save_now();
 
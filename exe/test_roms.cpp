@@ -0,0 +1,122 @@
+#include "test_rom_runner.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+static constexpr std::string_view usage =
+    "usage: nesemul_test_roms <rom or directory>... [options]\n"
+    "  --jobs N               ROMs run in parallel (default: one per core)\n"
+    "  --frames N             emulated frames before a ROM times out (default 3600)\n"
+    "  --timeout S            wall clock seconds before a ROM times out (default 60)\n"
+    "  --junit FILE           write a JUnit XML report\n"
+    "\n"
+    "Directories are searched recursively for .nes files. nestest.nes runs in automation mode,\n"
+    "the other ROMs are expected to report through the blargg $6000 protocol.\n";
+
+struct Options
+{
+    std::vector<stdfs::path> inputs_;
+    TestRomConfig config_;
+    stdfs::path junit_;
+};
+
+template <typename T>
+static bool parse_number(std::string_view sv, T& value)
+{
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    return ec == std::errc{} && ptr == sv.data() + sv.size();
+}
+
+static bool parse_args(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--jobs" && has_value)
+        {
+            if (!parse_number(argv[++i], options.config_.threads_))
+                return false;
+        }
+        else if (arg == "--frames" && has_value)
+        {
+            if (!parse_number(argv[++i], options.config_.max_frames_))
+                return false;
+        }
+        else if (arg == "--timeout" && has_value)
+        {
+            if (!parse_number(argv[++i], options.config_.timeout_s_))
+                return false;
+        }
+        else if (arg == "--junit" && has_value)
+            options.junit_ = argv[++i];
+        else if (!arg.starts_with("--"))
+            options.inputs_.push_back(arg);
+        else
+            return false;
+    }
+
+    return !options.inputs_.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse_args(argc, argv, options))
+    {
+        std::cerr << usage;
+        return 2;
+    }
+
+    try
+    {
+        std::vector<stdfs::path> roms;
+        for (const stdfs::path& input : options.inputs_)
+        {
+            if (stdfs::is_directory(input))
+            {
+                const std::vector<stdfs::path> found = TestRomRunner::find_roms(input);
+                roms.insert(roms.end(), found.begin(), found.end());
+            }
+            else
+            {
+                roms.push_back(input);
+            }
+        }
+
+        if (roms.empty())
+            throw std::runtime_error("No ROM found");
+
+        const TestRomRunner runner(options.config_);
+        const std::vector<TestRomResult> results = runner.run(roms);
+
+        TestRomRunner::print_summary(std::cout, results);
+
+        if (!options.junit_.empty())
+        {
+            std::ofstream ofs(options.junit_);
+            if (!ofs.is_open())
+                throw std::runtime_error(fmt::format("Can't write {}", options.junit_.string()));
+
+            TestRomRunner::write_junit(ofs, results, "nesemul_test_roms");
+        }
+
+        const bool all_passed = std::ranges::all_of(results, [](const TestRomResult& r) { return r.status_ == TestRomStatus::Passed; });
+        return all_passed ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -1,127 +1,357 @@
 #include "apu.h"
-#include "emulator.h"
+#include "bus.h"
+#include "cpu.h"
+#include "save_state.h"
+
+#include <algorithm>
+#include <array>
 
 constexpr byte_t length_table[] = { 11, 254, 20,  2, 40,  4, 80,  6, 160,  8, 60, 10, 14, 12, 26, 14,
                                     12,  16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30 };
 
+constexpr bool duty_table[4][8] = {
+    { 0, 1, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 1, 0, 0, 0, 0, 0 },
+    { 0, 1, 1, 1, 1, 0, 0, 0 },
+    { 1, 0, 0, 1, 1, 1, 1, 1 },
+};
+
+constexpr byte_t triangle_table[] = { 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+                                       0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 };
+
+constexpr uint16_t noise_period_table[] = { 4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068 };
+
 constexpr uint16_t dmc_rate_table[] = { 428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54 };
 
-enum : uint32_t
+constexpr double cpu_clock_rate = 1789773.0; // NTSC
+
+enum FrameAction : uint8_t
 {
-    SEQ_STEP_1 = 3728,
-    SEQ_STEP_2 = 7456,
-    SEQ_STEP_3 = 11185,
-    SEQ_STEP_4 = 14914,
-    SEQ_STEP_5 = 18640,
+    kQuarterFrame = 1 << 0,
+    kHalfFrame = 1 << 1,
+    kFrameIrqFlag = 1 << 2,
+    kFrameIrq = 1 << 3,
+    kRestart = 1 << 4,
+};
+
+struct SequencerStep
+{
+    uint32_t cycle_; // cpu cycles from the start of the sequence
+    uint8_t actions_;
+};
+
+constexpr SequencerStep four_steps_sequence[] = {
+    { 7457, kQuarterFrame },
+    { 14913, kHalfFrame },
+    { 22371, kQuarterFrame },
+    { 29828, kFrameIrqFlag },
+    { 29829, kFrameIrqFlag | kHalfFrame | kFrameIrq },
+    { 29830, kRestart },
+};
+
+constexpr SequencerStep five_steps_sequence[] = {
+    { 7457, kQuarterFrame },
+    { 14913, kHalfFrame },
+    { 22371, kQuarterFrame },
+    { 37281, kHalfFrame },
+    { 37282, kRestart },
 };
 
+static const SequencerStep& sequencer_step(bool five_steps, uint8_t idx)
+{
+    return five_steps ? five_steps_sequence[idx] : four_steps_sequence[idx];
+}
+
+// Nonlinear mixer lookup tables (nesdev), scaled to the 16-bit output range.
+// pulse_table is indexed by pulse1 + pulse2, tnd_table by 3 * triangle + 2 * noise + dmc.
+constexpr double mixer_amplitude = 0x7000;
+
+constexpr std::array<int16_t, 31> pulse_table = [] {
+    std::array<int16_t, 31> table {};
+    for (int i = 1; i < 31; ++i)
+        table[i] = static_cast<int16_t>(95.52 / (8128.0 / i + 100.0) * mixer_amplitude);
+    return table;
+}();
+
+constexpr std::array<int16_t, 203> tnd_table = [] {
+    std::array<int16_t, 203> table {};
+    for (int i = 1; i < 203; ++i)
+        table[i] = static_cast<int16_t>(163.67 / (24329.0 / i + 100.0) * mixer_amplitude);
+    return table;
+}();
+
+APU::APU()
+{
+    pulse1_.ones_complement_ = true;
+    set_sample_rate(44100);
+}
+
 void APU::reset()
 {
-    cycle_ = 0;
-    odd_cycle_ = false;
+    sequence_start_ = now_();
+    sequence_reset_ = no_event;
+    sequence_step_ = 0;
     five_steps_sequence_ = false;
+    five_steps_pending_ = false;
     irq_inhibit_ = false;
     frame_irq_ = false;
-    sequencer_change_delay_ = 0;
 
     pulse1_.on_ctrl(false);
     pulse2_.on_ctrl(false);
     triangle_.on_ctrl(false);
     noise_.on_ctrl(false);
     dmc_.on_ctrl(false);
+    dmc_.output_level_ = 0;
+
+    // The cpu cycle count restarts, the output unit too: update_timers_ rearms its timer
+    dmc_.next_clock_ = timer_parked;
+    dmc_.shift_ = 0;
+    dmc_.bits_remaining_ = 8;
+    dmc_.silence_ = true;
+    dmc_.buffer_empty_ = true;
+
+    blip_.clear();
+    frame_start_ = sequence_start_;
+    levels_ = 0;
+    amplitude_ = 0;
+    output_amplitude_ = 0;
+    update_timers_(sequence_start_);
+
+    schedule_();
 }
 
-void APU::step()
+void APU::serialize_state(StateStream& state)
 {
-    bool quarter = false;
-    bool half = false;
+    state.process(pulse1_);
+    state.process(pulse2_);
+    state.process(triangle_);
+    state.process(noise_);
+    state.process(dmc_);
+
+    state.process(sequence_start_);
+    state.process(sequence_reset_);
+    state.process(next_event_);
+    state.process(sequence_step_);
+    state.process(five_steps_sequence_);
+    state.process(five_steps_pending_);
+    state.process(irq_inhibit_);
+    state.process(frame_irq_);
+
+    state.process(frame_start_);
+    state.process(levels_);
+    state.process(amplitude_);
+
+    if (!state.is_writing())
+    {
+        // The output goes on from its current level to the restored one, the pending samples are kept
+        blip_.add_delta(0, amplitude_ - output_amplitude_);
+        output_amplitude_ = amplitude_;
+    }
+}
 
-    if (!five_steps_sequence_ && cycle_ == SEQ_STEP_4)
-        frame_irq_ = !irq_inhibit_;
+void APU::catch_up(uint64_t cpu_cycle)
+{
+    while (next_event_ <= cpu_cycle)
+        run_event_();
+}
 
-    if (odd_cycle_)
+uint64_t APU::now_() const
+{
+    return bus_->cpu_.get_state().cycle_;
+}
+
+void APU::run_event_()
+{
+    const SequencerStep& step = sequencer_step(five_steps_sequence_, sequence_step_);
+    const uint64_t step_cycle = sequence_start_ + step.cycle_;
+    const uint64_t event_cycle = std::min(step_cycle, sequence_reset_);
+
+    if (next_event_ < event_cycle)
+    {
+        // A DMC fetch: the sample byte is read from the bank mapped now and the IRQ is on time
+        run_channels_(next_event_);
+        update_timers_(next_event_);
+        schedule_();
+        return;
+    }
+
+    run_channels_(event_cycle);
+
+    if (step_cycle <= sequence_reset_)
     {
-        if (!five_steps_sequence_ && cycle_ >= SEQ_STEP_4 + 1)
-            cycle_ = 0;
-        else if (five_steps_sequence_ && cycle_ >= SEQ_STEP_5 + 1)
-            cycle_ = 0;
+        if (step.actions_ & kFrameIrqFlag)
+            frame_irq_ = !irq_inhibit_;
 
-        switch (cycle_)
+        if ((step.actions_ & kFrameIrq) && frame_irq_)
+            bus_->cpu_.pull_irq();
+
+        if (step.actions_ & (kQuarterFrame | kHalfFrame))
+            clock_channels_(step.actions_ & kHalfFrame);
+
+        if (step.actions_ & kRestart)
         {
-        case SEQ_STEP_2: 
-        case SEQ_STEP_5: 
-            half = true;
-            break;
+            sequence_start_ = step_cycle;
+            sequence_step_ = 0;
+        }
+        else
+        {
+            ++sequence_step_;
+        }
+    }
+    else
+    {
+        // Delayed effect of a $4017 write, 5-steps mode clocks the channels immediately.
+        sequence_start_ = sequence_reset_;
+        sequence_reset_ = no_event;
+        sequence_step_ = 0;
+        five_steps_sequence_ = five_steps_pending_;
+
+        if (five_steps_sequence_)
+            clock_channels_(true);
+    }
 
-        case SEQ_STEP_1: 
-        case SEQ_STEP_3: 
-            quarter = true;
-            break;
+    update_timers_(event_cycle);
+    update_output_(event_cycle);
+
+    schedule_();
+}
+
+void APU::schedule_()
+{
+    const SequencerStep& step = sequencer_step(five_steps_sequence_, sequence_step_);
+    next_event_ = std::min({ sequence_start_ + step.cycle_, sequence_reset_, dmc_.next_fetch() });
+}
+
+void APU::clock_channels_(bool half_frame)
+{
+    pulse1_.on_clock(half_frame);
+    pulse2_.on_clock(half_frame);
+    triangle_.on_clock(half_frame);
+    noise_.on_clock(half_frame);
+    dmc_.on_clock(half_frame);
+}
 
-        case SEQ_STEP_4:
-            if (!five_steps_sequence_)
-            {
-                half = true;
-                if (frame_irq_)
-                    Emulator::instance()->get_cpu()->pull_irq();
-            }
+void APU::run_channels_(uint64_t cpu_cycle)
+{
+    for (;;)
+    {
+        const uint64_t next = std::min({ pulse1_.next_clock_, pulse2_.next_clock_, triangle_.next_clock_, noise_.next_clock_, dmc_.next_clock_ });
+        if (next > cpu_cycle)
             break;
-        }
-        
-        ++cycle_;
+
+        if (pulse1_.next_clock_ == next)
+            pulse1_.clock_timer();
+
+        if (pulse2_.next_clock_ == next)
+            pulse2_.clock_timer();
+
+        if (triangle_.next_clock_ == next)
+            triangle_.clock_timer();
+
+        if (noise_.next_clock_ == next)
+            noise_.clock_timer();
+
+        if (dmc_.next_clock_ == next)
+            dmc_.clock_timer(*bus_);
+
+        update_output_(next);
     }
+}
+
+void APU::update_timers_(uint64_t cpu_cycle)
+{
+    pulse1_.update_timer(cpu_cycle);
+    pulse2_.update_timer(cpu_cycle);
+    triangle_.update_timer(cpu_cycle);
+    noise_.update_timer(cpu_cycle);
+    dmc_.update_timer(cpu_cycle);
+}
 
-    if (sequencer_change_delay_ > 0 && --sequencer_change_delay_ == 0)
+void APU::update_output_(uint64_t cpu_cycle)
+{
+    const uint32_t pulse_idx = pulse1_.output() + pulse2_.output();
+    const uint32_t tnd_idx = 3 * triangle_.output() + 2 * noise_.output() + dmc_.output();
+
+    const uint32_t levels = pulse_idx | (tnd_idx << 8);
+    if (levels == levels_)
+        return;
+
+    levels_ = levels;
+
+    amplitude_ = pulse_table[pulse_idx] + tnd_table[tnd_idx];
+
+    if (!muted_) [[likely]]
     {
-        half |= five_steps_sequence_;
-        cycle_ = 0;
+        blip_.add_delta(static_cast<uint32_t>(cpu_cycle - frame_start_), amplitude_ - output_amplitude_);
+        output_amplitude_ = amplitude_;
     }
+}
+
+void APU::set_sample_rate(int sample_rate)
+{
+    blip_.set_rates(cpu_clock_rate, sample_rate);
+    levels_ = 0;
+    amplitude_ = 0;
+    output_amplitude_ = 0;
+}
+
+void APU::set_rate_adjust(double ratio)
+{
+    blip_.set_clock_rate(cpu_clock_rate / ratio);
+}
 
-    if (quarter || half)
+void APU::end_frame(uint64_t cpu_cycle)
+{
+    catch_up(cpu_cycle);
+    run_channels_(cpu_cycle);
+
+    if (muted_)
     {
-        pulse1_.on_clock(half);
-        pulse2_.on_clock(half);
-        triangle_.on_clock(half);
-        noise_.on_clock(half);
-        dmc_.on_clock(half);
+        frame_start_ = cpu_cycle;
+        return;
     }
 
-    odd_cycle_ = !odd_cycle_;
+    blip_.end_frame(static_cast<uint32_t>(cpu_cycle - frame_start_));
+    frame_start_ = cpu_cycle;
+
+    // Keep at most a few frames of latency when nobody drains the samples.
+    const int max_pending = blip_.sample_rate() / 20;
+    if (blip_.samples_avail() > max_pending)
+        blip_.remove_samples(blip_.samples_avail() - max_pending);
 }
 
 bool APU::on_write(address_t addr, byte_t value)
 {
+    if (addr < 0x4000 || addr > 0x4017)
+        return false;
+
+    const uint64_t now = now_();
+    catch_up(now);
+    run_channels_(now);
+
+    bool handled = true;
+
     if (addr >= 0x4000 && addr <= 0x4003)
     {
         pulse1_.on_write(addr, value);
-        return true;
     }
-
-    if  (addr >= 0x4004 && addr <= 0x4007)
+    else if (addr >= 0x4004 && addr <= 0x4007)
     {
         pulse2_.on_write(addr, value);
-        return true;
     }
-
-    if (addr >= 0x4008 && addr <= 0x400B)
+    else if (addr >= 0x4008 && addr <= 0x400B)
     {
         triangle_.on_write(addr, value);
-        return true;
     }
-
-    if (addr >= 0x400C && addr <= 0x400F)
+    else if (addr >= 0x400C && addr <= 0x400F)
     {
         noise_.on_write(addr, value);
-        return true;
     }
-
-    if (addr >= 0x4010 && addr <= 0x4013)
+    else if (addr >= 0x4010 && addr <= 0x4013)
     {
         dmc_.on_write(addr, value);
-        return true;
     }
-    
-    if (addr == 0x4015)
+    else if (addr == 0x4015)
     {
         Control ctrl;
         ctrl.set(value);
@@ -131,39 +361,51 @@ bool APU::on_write(address_t addr, byte_t value)
         triangle_.on_ctrl(ctrl.triangle);
         noise_.on_ctrl(ctrl.noise);
         dmc_.on_ctrl(ctrl.dmc);
-
-        return true;
     }
-
-    if (addr == 0x4017)
+    else if (addr == 0x4017)
     {
-        // Write is delayed by 3 or 4 CPU cycle depending on odd_cycle_.
-        five_steps_sequence_ = value & 0xB0;
+        // The sequencer restarts 3 or 4 cpu cycles after the write, always on an even cycle.
+        five_steps_pending_ = value & 0x80;
         irq_inhibit_ = value & 0x40;
 
         if (irq_inhibit_)
             frame_irq_ = false;
 
-        sequencer_change_delay_ = 3 + (odd_cycle_) ? 1 : 0;
+        sequence_reset_ = now + ((now & 0x1) ? 3 : 4);
+    }
+    else
+    {
+        handled = false;
+    }
 
-         return true;
+    if (handled)
+    {
+        update_timers_(now);
+        update_output_(now);
+        schedule_();
     }
 
-    return false;
+    return handled;
 }
 
 bool APU::on_read(address_t addr, byte_t& value)
 {
     if (addr == 0x4015)
     {
+        const uint64_t now = now_();
+        catch_up(now);
+        run_channels_(now);
+
         Control status;
         status.pulse1 = (pulse1_.len_counter_ > 0);
         status.pulse2 = (pulse2_.len_counter_ > 0);
         status.triangle = (triangle_.len_counter_ > 0);
         status.noise = (noise_.len_counter_ > 0);
-        status.dmc = dmc_.enabled_;
+        status.dmc = (dmc_.bytes_remaining_ > 0);
+        status.dummy = false;
 
         status.frame_int = frame_irq_;
+        status.dmc_int = dmc_.irq_flag_;
         frame_irq_ = false;
 
         value = status.get();
@@ -173,12 +415,56 @@ bool APU::on_read(address_t addr, byte_t& value)
     return false;
 }
 
+void Envelope::on_clock()
+{
+    if (start_)
+    {
+        start_ = false;
+        decay_ = 15;
+        divider_ = volume_;
+    }
+    else if (divider_ > 0)
+    {
+        --divider_;
+    }
+    else
+    {
+        divider_ = volume_;
+        if (decay_ > 0)
+            --decay_;
+        else if (loop_)
+            decay_ = 15;
+    }
+}
+
+void Envelope::on_write(byte_t value)
+{
+    loop_ = value & 0x20;
+    constant_ = value & 0x10;
+    volume_ = value & 0x0F;
+}
+
 void PulseChannel::on_clock(bool half_frame)
 {
+    envelope_.on_clock();
+
     if (half_frame)
     {
         if (len_counter_ > 0 && !len_halted_)
             --len_counter_;
+
+        if (sweep_divider_ == 0 && sweep_enabled_ && sweep_shift_ > 0 && !is_muted())
+            timer_period_ = sweep_target();
+
+        if (sweep_divider_ == 0 || sweep_reload_)
+        {
+            sweep_divider_ = sweep_period_;
+            sweep_reload_ = false;
+        }
+        else
+        {
+            --sweep_divider_;
+        }
     }
 }
 
@@ -187,15 +473,26 @@ void PulseChannel::on_write(address_t addr, byte_t value)
     switch (addr & 0x3)
     {
     case 0:
+        duty_ = value >> 6;
         len_halted_ = value & 0x20;
+        envelope_.on_write(value);
         break;
     case 1:
+        sweep_enabled_ = value & 0x80;
+        sweep_period_ = (value >> 4) & 0x07;
+        sweep_negate_ = value & 0x08;
+        sweep_shift_ = value & 0x07;
+        sweep_reload_ = true;
         break;
     case 2:
+        timer_period_ = (timer_period_ & 0x0700) | value;
         break;
     case 3:
+        timer_period_ = (timer_period_ & 0x00FF) | (static_cast<uint16_t>(value & 0x07) << 8);
         if (len_enabled_)
             len_counter_ = length_table[value >> 3];
+        sequence_ = 0;
+        envelope_.start_ = true;
         break;
     }
 }
@@ -207,16 +504,57 @@ void PulseChannel::on_ctrl(bool enable)
         len_counter_ = 0;
 }
 
+void PulseChannel::clock_timer()
+{
+    sequence_ = (sequence_ - 1) & 0x07;
+    next_clock_ += (timer_period_ + 1) * 2;
+}
+
+void PulseChannel::update_timer(uint64_t now)
+{
+    if (len_counter_ == 0 || is_muted())
+        next_clock_ = timer_parked;
+    else if (next_clock_ == timer_parked)
+        next_clock_ = now + (timer_period_ + 1) * 2;
+}
+
+byte_t PulseChannel::output() const
+{
+    if (len_counter_ == 0 || is_muted() || !duty_table[duty_][sequence_])
+        return 0;
+
+    return envelope_.output();
+}
+
+uint16_t PulseChannel::sweep_target() const
+{
+    const int change = timer_period_ >> sweep_shift_;
+    if (sweep_negate_)
+        return static_cast<uint16_t>(std::max(0, timer_period_ - change - (ones_complement_ ? 1 : 0)));
+
+    return static_cast<uint16_t>(timer_period_ + change);
+}
+
+bool PulseChannel::is_muted() const
+{
+    return timer_period_ < 8 || (!sweep_negate_ && sweep_target() > 0x7FF);
+}
+
 void TriangleChannel::on_clock(bool half_frame)
 {
+    if (linear_reload_flag_)
+        linear_counter_ = linear_reload_;
+    else if (linear_counter_ > 0)
+        --linear_counter_;
+
+    if (!linear_control_)
+        linear_reload_flag_ = false;
+
     if (half_frame)
     {
         if (len_counter_ > 0 && !len_halted_)
             --len_counter_;
     }
-
-    if (timer_ > 0)
-        --timer_;
 }
 
 void TriangleChannel::on_write(address_t addr, byte_t value)
@@ -224,17 +562,20 @@ void TriangleChannel::on_write(address_t addr, byte_t value)
     switch (addr - 0x4008)
     {
     case 0:
+        linear_control_ = value & 0x80;
         len_halted_ = value & 0x80;
+        linear_reload_ = value & 0x7F;
         break;
     case 1:
-        timer_ = (timer_ & 0xFF00) + value;
         break;
     case 2:
-        timer_ = (timer_ & 0x00FF) + (static_cast<uint16_t>(value & 0x07) << 8);
+        timer_period_ = (timer_period_ & 0x0700) | value;
         break;
     case 3:
+        timer_period_ = (timer_period_ & 0x00FF) | (static_cast<uint16_t>(value & 0x07) << 8);
         if (len_enabled_)
             len_counter_ = length_table[value >> 3];
+        linear_reload_flag_ = true;
         break;
     }
 }
@@ -246,8 +587,31 @@ void TriangleChannel::on_ctrl(bool enable)
         len_counter_ = 0;
 }
 
+void TriangleChannel::clock_timer()
+{
+    sequence_ = (sequence_ + 1) & 0x1F;
+    next_clock_ += timer_period_ + 1;
+}
+
+void TriangleChannel::update_timer(uint64_t now)
+{
+    // The sequencer halts (holding its level) when a counter reaches zero.
+    // Ultrasonic periods are parked too, they would only be heard as a DC offset.
+    if (len_counter_ == 0 || linear_counter_ == 0 || timer_period_ < 2)
+        next_clock_ = timer_parked;
+    else if (next_clock_ == timer_parked)
+        next_clock_ = now + timer_period_ + 1;
+}
+
+byte_t TriangleChannel::output() const
+{
+    return triangle_table[sequence_];
+}
+
 void NoiseChannel::on_clock(bool half_frame)
 {
+    envelope_.on_clock();
+
     if (half_frame)
     {
         if (len_counter_ > 0 && !len_halted_)
@@ -261,14 +625,18 @@ void NoiseChannel::on_write(address_t addr, byte_t value)
     {
     case 0:
         len_halted_ = value & 0x20;
+        envelope_.on_write(value);
         break;
     case 1:
         break;
     case 2:
+        short_mode_ = value & 0x80;
+        timer_period_ = noise_period_table[value & 0x0F];
         break;
     case 3:
         if (len_enabled_)
             len_counter_ = length_table[value >> 3];
+        envelope_.start_ = true;
         break;
     }
 }
@@ -280,6 +648,29 @@ void NoiseChannel::on_ctrl(bool enable)
         len_counter_ = 0;
 }
 
+void NoiseChannel::clock_timer()
+{
+    const uint16_t feedback = (shift_ ^ (shift_ >> (short_mode_ ? 6 : 1))) & 0x1;
+    shift_ = (shift_ >> 1) | (feedback << 14);
+    next_clock_ += timer_period_;
+}
+
+void NoiseChannel::update_timer(uint64_t now)
+{
+    if (len_counter_ == 0)
+        next_clock_ = timer_parked;
+    else if (next_clock_ == timer_parked)
+        next_clock_ = now + timer_period_;
+}
+
+byte_t NoiseChannel::output() const
+{
+    if (len_counter_ == 0 || (shift_ & 0x1))
+        return 0;
+
+    return envelope_.output();
+}
+
 void DMChannel::on_clock(bool half_frame)
 {
 }
@@ -292,6 +683,8 @@ void DMChannel::on_write(address_t addr, byte_t value)
         irq_enabled_ = value & 0x80;
         loop_ = value & 0x40;
         rate_idx_ = value & 0x0F;
+        if (!irq_enabled_)
+            irq_flag_ = false;
         break;
     case 1:
         output_level_ = value & 0x7F;
@@ -307,5 +700,90 @@ void DMChannel::on_write(address_t addr, byte_t value)
 
 void DMChannel::on_ctrl(bool enable)
 {
-    enabled_ = enable;
-}
\ No newline at end of file
+    irq_flag_ = false;
+
+    if (!enable)
+    {
+        bytes_remaining_ = 0;
+    }
+    else if (bytes_remaining_ == 0)
+    {
+        current_addr_ = sample_addr_;
+        bytes_remaining_ = sample_len_;
+    }
+}
+
+void DMChannel::clock_timer(BUS& bus)
+{
+    if (buffer_empty_ && bytes_remaining_ > 0)
+        fetch(bus);
+
+    if (!silence_)
+    {
+        if (shift_ & 0x1)
+        {
+            if (output_level_ <= 125)
+                output_level_ += 2;
+        }
+        else
+        {
+            if (output_level_ >= 2)
+                output_level_ -= 2;
+        }
+    }
+
+    shift_ >>= 1;
+
+    if (--bits_remaining_ == 0)
+    {
+        bits_remaining_ = 8;
+        silence_ = buffer_empty_;
+        if (!buffer_empty_)
+        {
+            shift_ = sample_buffer_;
+            buffer_empty_ = true;
+        }
+    }
+
+    next_clock_ += dmc_rate_table[rate_idx_];
+}
+
+void DMChannel::update_timer(uint64_t now)
+{
+    if (silence_ && buffer_empty_ && bytes_remaining_ == 0)
+        next_clock_ = timer_parked;
+    else if (next_clock_ == timer_parked)
+        next_clock_ = now + dmc_rate_table[rate_idx_];
+}
+
+uint64_t DMChannel::next_fetch() const
+{
+    if (bytes_remaining_ == 0 || next_clock_ == timer_parked)
+        return timer_parked;
+
+    // A full buffer empties into the shift register on the clock of its last bit
+    return buffer_empty_ ? next_clock_ : next_clock_ + static_cast<uint64_t>(bits_remaining_) * dmc_rate_table[rate_idx_];
+}
+
+// The sample fetch stalls the cpu for up to 4 cycles on hardware, this is not emulated.
+void DMChannel::fetch(BUS& bus)
+{
+    sample_buffer_ = bus.read_cpu(current_addr_);
+    buffer_empty_ = false;
+
+    current_addr_ = (current_addr_ == 0xFFFF) ? 0x8000 : current_addr_ + 1;
+
+    if (--bytes_remaining_ == 0)
+    {
+        if (loop_)
+        {
+            current_addr_ = sample_addr_;
+            bytes_remaining_ = sample_len_;
+        }
+        else if (irq_enabled_)
+        {
+            irq_flag_ = true;
+            bus.cpu_.pull_irq();
+        }
+    }
+}
@@ -1,10 +1,14 @@
 #pragma once
 
 #include "types.h"
+#include "blip_buffer.h"
+
+#include <span>
 
 class BUS;
+class StateStream;
 
-struct Control : public register_t<byte_t>
+struct Control : public reg_t<byte_t>
 {
     bool pulse1 : 1; // (bit 0)
     bool pulse2 : 1; // (bit 1)
@@ -16,13 +20,41 @@ struct Control : public register_t<byte_t>
     bool dmc_int : 1; // (bit 7)
 };
 
+struct Envelope
+{
+    bool start_ : 1 {};
+    bool loop_ : 1 {};
+    bool constant_ : 1 {};
+    byte_t volume_ = 0;
+    byte_t divider_ = 0;
+    byte_t decay_ = 0;
+
+    void on_clock();
+    void on_write(byte_t value);
+
+    byte_t output() const { return constant_ ? volume_ : decay_; }
+};
+
+// Channel timers are run lazily by the APU, next_clock_ is the cpu cycle of the next timer clock.
+// A silent channel parks its timer until a register write or a frame counter clock wakes it up.
+constexpr uint64_t timer_parked = ~0ull;
+
 struct PulseChannel
 {
-    struct Timer : public register_t<address_t>
-    {
-        address_t time : 11; // (bits 0-10)
-        byte_t enabled : 1; // (bit 11)
-    } timer;
+    Envelope envelope_;
+
+    uint64_t next_clock_ = timer_parked;
+    uint16_t timer_period_ = 0;
+    byte_t duty_ = 0;
+    byte_t sequence_ = 0;
+
+    bool sweep_enabled_ : 1 {};
+    bool sweep_negate_ : 1 {};
+    bool sweep_reload_ : 1 {};
+    bool ones_complement_ : 1 {}; // pulse 1 negates with one's complement
+    byte_t sweep_period_ = 0;
+    byte_t sweep_shift_ = 0;
+    byte_t sweep_divider_ = 0;
 
     bool len_enabled_ : 1 {};
     bool len_halted_ : 1 {};
@@ -31,70 +63,174 @@ struct PulseChannel
     void on_clock(bool half_frame);
     void on_write(address_t addr, byte_t value);
     void on_ctrl(bool enable);
+
+    void clock_timer();
+    void update_timer(uint64_t now);
+    byte_t output() const;
+
+    uint16_t sweep_target() const;
+    bool is_muted() const;
 };
 
 struct TriangleChannel
 {
-    bool len_enabled_ : 1;
-    bool len_halted_ : 1;
-    byte_t len_counter_;
-    uint16_t timer_ = 0;
+    uint64_t next_clock_ = timer_parked;
+    uint16_t timer_period_ = 0;
+    byte_t sequence_ = 0;
+
+    bool linear_control_ : 1 {};
+    bool linear_reload_flag_ : 1 {};
+    byte_t linear_reload_ = 0;
+    byte_t linear_counter_ = 0;
+
+    bool len_enabled_ : 1 {};
+    bool len_halted_ : 1 {};
+    byte_t len_counter_ {};
 
     void on_clock(bool half_frame);
     void on_write(address_t addr, byte_t value);
     void on_ctrl(bool enable);
+
+    void clock_timer();
+    void update_timer(uint64_t now);
+    byte_t output() const;
 };
 
 struct NoiseChannel
 {
-    bool len_enabled_ : 1;
-    bool len_halted_ : 1;
-    byte_t len_counter_;
+    Envelope envelope_;
+
+    uint64_t next_clock_ = timer_parked;
+    uint16_t timer_period_ = 4;
+    uint16_t shift_ = 1;
+    bool short_mode_ : 1 {};
+
+    bool len_enabled_ : 1 {};
+    bool len_halted_ : 1 {};
+    byte_t len_counter_ {};
 
     void on_clock(bool half_frame);
     void on_write(address_t addr, byte_t value);
     void on_ctrl(bool enable);
+
+    void clock_timer();
+    void update_timer(uint64_t now);
+    byte_t output() const;
 };
 
 struct DMChannel
 {
-    address_t sample_addr_;
-    uint16_t sample_len_;
-    uint8_t output_level_;
+    address_t sample_addr_ = 0xC000;
+    uint16_t sample_len_ = 1;
+    uint8_t output_level_ = 0;
 
     uint8_t rate_idx_ = 0;
-    bool enabled_ : 1 {};
     bool irq_enabled_ : 1 {};
     bool loop_ : 1 {};
+    bool irq_flag_ : 1 {};
+
+    // memory reader
+    address_t current_addr_ = 0xC000;
+    uint16_t bytes_remaining_ = 0;
+    byte_t sample_buffer_ = 0;
+    bool buffer_empty_ : 1 { true };
+
+    // output unit
+    uint64_t next_clock_ = timer_parked;
+    byte_t shift_ = 0;
+    byte_t bits_remaining_ = 8;
+    bool silence_ : 1 { true };
 
     void on_clock(bool half_frame);
     void on_write(address_t addr, byte_t value);
     void on_ctrl(bool enable);
+
+    void clock_timer(BUS& bus);
+    void update_timer(uint64_t now);
+    byte_t output() const { return output_level_; }
+
+    // The timer clock reading the next sample byte, timer_parked without one
+    uint64_t next_fetch() const;
+
+    void fetch(BUS& bus);
 };
 
 class APU
 {
 public:
-    APU() = default;
+    APU();
+
+    void init(BUS* bus) { bus_ = bus; }
+
+    // Called every cpu cycle, only does work when a frame counter event or a DMC fetch is due.
+    void step(uint64_t cpu_cycle)
+    {
+        if (cpu_cycle >= next_event_)
+            catch_up(cpu_cycle);
+    }
 
-    void step();
+    // Run every event scheduled up to (and including) cpu_cycle.
+    void catch_up(uint64_t cpu_cycle);
     void reset();
 
+    // Samples not read yet are kept on load, the output moves on from its current level.
+    void serialize_state(StateStream& state);
+
+    uint64_t next_event() const { return next_event_; }
+
     bool on_write(address_t addr, byte_t value);
     bool on_read(address_t addr, byte_t& value);
 
+    // Audio output, samples are produced once per frame by end_frame().
+    void set_sample_rate(int sample_rate);
+    // Resampling ratio correction (> 1.0 produces more samples per frame).
+    void set_rate_adjust(double ratio);
+    void end_frame(uint64_t cpu_cycle);
+
+    // Muted frames leave the output untouched, rolling back to a state saved before them
+    // continues it without a seam (run-ahead).
+    void set_muted(bool muted) { muted_ = muted; }
+
+    int samples_avail() const { return blip_.samples_avail(); }
+    int read_samples(std::span<int16_t> out) { return blip_.read_samples(out); }
+
 private:
+    static constexpr uint64_t no_event = ~0ull;
+
+    uint64_t now_() const;
+    void run_event_();
+    void schedule_();
+    void clock_channels_(bool half_frame);
+
+    // Synthesis
+    void run_channels_(uint64_t cpu_cycle);
+    void update_timers_(uint64_t cpu_cycle);
+    void update_output_(uint64_t cpu_cycle);
+
+    BUS* bus_ = nullptr;
+
     PulseChannel pulse1_;
     PulseChannel pulse2_;
     TriangleChannel triangle_;
     NoiseChannel noise_;
     DMChannel dmc_;
 
-    uint32_t cycle_ = 0;
-    bool odd_cycle_ = false;
+    // Frame counter, timestamps are in cpu cycles.
+    uint64_t sequence_start_ = 0;
+    uint64_t sequence_reset_ = no_event; // pending $4017 write
+    uint64_t next_event_ = 0;
+    uint8_t sequence_step_ = 0;
+
     bool five_steps_sequence_ = false;
+    bool five_steps_pending_ = false;
     bool irq_inhibit_ = false;
     bool frame_irq_ = false;
 
-    uint8_t sequencer_change_delay_;
-};
\ No newline at end of file
+    // Mixer output, deltas are timestamped from the start of the audio frame.
+    BlipBuffer blip_;
+    uint64_t frame_start_ = 0;
+    uint32_t levels_ = 0; // packed mixer table indices of the last mix
+    int amplitude_ = 0;
+    int output_amplitude_ = 0; // the level in the blip buffer, amplitude_ unless muted or loaded
+    bool muted_ = false;
+};
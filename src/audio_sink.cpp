@@ -0,0 +1,143 @@
+#include "audio_sink.h"
+
+#include <array>
+#include <chrono>
+
+AudioSink::AudioSink(int sample_rate, size_t capacity)
+    : ring_(capacity)
+    , sample_rate_(sample_rate)
+{
+}
+
+void AudioSink::push(std::span<const int16_t> samples)
+{
+    const size_t written = ring_.write(samples);
+
+    samples_pushed_.fetch_add(written, std::memory_order_relaxed);
+    if (written < samples.size())
+    {
+        samples_dropped_.fetch_add(samples.size() - written, std::memory_order_relaxed);
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    on_push_();
+}
+
+size_t AudioSink::pull(std::span<int16_t> out, bool count_underrun)
+{
+    const size_t count = ring_.read(out);
+
+    if (count_underrun && count < out.size())
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+
+    return count;
+}
+
+AudioStats AudioSink::get_stats() const
+{
+    AudioStats stats;
+    stats.samples_pushed_ = samples_pushed_.load(std::memory_order_relaxed);
+    stats.samples_dropped_ = samples_dropped_.load(std::memory_order_relaxed);
+    stats.overruns_ = overruns_.load(std::memory_order_relaxed);
+    stats.underruns_ = underruns_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+NullAudioSink::NullAudioSink(int sample_rate)
+    : AudioSink(sample_rate, 0x1000)
+{
+}
+
+void NullAudioSink::on_push_()
+{
+    ring_.discard();
+}
+
+// One second of buffering, the writer thread only has to keep up on average.
+WavAudioSink::WavAudioSink(int sample_rate)
+    : AudioSink(sample_rate, sample_rate)
+{
+}
+
+WavAudioSink::~WavAudioSink()
+{
+    close();
+}
+
+bool WavAudioSink::open(const stdfs::path& filepath)
+{
+    close();
+
+    ofs_.open(filepath, std::ios::binary | std::ios::trunc);
+    if (!ofs_.is_open())
+        return false;
+
+    ring_.discard();
+    data_size_ = 0;
+    write_header_(0);
+
+    writer_ = std::jthread([this](std::stop_token stop) {
+        while (!stop.stop_requested())
+        {
+            drain_();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    return true;
+}
+
+void WavAudioSink::close()
+{
+    if (!ofs_.is_open())
+        return;
+
+    writer_ = {};
+    drain_();
+
+    // Patch the chunk sizes now that the data size is known.
+    ofs_.seekp(0);
+    write_header_(data_size_);
+    ofs_.close();
+}
+
+void WavAudioSink::write_header_(uint32_t data_size)
+{
+    auto write_u32 = [this](uint32_t v) { ofs_.write(reinterpret_cast<const char*>(&v), sizeof(v)); };
+    auto write_u16 = [this](uint16_t v) { ofs_.write(reinterpret_cast<const char*>(&v), sizeof(v)); };
+
+    constexpr uint16_t channels = 1;
+    constexpr uint16_t bits_per_sample = 16;
+    constexpr uint16_t block_align = channels * bits_per_sample / 8;
+
+    ofs_.write("RIFF", 4);
+    write_u32(36 + data_size);
+    ofs_.write("WAVE", 4);
+
+    ofs_.write("fmt ", 4);
+    write_u32(16);
+    write_u16(1); // PCM
+    write_u16(channels);
+    write_u32(sample_rate_);
+    write_u32(sample_rate_ * block_align);
+    write_u16(block_align);
+    write_u16(bits_per_sample);
+
+    ofs_.write("data", 4);
+    write_u32(data_size);
+}
+
+void WavAudioSink::drain_()
+{
+    std::array<int16_t, 0x800> chunk;
+
+    for (;;)
+    {
+        const size_t count = pull(chunk, false);
+        if (count == 0)
+            break;
+
+        ofs_.write(reinterpret_cast<const char*>(chunk.data()), count * sizeof(int16_t));
+        data_size_ += static_cast<uint32_t>(count * sizeof(int16_t));
+    }
+}
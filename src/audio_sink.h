@@ -0,0 +1,84 @@
+#pragma once
+
+#include "types.h"
+#include "ring_buffer.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <thread>
+
+namespace stdfs = std::filesystem;
+
+struct AudioStats
+{
+    uint64_t samples_pushed_ = 0;
+    uint64_t samples_dropped_ = 0;
+    uint64_t overruns_ = 0;  // pushes that did not fit in the ring buffer
+    uint64_t underruns_ = 0; // pulls that could not be filled
+};
+
+// Audio output stage. The emulation thread pushes the samples of a frame into
+// a lock-free ring buffer, the sink drains it from its own thread.
+// push() never blocks: samples that do not fit are dropped and counted.
+class AudioSink
+{
+public:
+    AudioSink(int sample_rate, size_t capacity);
+    virtual ~AudioSink() = default;
+
+    void push(std::span<const int16_t> samples);
+
+    int sample_rate() const { return sample_rate_; }
+    size_t buffered() const { return ring_.size(); }
+    size_t capacity() const { return ring_.capacity(); }
+
+    AudioStats get_stats() const;
+
+protected:
+    // Consumer side. Returns the number of samples read, a short read is an underrun.
+    size_t pull(std::span<int16_t> out, bool count_underrun = true);
+
+    virtual void on_push_() {}
+
+    RingBuffer<int16_t> ring_;
+    int sample_rate_;
+
+private:
+    std::atomic<uint64_t> samples_pushed_ { 0 };
+    std::atomic<uint64_t> samples_dropped_ { 0 };
+    std::atomic<uint64_t> overruns_ { 0 };
+    std::atomic<uint64_t> underruns_ { 0 };
+};
+
+// Discards every sample, for benchmarks.
+class NullAudioSink : public AudioSink
+{
+public:
+    NullAudioSink(int sample_rate = 44100);
+
+protected:
+    void on_push_() override;
+};
+
+// Streams 16-bit mono PCM to a WAV file from a writer thread.
+class WavAudioSink : public AudioSink
+{
+public:
+    WavAudioSink(int sample_rate = 44100);
+    ~WavAudioSink();
+
+    bool open(const stdfs::path& filepath);
+    void close();
+
+    bool is_open() const { return ofs_.is_open(); }
+
+private:
+    void write_header_(uint32_t data_size);
+    void drain_();
+
+    std::ofstream ofs_;
+    std::jthread writer_;
+    uint32_t data_size_ = 0;
+};
@@ -0,0 +1,625 @@
+#include "batch_cpu.h"
+
+#include "cartridge.h"
+#include "mappers/000.h"
+#include "ops.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+using namespace ops;
+using enum CPU_State::StatusFlags;
+
+static constexpr size_t ram_sz = 0x800;
+
+BatchCPU::BatchCPU(size_t lanes, const Cartridge& cart)
+{
+    if (cart.get_mapper_code() != M000::ines_code || cart.prg_rom_.empty())
+        throw std::runtime_error("BatchCPU only supports NROM cartridges");
+
+    // 16KB images are mirrored at $C000 by the mask
+    prg_ = cart.prg_rom_;
+    prg_mask_ = cart.prg_rom_.size() - 1;
+
+    program_counter_.resize(lanes);
+    accumulator_.resize(lanes);
+    register_x_.resize(lanes);
+    register_y_.resize(lanes);
+    status_.resize(lanes);
+    stack_pointer_.resize(lanes);
+    cycle_.resize(lanes);
+    irq_requested_.resize(lanes);
+    nmi_requested_.resize(lanes);
+
+    ram_.resize(lanes * ram_sz);
+
+    group_.resize(lanes);
+    pending_.resize(lanes);
+    addr_.resize(lanes);
+    operand_.resize(lanes);
+
+    reset();
+}
+
+void BatchCPU::reset()
+{
+    for (size_t i = 0; i < lane_count(); ++i)
+    {
+        program_counter_[i] = read_addr_(i, 0xFFFC);
+        accumulator_[i] = 0;
+        register_x_[i] = 0;
+        register_y_[i] = 0;
+        status_[i] = 0x24;
+        stack_pointer_[i] = 0xFD;
+
+        // The reset sequence takes 7 cycles before the first fetch
+        cycle_[i] = 7;
+
+        irq_requested_[i] = 0;
+        nmi_requested_[i] = 0;
+    }
+}
+
+void BatchCPU::set_io_handlers(void* context, IoRead read, IoWrite write)
+{
+    io_context_ = context;
+    io_read_ = read;
+    io_write_ = write;
+}
+
+CPU_State BatchCPU::get_lane_state(size_t lane) const
+{
+    CPU_State state;
+    state.state_ = CPU_State::kFetching;
+    state.cycle_ = cycle_[lane];
+    state.program_counter_ = program_counter_[lane];
+    state.accumulator_ = accumulator_[lane];
+    state.register_x_ = register_x_[lane];
+    state.register_y_ = register_y_[lane];
+    state.status_ = status_[lane];
+    state.stack_pointer_ = stack_pointer_[lane];
+    state.irq_requested_ = irq_requested_[lane] != 0;
+    state.nmi_requested_ = nmi_requested_[lane] != 0;
+    return state;
+}
+
+std::span<byte_t> BatchCPU::get_ram(size_t lane)
+{
+    return std::span(ram_).subspan(lane * ram_sz, ram_sz);
+}
+
+void BatchCPU::step()
+{
+    std::ranges::fill(pending_, 1);
+    step_();
+}
+
+void BatchCPU::run_until(uint64_t cycle)
+{
+    for (;;)
+    {
+        byte_t any = 0;
+        for (size_t i = 0; i < lane_count(); ++i)
+        {
+            pending_[i] = cycle_[i] < cycle ? 1 : 0;
+            any |= pending_[i];
+        }
+
+        if (!any)
+            break;
+
+        step_();
+    }
+}
+
+void BatchCPU::step_()
+{
+    const size_t n = lane_count();
+
+    // Interrupts are serviced per lane, in place of the next fetch (see CPU::step_fetch_)
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (!pending_[i] || !(nmi_requested_[i] | irq_requested_[i]))
+            continue;
+
+        if (nmi_requested_[i])
+        {
+            interrupt_(i, 0xFFFA);
+            pending_[i] = 0;
+        }
+        else if (!(status_[i] & kIntDisable))
+        {
+            interrupt_(i, 0xFFFE);
+            pending_[i] = 0;
+        }
+
+        irq_requested_[i] = 0;
+        nmi_requested_[i] = 0;
+    }
+
+    uint64_t groups = 0;
+    bool lockstep = false;
+
+    for (size_t leader = 0; leader < n; ++leader)
+    {
+        if (!pending_[leader])
+            continue;
+
+        const address_t pc = program_counter_[leader];
+
+        // Lanes can only share a decode when the code comes from the shared PRG-ROM
+        size_t count = 1;
+        if (pc >= 0x8000)
+        {
+            count = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                group_[i] = pending_[i] & (program_counter_[i] == pc ? 1 : 0);
+                count += group_[i];
+            }
+        }
+        else
+        {
+            std::ranges::fill(group_, 0);
+            group_[leader] = 1;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+            pending_[i] &= ~group_[i];
+
+        full_ = (count == n);
+        lockstep = lockstep || (groups == 0 && full_);
+
+        CPU_State::Instr instr;
+        instr.opcode = read_(leader, pc);
+        instr.operands[0] = read_(leader, pc + 1);
+        instr.operands[1] = read_(leader, pc + 2);
+
+        if (opcode_data(instr.opcode).operation == kUKN)
+            throw std::runtime_error(fmt::format(FMT_STRING("Unrecognized opcode {:02X} on lane {}"), instr.opcode, leader));
+
+        exec_group_(instr);
+        ++groups;
+    }
+
+    ++stats_.steps_;
+    stats_.groups_ += groups;
+    if (lockstep)
+        ++stats_.lockstep_steps_;
+}
+
+void BatchCPU::interrupt_(size_t lane, address_t vector)
+{
+    const address_t pc = program_counter_[lane];
+    push_(lane, static_cast<byte_t>(pc >> 8));
+    push_(lane, static_cast<byte_t>(pc));
+
+    status_[lane] = (status_[lane] & ~kBreak) | kIntDisable;
+    push_(lane, status_[lane]);
+
+    program_counter_[lane] = read_addr_(lane, vector);
+    cycle_[lane] += 7;
+}
+
+template <typename F>
+void BatchCPU::for_lanes_(F&& f)
+{
+    const size_t n = lane_count();
+
+    // The common case: every lane runs the same instruction, no mask to test
+    if (full_)
+    {
+        for (size_t i = 0; i < n; ++i)
+            f(i);
+    }
+    else
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (group_[i])
+                f(i);
+        }
+    }
+}
+
+void BatchCPU::compute_addr_(byte_t addressing, address_t arg, byte_t timing)
+{
+    // Indexed reads take an extra cycle when crossing a page (see CPU::idle_ticks_from_addressing_)
+    auto page_penalty = [&](size_t i, address_t base)
+    {
+        cycle_[i] += ((addr_[i] ^ base) > 0xFF) ? 1 : 0;
+    };
+
+    switch (addressing)
+    {
+    case kZeroPage:
+        for_lanes_([&](size_t i) { addr_[i] = arg & 0xFF; });
+        break;
+    case kZeroPageX:
+        for_lanes_([&](size_t i) { addr_[i] = (arg + register_x_[i]) & 0xFF; });
+        break;
+    case kZeroPageY:
+        for_lanes_([&](size_t i) { addr_[i] = (arg + register_y_[i]) & 0xFF; });
+        break;
+    case kAbsolute:
+        for_lanes_([&](size_t i) { addr_[i] = arg; });
+        break;
+    case kAbsoluteX:
+        for_lanes_([&](size_t i) { addr_[i] = arg + register_x_[i]; });
+        if (timing == 4)
+            for_lanes_([&](size_t i) { page_penalty(i, arg); });
+        break;
+    case kAbsoluteY:
+        for_lanes_([&](size_t i) { addr_[i] = arg + register_y_[i]; });
+        if (timing == 4)
+            for_lanes_([&](size_t i) { page_penalty(i, arg); });
+        break;
+    case kIndirect:
+        // The high byte does not cross the page (JMP ($xxFF) bug)
+        for_lanes_([&](size_t i)
+        {
+            const address_t addr_h = (arg & 0xFF00) | ((arg + 1) & 0xFF);
+            addr_[i] = static_cast<address_t>(read_(i, addr_h)) << 8 | read_(i, arg);
+        });
+        break;
+    case kIndirectX:
+        for_lanes_([&](size_t i)
+        {
+            const byte_t zp = static_cast<byte_t>(arg + register_x_[i]);
+            addr_[i] = static_cast<address_t>(read_(i, static_cast<byte_t>(zp + 1))) << 8 | read_(i, zp);
+        });
+        break;
+    case kIndirectY:
+        for_lanes_([&](size_t i)
+        {
+            const byte_t zp = static_cast<byte_t>(arg);
+            const address_t base = static_cast<address_t>(read_(i, static_cast<byte_t>(zp + 1))) << 8 | read_(i, zp);
+            addr_[i] = base + register_y_[i];
+
+            if (timing == 5)
+                page_penalty(i, base);
+        });
+        break;
+    default:
+        throw std::runtime_error(fmt::format(FMT_STRING("Invalid addressing {:02X}"), addressing));
+    }
+}
+
+void BatchCPU::load_operand_(byte_t addressing, address_t arg)
+{
+    if (addressing == kImmediate)
+    {
+        for_lanes_([&](size_t i) { operand_[i] = static_cast<byte_t>(arg); });
+        return;
+    }
+
+    for_lanes_([&](size_t i) { operand_[i] = read_(i, addr_[i]); });
+}
+
+void BatchCPU::exec_group_(CPU_State::Instr const& instr)
+{
+    const metadata& meta = opcode_data(instr.opcode);
+    const byte_t ad = meta.addressing;
+    const byte_t size = meta.get_size();
+    const address_t arg = instr.to_addr();
+
+    for_lanes_([&](size_t i)
+    {
+        program_counter_[i] += size;
+        cycle_[i] += meta.timing;
+    });
+
+    auto load = [&]
+    {
+        if (ad != kImmediate)
+            compute_addr_(ad, arg, meta.timing);
+        load_operand_(ad, arg);
+    };
+
+    auto store = [&](auto&& value)
+    {
+        compute_addr_(ad, arg, meta.timing);
+        for_lanes_([&](size_t i) { write_(i, addr_[i], value(i)); });
+    };
+
+    // Read-modify-write, on the accumulator when there is no operand
+    auto modify = [&](auto&& f)
+    {
+        if (ad == kNone)
+        {
+            for_lanes_([&](size_t i) { accumulator_[i] = f(i, accumulator_[i]); });
+            return;
+        }
+
+        compute_addr_(ad, arg, meta.timing);
+        for_lanes_([&](size_t i) { write_(i, addr_[i], f(i, read_(i, addr_[i]))); });
+    };
+
+    auto branch = [&](byte_t flag, bool set)
+    {
+        const address_t offset = static_cast<address_t>(std::bit_cast<int8_t>(instr.operands[0]));
+        for_lanes_([&](size_t i)
+        {
+            const bool taken = ((status_[i] & flag) != 0) == set;
+            const address_t pc = program_counter_[i];
+            const address_t target = pc + offset;
+
+            cycle_[i] += taken ? (((target ^ pc) > 0xFF) ? 2 : 1) : 0;
+            program_counter_[i] = taken ? target : pc;
+        });
+    };
+
+    auto set_flags = [&](byte_t mask, byte_t value)
+    {
+        for_lanes_([&](size_t i) { status_[i] = (status_[i] & ~mask) | value; });
+    };
+
+    auto adc = [&](size_t i, byte_t operand)
+    {
+        const byte_t a = accumulator_[i];
+        const uint16_t sum = a + operand + (status_[i] & kCarry);
+        const byte_t result = static_cast<byte_t>(sum);
+        const byte_t overflow = ((a ^ result) & (operand ^ result) & 0x80) ? kOverflow : 0;
+
+        status_[i] = (status_[i] & ~(kCarry | kOverflow)) | (sum > 0xFF ? kCarry : 0) | overflow;
+        accumulator_[i] = result;
+        set_nz_(i, result);
+    };
+
+    auto compare = [&](size_t i, byte_t reg, byte_t operand)
+    {
+        status_[i] = (status_[i] & ~kCarry) | (reg >= operand ? kCarry : 0);
+        set_nz_(i, static_cast<byte_t>(reg - operand));
+    };
+
+    auto asl = [&](size_t i, byte_t v)
+    {
+        status_[i] = (status_[i] & ~kCarry) | (v >> 7);
+        v <<= 1;
+        set_nz_(i, v);
+        return v;
+    };
+
+    auto lsr = [&](size_t i, byte_t v)
+    {
+        status_[i] = (status_[i] & ~kCarry) | (v & kCarry);
+        v >>= 1;
+        set_nz_(i, v);
+        return v;
+    };
+
+    auto rol = [&](size_t i, byte_t v)
+    {
+        const byte_t carry = status_[i] & kCarry;
+        status_[i] = (status_[i] & ~kCarry) | (v >> 7);
+        v = static_cast<byte_t>(v << 1) | carry;
+        set_nz_(i, v);
+        return v;
+    };
+
+    auto ror = [&](size_t i, byte_t v)
+    {
+        const byte_t carry = (status_[i] & kCarry) << 7;
+        status_[i] = (status_[i] & ~kCarry) | (v & kCarry);
+        v = (v >> 1) | carry;
+        set_nz_(i, v);
+        return v;
+    };
+
+    auto inc = [&](size_t i, byte_t v)
+    {
+        ++v;
+        set_nz_(i, v);
+        return v;
+    };
+
+    auto dec = [&](size_t i, byte_t v)
+    {
+        --v;
+        set_nz_(i, v);
+        return v;
+    };
+
+    auto transfer = [&](std::vector<byte_t>& dst, std::vector<byte_t> const& src)
+    {
+        for_lanes_([&](size_t i)
+        {
+            dst[i] = src[i];
+            set_nz_(i, dst[i]);
+        });
+    };
+
+    auto load_reg = [&](std::vector<byte_t>& dst)
+    {
+        load();
+        transfer(dst, operand_);
+    };
+
+    switch (meta.operation)
+    {
+    case kADC: load(); for_lanes_([&](size_t i) { adc(i, operand_[i]); }); break;
+    case kSBC: load(); for_lanes_([&](size_t i) { adc(i, ~operand_[i]); }); break;
+    case kAND: load(); for_lanes_([&](size_t i) { set_nz_(i, accumulator_[i] &= operand_[i]); }); break;
+    case kORA: load(); for_lanes_([&](size_t i) { set_nz_(i, accumulator_[i] |= operand_[i]); }); break;
+    case kEOR: load(); for_lanes_([&](size_t i) { set_nz_(i, accumulator_[i] ^= operand_[i]); }); break;
+    case kCMP: load(); for_lanes_([&](size_t i) { compare(i, accumulator_[i], operand_[i]); }); break;
+    case kCPX: load(); for_lanes_([&](size_t i) { compare(i, register_x_[i], operand_[i]); }); break;
+    case kCPY: load(); for_lanes_([&](size_t i) { compare(i, register_y_[i], operand_[i]); }); break;
+
+    case kBIT:
+        load();
+        for_lanes_([&](size_t i)
+        {
+            const byte_t v = operand_[i];
+            status_[i] = (status_[i] & ~(kNegative | kOverflow | kZero)) | (v & (kNegative | kOverflow))
+                | ((v & accumulator_[i]) == 0 ? kZero : 0) | kDummy;
+        });
+        break;
+
+    case kASL: modify(asl); break;
+    case kLSR: modify(lsr); break;
+    case kROL: modify(rol); break;
+    case kROR: modify(ror); break;
+    case kINC: modify(inc); break;
+    case kDEC: modify(dec); break;
+
+    // unofficial read-modify-write combos
+    case kSLO: modify([&](size_t i, byte_t v) { v = asl(i, v); set_nz_(i, accumulator_[i] |= v); return v; }); break;
+    case kRLA: modify([&](size_t i, byte_t v) { v = rol(i, v); set_nz_(i, accumulator_[i] &= v); return v; }); break;
+    case kSRE: modify([&](size_t i, byte_t v) { v = lsr(i, v); set_nz_(i, accumulator_[i] ^= v); return v; }); break;
+    case kRRA: modify([&](size_t i, byte_t v) { v = ror(i, v); adc(i, v); return v; }); break;
+    case kDCP: modify([&](size_t i, byte_t v) { --v; compare(i, accumulator_[i], v); return v; }); break;
+    case kISB: modify([&](size_t i, byte_t v) { ++v; adc(i, ~v); return v; }); break;
+
+    case kBCC: branch(kCarry, false); break;
+    case kBCS: branch(kCarry, true); break;
+    case kBEQ: branch(kZero, true); break;
+    case kBNE: branch(kZero, false); break;
+    case kBMI: branch(kNegative, true); break;
+    case kBPL: branch(kNegative, false); break;
+    case kBVC: branch(kOverflow, false); break;
+    case kBVS: branch(kOverflow, true); break;
+
+    case kBRK:
+        for_lanes_([&](size_t i)
+        {
+            const address_t pc = program_counter_[i];
+            push_(i, static_cast<byte_t>(pc >> 8));
+            push_(i, static_cast<byte_t>(pc));
+
+            status_[i] |= kBreak | kDummy;
+            push_(i, status_[i]);
+            status_[i] |= kIntDisable;
+
+            program_counter_[i] = read_addr_(i, 0xFFFE);
+        });
+        break;
+
+    case kCLC: set_flags(kCarry, 0); break;
+    case kCLD: set_flags(kDecimal, 0); break;
+    case kCLI: set_flags(kIntDisable, 0); break;
+    case kCLV: set_flags(kOverflow, 0); break;
+    case kSEC: set_flags(kCarry, kCarry); break;
+    case kSED: set_flags(kDecimal, kDecimal); break;
+    case kSEI: set_flags(kIntDisable, kIntDisable); break;
+
+    case kDEX: for_lanes_([&](size_t i) { set_nz_(i, --register_x_[i]); }); break;
+    case kDEY: for_lanes_([&](size_t i) { set_nz_(i, --register_y_[i]); }); break;
+    case kINX: for_lanes_([&](size_t i) { set_nz_(i, ++register_x_[i]); }); break;
+    case kINY: for_lanes_([&](size_t i) { set_nz_(i, ++register_y_[i]); }); break;
+
+    case kTAX: transfer(register_x_, accumulator_); break;
+    case kTAY: transfer(register_y_, accumulator_); break;
+    case kTSX: transfer(register_x_, stack_pointer_); break;
+    case kTXA: transfer(accumulator_, register_x_); break;
+    case kTYA: transfer(accumulator_, register_y_); break;
+    case kTXS: for_lanes_([&](size_t i) { stack_pointer_[i] = register_x_[i]; }); break;
+
+    case kLDA: load_reg(accumulator_); break;
+    case kLDX: load_reg(register_x_); break;
+    case kLDY: load_reg(register_y_); break;
+    case kLAX:
+        load();
+        for_lanes_([&](size_t i)
+        {
+            accumulator_[i] = register_x_[i] = operand_[i];
+            set_nz_(i, operand_[i]);
+        });
+        break;
+
+    case kSTA: store([&](size_t i) { return accumulator_[i]; }); break;
+    case kSTX: store([&](size_t i) { return register_x_[i]; }); break;
+    case kSTY: store([&](size_t i) { return register_y_[i]; }); break;
+    case kSAX: store([&](size_t i) { return static_cast<byte_t>(accumulator_[i] & register_x_[i]); }); break;
+
+    case kJMP:
+        compute_addr_(ad, arg, meta.timing);
+        for_lanes_([&](size_t i) { program_counter_[i] = addr_[i]; });
+        break;
+
+    case kJSR:
+        for_lanes_([&](size_t i)
+        {
+            const address_t ret = program_counter_[i] - 1;
+            push_(i, static_cast<byte_t>(ret >> 8));
+            push_(i, static_cast<byte_t>(ret));
+            program_counter_[i] = arg;
+        });
+        break;
+
+    case kRTS:
+        for_lanes_([&](size_t i)
+        {
+            const byte_t lo = pull_(i);
+            program_counter_[i] = (static_cast<address_t>(pull_(i)) << 8 | lo) + 1;
+        });
+        break;
+
+    case kRTI:
+        for_lanes_([&](size_t i)
+        {
+            status_[i] = pull_(i);
+            const byte_t lo = pull_(i);
+            program_counter_[i] = static_cast<address_t>(pull_(i)) << 8 | lo;
+        });
+        break;
+
+    case kPHA: for_lanes_([&](size_t i) { push_(i, accumulator_[i]); }); break;
+    case kPHP: for_lanes_([&](size_t i) { push_(i, status_[i] | 0b00110000); }); break;
+    case kPLA: for_lanes_([&](size_t i) { set_nz_(i, accumulator_[i] = pull_(i)); }); break;
+    case kPLP: for_lanes_([&](size_t i) { status_[i] = pull_(i) | kDummy; }); break;
+
+    case kNOP:
+        // Only for the page crossing penalty of the unofficial indexed NOPs
+        if (ad == kAbsoluteX || ad == kAbsoluteY)
+            compute_addr_(ad, arg, meta.timing);
+        break;
+
+    default:
+        throw std::runtime_error(fmt::format(FMT_STRING("Unimplemented operation {:02X} for opcode {} [{:02X}]"), meta.operation, meta.str, instr.opcode));
+    }
+}
+
+inline byte_t BatchCPU::read_(size_t lane, address_t addr)
+{
+    if (addr < 0x2000)
+        return ram_[lane * ram_sz + (addr & 0x7FF)];
+
+    if (addr >= 0x8000)
+        return prg_[addr & prg_mask_];
+
+    return io_read_ ? io_read_(io_context_, lane, addr) : 0;
+}
+
+inline void BatchCPU::write_(size_t lane, address_t addr, byte_t value)
+{
+    if (addr < 0x2000)
+        ram_[lane * ram_sz + (addr & 0x7FF)] = value;
+    else if (addr >= 0x8000)
+        return;
+    else if (io_write_)
+        io_write_(io_context_, lane, addr, value);
+}
+
+inline address_t BatchCPU::read_addr_(size_t lane, address_t addr)
+{
+    return static_cast<address_t>(read_(lane, addr + 1)) << 8 | read_(lane, addr);
+}
+
+inline void BatchCPU::push_(size_t lane, byte_t value)
+{
+    ram_[lane * ram_sz + (0x100 | stack_pointer_[lane]--)] = value;
+}
+
+inline byte_t BatchCPU::pull_(size_t lane)
+{
+    return ram_[lane * ram_sz + (0x100 | ++stack_pointer_[lane])];
+}
+
+inline void BatchCPU::set_nz_(size_t lane, byte_t value)
+{
+    status_[lane] = (status_[lane] & ~(kZero | kNegative)) | (value & kNegative) | (value == 0 ? kZero : 0);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "types.h"
+#include "cpu.h"
+
+#include <span>
+#include <vector>
+
+class Cartridge;
+
+// Registers of every lane, stored as structure-of-arrays.
+struct BatchCPU_State
+{
+    std::vector<address_t> program_counter_;
+    std::vector<byte_t> accumulator_;
+    std::vector<byte_t> register_x_;
+    std::vector<byte_t> register_y_;
+    std::vector<byte_t> status_;
+    std::vector<byte_t> stack_pointer_;
+    std::vector<uint64_t> cycle_;
+
+    std::vector<byte_t> irq_requested_;
+    std::vector<byte_t> nmi_requested_;
+};
+
+struct BatchStats
+{
+    uint64_t steps_ = 0;
+    uint64_t groups_ = 0; // instructions decoded, one per group of lanes sharing a pc
+    uint64_t lockstep_steps_ = 0; // steps where all lanes ran as a single group
+};
+
+// Experimental: K copies of the 6502 running the same NROM program with different inputs.
+// Lanes sharing a program counter decode the instruction once and execute it together,
+// the per-lane loops are written so register operations vectorize when no lane diverged.
+// Each lane owns its 2KB RAM, PRG-ROM is read from the shared cartridge (WRAM accesses go to the io handlers).
+// Accesses to $2000-$7FFF are forwarded to the io handlers, there is no PPU or APU.
+class BatchCPU : private BatchCPU_State
+{
+public:
+    // Plain functions called with the context given to set_io_handlers, they are on the lock-step path
+    using IoRead = byte_t (*)(void* context, size_t lane, address_t addr);
+    using IoWrite = void (*)(void* context, size_t lane, address_t addr, byte_t value);
+
+    BatchCPU(size_t lanes, const Cartridge& cart);
+
+    void reset();
+
+    // Executes one instruction (or services a pending interrupt) on every lane.
+    void step();
+
+    // Steps the lanes that are behind until every lane reached the cycle.
+    void run_until(uint64_t cycle);
+
+    void pull_irq(size_t lane) { irq_requested_[lane] = 1; }
+    void pull_nmi(size_t lane) { nmi_requested_[lane] = 1; }
+
+    void set_io_handlers(void* context, IoRead read, IoWrite write);
+
+    size_t lane_count() const { return program_counter_.size(); }
+    uint64_t get_cycle(size_t lane) const { return cycle_[lane]; }
+    CPU_State get_lane_state(size_t lane) const;
+
+    std::span<byte_t> get_ram(size_t lane);
+
+    BatchStats const& get_stats() const { return stats_; }
+
+private:
+    // Runs the lanes flagged in pending_, grouped by program counter
+    void step_();
+    void interrupt_(size_t lane, address_t vector);
+    void exec_group_(CPU_State::Instr const& instr);
+
+    void compute_addr_(byte_t addressing, address_t arg, byte_t timing);
+    void load_operand_(byte_t addressing, address_t arg);
+
+    template <typename F>
+    void for_lanes_(F&& f);
+
+    // memory
+    byte_t read_(size_t lane, address_t addr);
+    void write_(size_t lane, address_t addr, byte_t value);
+    address_t read_addr_(size_t lane, address_t addr);
+
+    void push_(size_t lane, byte_t value);
+    byte_t pull_(size_t lane);
+
+    void set_nz_(size_t lane, byte_t value);
+
+    std::span<const byte_t> prg_;
+    size_t prg_mask_ = 0;
+
+    std::vector<byte_t> ram_;
+
+    void* io_context_ = nullptr;
+    IoRead io_read_ = nullptr;
+    IoWrite io_write_ = nullptr;
+
+    // current group
+    std::vector<byte_t> group_;
+    std::vector<byte_t> pending_;
+    std::vector<address_t> addr_;
+    std::vector<byte_t> operand_;
+    bool full_ = false;
+
+    BatchStats stats_;
+};
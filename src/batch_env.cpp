@@ -0,0 +1,210 @@
+#include "batch_env.h"
+
+#include "controller.h"
+#include "emulator.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+BatchEnv::BatchEnv(stdfs::path rom, const BatchEnvConfig& config)
+    : config_(config)
+    , rom_(std::move(rom))
+{
+    if (config_.instances_ == 0 || config_.frame_skip_ < 1)
+        throw std::runtime_error("Invalid environment config");
+
+    instances_.resize(config_.instances_);
+    for (Instance& inst : instances_)
+    {
+        inst.emulator_.reset(new Emulator);
+        inst.emulator_->set_verbose(false);
+        inst.emulator_->set_host_break(false);
+        inst.emulator_->read_rom(rom_.wstring());
+    }
+
+    if (config_.observation_ == EnvObservation::Greyscale84)
+        grey_.resize(size() * grey_size);
+
+    actions_.resize(size());
+
+    // The calling thread runs the first slice
+    size_t threads = config_.threads_ ? config_.threads_ : std::thread::hardware_concurrency();
+    threads = std::clamp<size_t>(threads, 1, size());
+    config_.threads_ = threads;
+
+    start_.reset(new std::barrier<>(threads));
+    done_.reset(new std::barrier<>(threads));
+
+    for (size_t i = 1; i < threads; ++i)
+        workers_.emplace_back([this, i] { run_worker_(i); });
+
+    reset();
+}
+
+BatchEnv::~BatchEnv()
+{
+    stopping_ = true;
+    if (!workers_.empty())
+        start_->arrive_and_wait();
+
+    workers_.clear();
+}
+
+void BatchEnv::reset()
+{
+    for (size_t idx = 0; idx < size(); ++idx)
+    {
+        Emulator& emul = *instances_[idx].emulator_;
+        if (emul.is_debugging())
+            emul.debugger_.resume();
+
+        emul.power_on();
+        instances_[idx].frames_ = 0;
+
+        if (config_.observation_ == EnvObservation::Greyscale84)
+            to_greyscale84(emul.get_ppu()->output(), std::span(grey_).subspan(idx * grey_size).first<grey_size>());
+    }
+}
+
+void BatchEnv::step(std::span<const byte_t> actions)
+{
+    if (actions.size() != size())
+        throw std::runtime_error(fmt::format("Expected {} actions, got {}", size(), actions.size()));
+
+    std::ranges::copy(actions, actions_.begin());
+
+    if (workers_.empty())
+    {
+        run_slice_(0);
+        return;
+    }
+
+    start_->arrive_and_wait();
+    run_slice_(0);
+    done_->arrive_and_wait();
+}
+
+EnvView BatchEnv::observe(size_t idx) const
+{
+    const Emulator& emul = *instances_[idx].emulator_;
+
+    EnvView view;
+    view.ram_ = { emul.get_ram()->data(), 0x800 };
+
+    if (config_.observation_ == EnvObservation::Greyscale84)
+        view.frame_ = std::span(grey_).subspan(idx * grey_size, grey_size);
+    else
+        view.frame_ = { emul.get_ppu()->output().data(), emul.get_ppu()->output().size() };
+
+    return view;
+}
+
+bool BatchEnv::is_halted(size_t idx) const
+{
+    return instances_[idx].emulator_->is_debugging();
+}
+
+void BatchEnv::run_worker_(size_t idx)
+{
+    for (;;)
+    {
+        start_->arrive_and_wait();
+        if (stopping_)
+            return;
+
+        run_slice_(idx);
+        done_->arrive_and_wait();
+    }
+}
+
+void BatchEnv::run_slice_(size_t idx)
+{
+    const size_t slices = workers_.size() + 1;
+    const size_t first = idx * size() / slices;
+    const size_t last = (idx + 1) * size() / slices;
+
+    for (size_t i = first; i < last; ++i)
+        step_instance_(i);
+}
+
+void BatchEnv::step_instance_(size_t idx)
+{
+    Instance& inst = instances_[idx];
+    Emulator& emul = *inst.emulator_;
+
+    if (emul.is_debugging())
+        return;
+
+    Controller& ctrl = emul.get_bus()->ctrl_;
+    const byte_t action = actions_[idx];
+
+    for (int bit = 0; bit < 8; ++bit)
+    {
+        const auto button = static_cast<Controller::Button>(1 << bit);
+        if (action & button)
+            ctrl.press(button);
+        else
+            ctrl.release(button);
+    }
+
+    for (int frame = 0; frame < config_.frame_skip_; ++frame)
+    {
+        emul.update();
+        ++inst.frames_;
+    }
+
+    if (config_.observation_ == EnvObservation::Greyscale84)
+        to_greyscale84(emul.get_ppu()->output(), std::span(grey_).subspan(idx * grey_size).first<grey_size>());
+}
+
+// Box filter over the source pixels covered by each output pixel.
+void BatchEnv::to_greyscale84(const PPU::Output& image, std::span<byte_t, grey_size> out)
+{
+    constexpr uint32_t width = PPU::Output::Width;
+    constexpr uint32_t height = PPU::Output::Height;
+
+    constexpr auto col_start = []
+    {
+        std::array<uint32_t, grey_width + 1> cols {};
+        for (uint32_t x = 0; x <= grey_width; ++x)
+            cols[x] = x * width / grey_width;
+        return cols;
+    }();
+
+    std::array<uint16_t, width> luma;
+    std::array<uint32_t, grey_width> acc;
+
+    const byte_t* pixels = image.data();
+    uint32_t y0 = 0;
+
+    for (uint32_t oy = 0; oy < grey_height; ++oy)
+    {
+        const uint32_t y1 = (oy + 1) * height / grey_height;
+        acc.fill(0);
+
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            // BT.601 weights in 8 bit fixed point, written to vectorize
+            const byte_t* row = pixels + y * image.pitch();
+            for (uint32_t x = 0; x < width; ++x)
+                luma[x] = static_cast<uint16_t>((row[4 * x] * 77 + row[4 * x + 1] * 150 + row[4 * x + 2] * 29) >> 8);
+
+            for (uint32_t ox = 0; ox < grey_width; ++ox)
+            {
+                for (uint32_t x = col_start[ox]; x < col_start[ox + 1]; ++x)
+                    acc[ox] += luma[x];
+            }
+        }
+
+        for (uint32_t ox = 0; ox < grey_width; ++ox)
+        {
+            const uint32_t area = (y1 - y0) * (col_start[ox + 1] - col_start[ox]);
+            out[oy * grey_width + ox] = static_cast<byte_t>(acc[ox] / area);
+        }
+
+        y0 = y1;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "types.h"
+#include "ppu.h"
+
+#include <atomic>
+#include <barrier>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+class Emulator;
+
+enum class EnvObservation : byte_t
+{
+    RGBA,       // views of PPU::output(), 256x240x4
+    Greyscale84 // 84x84 luma, one contiguous buffer for the whole batch
+};
+
+struct BatchEnvConfig
+{
+    size_t instances_ = 1;
+    int frame_skip_ = 4; // frames emulated per step, the action is held
+    EnvObservation observation_ = EnvObservation::Greyscale84;
+    size_t threads_ = 0; // 0 for hardware concurrency
+};
+
+// Views into the environment's own memory, valid until the next step or reset.
+struct EnvView
+{
+    std::span<const byte_t> frame_;
+    std::span<const byte_t> ram_;
+};
+
+// Gym-style batch of emulators running the same ROM.
+// step() applies one controller byte (Controller::Button bits) per instance, emulates
+// frame_skip frames on the worker threads and leaves the observations in place.
+class BatchEnv
+{
+public:
+    static constexpr uint32_t grey_width = 84;
+    static constexpr uint32_t grey_height = 84;
+    static constexpr size_t grey_size = grey_width * grey_height;
+
+    BatchEnv(stdfs::path rom, const BatchEnvConfig& config);
+    ~BatchEnv();
+
+    BatchEnv(const BatchEnv&) = delete;
+    BatchEnv& operator=(const BatchEnv&) = delete;
+
+    // Power cycles every instance.
+    void reset();
+    void step(std::span<const byte_t> actions);
+
+    size_t size() const { return instances_.size(); }
+    const BatchEnvConfig& config() const { return config_; }
+
+    EnvView observe(size_t idx) const;
+
+    // [instance][y][x], only filled with EnvObservation::Greyscale84.
+    std::span<const byte_t> grey_batch() const { return grey_; }
+
+    uint64_t frame(size_t idx) const { return instances_[idx].frames_; }
+
+    // An instance stops when the emulation throws (bad opcode...), until the next reset.
+    bool is_halted(size_t idx) const;
+
+    Emulator& get_emulator(size_t idx) { return *instances_[idx].emulator_; }
+
+    static void to_greyscale84(const PPU::Output& image, std::span<byte_t, grey_size> out);
+
+private:
+    struct Instance
+    {
+        std::unique_ptr<Emulator> emulator_;
+        uint64_t frames_ = 0;
+    };
+
+    void run_worker_(size_t idx);
+    void run_slice_(size_t idx);
+    void step_instance_(size_t idx);
+
+    BatchEnvConfig config_;
+    stdfs::path rom_;
+    std::vector<Instance> instances_;
+    std::vector<byte_t> grey_;
+
+    // step() hands the actions to the workers between the two barriers
+    std::vector<byte_t> actions_;
+    std::vector<std::jthread> workers_;
+    std::unique_ptr<std::barrier<>> start_;
+    std::unique_ptr<std::barrier<>> done_;
+    std::atomic<bool> stopping_ = false;
+};
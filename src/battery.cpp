@@ -3,9 +3,6 @@
 #include <filesystem>
 #include <fstream>
 
-using bifstream = std::basic_ifstream<byte_t>;
-using bofstream = std::basic_ofstream<byte_t>;
-
 Battery::Battery(stdfs::path filepath)
     : filepath_(std::move(filepath))
 {
@@ -18,12 +15,12 @@ bool Battery::load_from(const stdfs::path& filepath)
     if (!stdfs::exists(filepath))
         return false;
 
-    bifstream ifs(filepath);
+    std::ifstream ifs(filepath, std::ios::binary);
 
     if (!ifs.is_open())
         return false;
 
-    ifs.read(memory_.data(), memory_.size());
+    ifs.read(reinterpret_cast<char*>(memory_.data()), memory_.size());
 
     return !ifs.bad();
 }
@@ -32,12 +29,12 @@ bool Battery::save_now()
 {
     stdfs::create_directories(filepath_.parent_path());
 
-    bofstream ofs(filepath_);
+    std::ofstream ofs(filepath_, std::ios::binary);
 
     if (!ofs.is_open())
         return false;
 
-    ofs.write(memory_.data(), memory_.size());
+    ofs.write(reinterpret_cast<const char*>(memory_.data()), memory_.size());
 
     return true;
 }
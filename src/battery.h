@@ -2,6 +2,7 @@
 
 #include <array>
 #include <filesystem>
+#include <span>
 #include <string_view>
 
 #include "types.h"
@@ -19,6 +20,8 @@ class Battery
     bool write(address_t addr, byte_t value);
     bool read(address_t addr, byte_t& value) const;
 
+    std::span<byte_t, 0x2000> memory() { return memory_; }
+
     static stdfs::path make_save_filepath(const stdfs::path& rom_filepath);
 
 private:
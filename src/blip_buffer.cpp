@@ -0,0 +1,127 @@
+#include "blip_buffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+
+using Kernel = std::array<std::array<int16_t, BlipBuffer::kernel_size>, BlipBuffer::phase_count>;
+
+// Blackman windowed sinc impulse, one row per sub-sample phase.
+// Each row sums exactly to 1 << kernel_bits so integrated steps don't drift.
+static Kernel make_kernel()
+{
+    constexpr double cutoff = 0.90;
+    constexpr int half = BlipBuffer::kernel_size / 2;
+    constexpr double pi = std::numbers::pi;
+
+    Kernel kernel{};
+
+    for (int p = 0; p < BlipBuffer::phase_count; ++p)
+    {
+        std::array<double, BlipBuffer::kernel_size> taps{};
+        double sum = 0.0;
+
+        for (int k = 0; k < BlipBuffer::kernel_size; ++k)
+        {
+            const double x = (k - (half - 1)) - static_cast<double>(p) / BlipBuffer::phase_count;
+            const double sinc = (x == 0.0) ? 1.0 : std::sin(pi * cutoff * x) / (pi * cutoff * x);
+            const double w = 0.42 + 0.5 * std::cos(pi * x / half) + 0.08 * std::cos(2.0 * pi * x / half);
+
+            taps[k] = (std::abs(x) < half) ? sinc * w : 0.0;
+            sum += taps[k];
+        }
+
+        int total = 0;
+        for (int k = 0; k < BlipBuffer::kernel_size; ++k)
+        {
+            kernel[p][k] = static_cast<int16_t>(std::lround(taps[k] / sum * (1 << BlipBuffer::kernel_bits)));
+            total += kernel[p][k];
+        }
+
+        kernel[p][half - 1] += static_cast<int16_t>((1 << BlipBuffer::kernel_bits) - total);
+    }
+
+    return kernel;
+}
+
+static const Kernel& kernel()
+{
+    static const Kernel kernel = make_kernel();
+    return kernel;
+}
+
+void BlipBuffer::set_rates(double clock_rate, int sample_rate)
+{
+    sample_rate_ = sample_rate;
+    set_clock_rate(clock_rate);
+
+    // 100ms of samples, plenty for a frame.
+    capacity_ = sample_rate / 10;
+    buf_.assign(capacity_ + kernel_size, 0);
+
+    clear();
+}
+
+void BlipBuffer::set_clock_rate(double clock_rate)
+{
+    factor_ = static_cast<uint64_t>(std::ldexp(sample_rate_ / clock_rate, time_bits));
+}
+
+void BlipBuffer::clear()
+{
+    offset_ = 0;
+    integrator_ = 0;
+    std::ranges::fill(buf_, 0);
+}
+
+void BlipBuffer::add_delta(uint32_t clock_time, int delta)
+{
+    const uint64_t fixed = offset_ + clock_time * factor_;
+    const size_t idx = static_cast<size_t>(fixed >> time_bits);
+    const int phase = static_cast<int>(fixed >> (time_bits - phase_bits)) & (phase_count - 1);
+
+    NES_ASSERT(idx + kernel_size <= buf_.size());
+
+    const auto& taps = kernel()[phase];
+    int32_t* out = buf_.data() + idx;
+
+    for (int k = 0; k < kernel_size; ++k)
+        out[k] += taps[k] * delta;
+}
+
+void BlipBuffer::end_frame(uint32_t clock_duration)
+{
+    offset_ += clock_duration * factor_;
+    NES_ASSERT(samples_avail() <= capacity_);
+}
+
+int BlipBuffer::read_samples(std::span<int16_t> out)
+{
+    const int count = std::min(samples_avail(), static_cast<int>(out.size()));
+
+    int32_t sum = integrator_;
+    for (int i = 0; i < count; ++i)
+    {
+        const int32_t s = sum >> kernel_bits;
+        sum += buf_[i];
+        out[i] = static_cast<int16_t>(std::clamp(s, -0x8000, 0x7FFF));
+
+        // leaky integration acts as a high-pass, removes the NES' DC offset
+        sum -= s << (kernel_bits - bass_shift);
+    }
+    integrator_ = sum;
+
+    remove_samples(count);
+    return count;
+}
+
+void BlipBuffer::remove_samples(int count)
+{
+    const size_t remain = static_cast<size_t>(samples_avail() - count) + kernel_size;
+
+    std::copy_n(buf_.begin() + count, remain, buf_.begin());
+    std::fill_n(buf_.begin() + remain, count, 0);
+
+    offset_ -= static_cast<uint64_t>(count) << time_bits;
+}
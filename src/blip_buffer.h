@@ -0,0 +1,47 @@
+#pragma once
+
+#include "types.h"
+
+#include <span>
+#include <vector>
+
+// Band-limited synthesis buffer (blip_buf style).
+// Amplitude changes are added as band-limited steps at their clock timestamp,
+// then integrated to output samples once per frame at the host sample rate.
+class BlipBuffer
+{
+public:
+    static constexpr int phase_bits = 5;
+    static constexpr int phase_count = 1 << phase_bits;
+    static constexpr int kernel_size = 16;
+    static constexpr int kernel_bits = 13;
+
+    BlipBuffer() = default;
+
+    void set_rates(double clock_rate, int sample_rate);
+    // Changes the resampling ratio without clearing pending samples.
+    void set_clock_rate(double clock_rate);
+    void clear();
+
+    // clock_time is relative to the start of the current frame
+    void add_delta(uint32_t clock_time, int delta);
+    void end_frame(uint32_t clock_duration);
+
+    int samples_avail() const { return static_cast<int>(offset_ >> time_bits); }
+    int read_samples(std::span<int16_t> out);
+    void remove_samples(int count);
+
+    int sample_rate() const { return sample_rate_; }
+
+private:
+    static constexpr int time_bits = 32;
+    static constexpr int bass_shift = 9;
+
+    uint64_t factor_ = 0;
+    uint64_t offset_ = 0;
+    int32_t integrator_ = 0;
+    int sample_rate_ = 0;
+    int capacity_ = 0;
+
+    std::vector<int32_t> buf_;
+};
@@ -4,6 +4,15 @@
 #include "ppu.h"
 #include "ram.h"
 #include "cartridge.h"
+#include "instrumentation.h"
+#include "mappers/dispatch.h"
+
+void BUS::load_cartridge(Cartridge* cart)
+{
+    cart_ = cart;
+    if (cart_ != nullptr)
+        cart_->bus_ = this;
+}
 
 address_t BUS::map_cpu_addr(address_t addr) const
 {
@@ -13,6 +22,19 @@ address_t BUS::map_cpu_addr(address_t addr) const
 
 void BUS::write_cpu(address_t addr, byte_t value)
 {
+    if (flat_memory_) [[unlikely]]
+    {
+        flat_memory_[addr] = value;
+        return;
+    }
+
+    if (counters_) [[unlikely]]
+        ++counters_->writes_[BusCounters::region(addr)];
+
+    // DMC fetches due before a bank switch read the bank mapped at their time
+    if (addr >= 0x4020)
+        apu_.step(cpu_.get_state().cycle_);
+
     if (ppu_.on_write_cpu(addr, value)) ;
     else if (apu_.on_write(addr, value)) ;
     else if (ctrl_.on_write(addr, value)) ;
@@ -22,6 +44,12 @@ void BUS::write_cpu(address_t addr, byte_t value)
 
 byte_t BUS::read_cpu(address_t addr) const
 {
+    if (flat_memory_) [[unlikely]]
+        return flat_memory_[addr];
+
+    if (counters_) [[unlikely]]
+        ++counters_->reads_[BusCounters::region(addr)];
+
     byte_t value = 0;
 
     if (ppu_.on_read_cpu(addr, value)) ;
@@ -33,6 +61,56 @@ byte_t BUS::read_cpu(address_t addr) const
     return value;
 }
 
+bool BUS::read_cpu_page(byte_t page, std::span<byte_t, 0x100> dest) const
+{
+    const address_t addr = static_cast<address_t>(page) << 8;
+    const byte_t* src = nullptr;
+
+    if (flat_memory_) [[unlikely]]
+        src = flat_memory_ + addr;
+    else if (addr < 0x2000)
+        src = ram_.data() + (addr & 0x7FF);
+    else if (addr >= 0x6000 && cart_)
+        src = cart_->get_cpu_page(addr);
+
+    if (src == nullptr)
+        return false;
+
+    std::memcpy(dest.data(), src, dest.size());
+    return true;
+}
+
+bool BUS::peek_cpu(address_t addr, byte_t& value) const
+{
+    if (flat_memory_) [[unlikely]]
+    {
+        value = flat_memory_[addr];
+        return true;
+    }
+
+    if (addr < 0x2000)
+    {
+        value = ram_.data()[addr & 0x7FF];
+        return true;
+    }
+
+    if (addr < 0x6000 || cart_ == nullptr)
+        return false;
+
+    if (addr < 0x8000)
+    {
+        value = cart_->wram_[addr & 0x1FFF];
+        return true;
+    }
+
+    const byte_t* page = cart_->get_cpu_page(addr);
+    if (page == nullptr)
+        return false;
+
+    value = page[addr & 0xFF];
+    return true;
+}
+
 void BUS::write_ppu(address_t addr, byte_t value)
 {
     if (cart_ && cart_->on_ppu_write(addr, value)) ;
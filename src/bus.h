@@ -3,33 +3,50 @@
 #include "types.h"
 #include "controller.h"
 
+#include <span>
+
 class CPU;
 class APU;
 class PPU;
 class RAM;
 class Cartridge;
+class Debugger;
+struct BusCounters;
 
 class BUS
 {
 public:
-    BUS(CPU& cpu, APU& apu, PPU& ppu, RAM& ram)
+    BUS(CPU& cpu, APU& apu, PPU& ppu, RAM& ram, Debugger& debugger)
         : cpu_(cpu)
         , apu_(apu)
         , ppu_(ppu)
         , ram_(ram)
+        , debugger_(debugger)
     {
     }
 
-    void load_cartridge(Cartridge* cart)
-    {
-        cart_ = cart;
-    }
+    void load_cartridge(Cartridge* cart);
 
     address_t map_cpu_addr(address_t addr) const;
 
     void write_cpu(address_t addr, byte_t value);
     byte_t read_cpu(address_t addr) const;
 
+    // Block read of a whole cpu page, used by OAM DMA. Only RAM and cartridge
+    // memory are copied directly, returns false for pages that need per-byte reads.
+    bool read_cpu_page(byte_t page, std::span<byte_t, 0x100> dest) const;
+
+    // Side effect free read of RAM and cartridge memory, for tools. Returns false for the
+    // PPU, APU and I/O registers ($2000-$5FFF), which change state when read.
+    bool peek_cpu(address_t addr, byte_t& value) const;
+
+    // Test mode: every cpu access goes to this 64KB memory instead of the devices, OAM DMA
+    // included, nullptr to leave it.
+    void set_flat_memory(byte_t* memory) { flat_memory_ = memory; }
+
+    // Counts the cpu accesses per region, nullptr (the default) to stop.
+    void set_counters(BusCounters* counters) { counters_ = counters; }
+
     void write_ppu(address_t addr, byte_t value);
     byte_t read_ppu(address_t addr) const;
 
@@ -37,6 +54,11 @@ public:
     APU& apu_;
     PPU& ppu_;
     RAM& ram_;
+    Debugger& debugger_;
     Cartridge* cart_ = nullptr;
     Controller ctrl_;
+
+private:
+    byte_t* flat_memory_ = nullptr;
+    BusCounters* counters_ = nullptr;
 };
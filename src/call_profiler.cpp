@@ -0,0 +1,163 @@
+#include "call_profiler.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <tuple>
+
+CallProfiler::CallProfiler()
+{
+    clear();
+}
+
+void CallProfiler::attach(Cartridge* cart)
+{
+    pages_.attach(cart);
+    clear();
+}
+
+void CallProfiler::clear()
+{
+    nodes_.assign(1, CallNode {});
+    stack_.clear();
+    total_cycles_ = 0;
+}
+
+void CallProfiler::resync(byte_t sp)
+{
+    pages_.invalidate();
+
+    while (!stack_.empty() && stack_.back().sp_ < sp)
+        stack_.pop_back();
+}
+
+void CallProfiler::push_(address_t entry, byte_t sp, bool interrupt)
+{
+    if (stack_.size() >= max_depth)
+        return;
+
+    const size_t offset = pages_.rom_offset(entry);
+    const int bank = PrgPageTable::bank(offset);
+
+    const uint32_t caller = current_();
+    const uint32_t node = find_child_(caller, entry, bank, interrupt);
+    if (node != caller)
+        ++nodes_[node].calls_;
+
+    stack_.push_back({ node, sp });
+}
+
+uint32_t CallProfiler::find_child_(uint32_t parent, address_t entry, int bank, bool interrupt)
+{
+    uint32_t* link = &nodes_[parent].first_child_;
+    while (*link != CallNode::none)
+    {
+        const CallNode& child = nodes_[*link];
+        if (child.entry_ == entry && child.bank_ == bank && child.interrupt_ == interrupt)
+            return *link;
+
+        link = &nodes_[*link].next_sibling_;
+    }
+
+    // Full, the callee is charged to its caller
+    if (nodes_.size() >= max_nodes)
+        return parent;
+
+    const uint32_t node = static_cast<uint32_t>(nodes_.size());
+    *link = node;
+
+    CallNode& child = nodes_.emplace_back();
+    child.entry_ = entry;
+    child.bank_ = bank;
+    child.interrupt_ = interrupt;
+    child.parent_ = parent;
+    return node;
+}
+
+void CallProfiler::update_inclusive()
+{
+    for (CallNode& node : nodes_)
+        node.inclusive_ = node.exclusive_;
+
+    // Children come after their parent
+    for (size_t i = nodes_.size(); i-- > 1;)
+        nodes_[nodes_[i].parent_].inclusive_ += nodes_[i].inclusive_;
+}
+
+std::vector<CallFunction> CallProfiler::functions()
+{
+    update_inclusive();
+
+    using Key = std::tuple<int, address_t, bool>;
+    std::map<Key, CallFunction> functions;
+    std::map<Key, int> on_path; // recursive calls are inside the outermost one
+
+    // Depth first, the siblings are linked
+    auto visit = [&](auto& self, uint32_t idx) -> void
+    {
+        const CallNode& node = nodes_[idx];
+        const Key key { node.bank_, node.entry_, node.interrupt_ };
+
+        CallFunction& function = functions[key];
+        function.entry_ = node.entry_;
+        function.bank_ = node.bank_;
+        function.interrupt_ = node.interrupt_;
+        function.calls_ += node.calls_;
+        function.exclusive_ += node.exclusive_;
+
+        int& active = on_path[key];
+        if (active++ == 0)
+            function.inclusive_ += node.inclusive_;
+
+        for (uint32_t child = node.first_child_; child != CallNode::none; child = nodes_[child].next_sibling_)
+            self(self, child);
+
+        --active;
+    };
+
+    for (uint32_t child = nodes_[root].first_child_; child != CallNode::none; child = nodes_[child].next_sibling_)
+        visit(visit, child);
+
+    std::vector<CallFunction> sorted;
+    sorted.reserve(functions.size());
+    for (const auto& [key, function] : functions)
+        sorted.push_back(function);
+
+    std::ranges::sort(sorted, std::ranges::greater {}, &CallFunction::inclusive_);
+    return sorted;
+}
+
+std::string CallProfiler::function_name(address_t entry, int bank, bool interrupt)
+{
+    const std::string_view prefix = interrupt ? "int:" : "";
+
+    if (bank >= 0)
+        return fmt::format("{}{:02X}:{:04X}", prefix, bank, entry);
+
+    return fmt::format("{}{:04X}", prefix, entry);
+}
+
+std::string CallProfiler::node_name(uint32_t idx) const
+{
+    if (idx == root)
+        return "reset";
+
+    const CallNode& node = nodes_[idx];
+    return function_name(node.entry_, node.bank_, node.interrupt_);
+}
+
+void CallProfiler::write_folded(std::ostream& os) const
+{
+    std::vector<std::string> paths(nodes_.size());
+
+    for (size_t i = 0; i < nodes_.size(); ++i)
+    {
+        const uint32_t idx = static_cast<uint32_t>(i);
+        paths[i] = idx == root ? node_name(idx) : fmt::format("{};{}", paths[nodes_[i].parent_], node_name(idx));
+
+        if (nodes_[i].exclusive_ > 0)
+            os << fmt::format("{} {}\n", paths[i], nodes_[i].exclusive_);
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "types.h"
+#include "ops.h"
+#include "prg_page_table.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// A subroutine in one calling context: the call tree has a node per distinct path of
+// calls from the root, so a routine called from two places has two nodes.
+struct CallNode
+{
+    static constexpr uint32_t none = UINT32_MAX;
+
+    address_t entry_ = 0;
+    int bank_ = -1; // 8KB PRG ROM bank of the entry, -1 below $8000
+    bool interrupt_ = false; // entered by NMI or IRQ
+
+    uint32_t parent_ = none;
+    uint32_t first_child_ = none;
+    uint32_t next_sibling_ = none;
+
+    uint64_t calls_ = 0;
+    uint64_t exclusive_ = 0; // cycles of its own instructions
+    uint64_t inclusive_ = 0; // with its callees, see CallProfiler::update_inclusive
+};
+
+// A subroutine over all its calling contexts.
+struct CallFunction
+{
+    address_t entry_ = 0;
+    int bank_ = -1;
+    bool interrupt_ = false;
+    uint64_t calls_ = 0;
+    uint64_t exclusive_ = 0;
+    uint64_t inclusive_ = 0; // recursive calls counted once
+};
+
+// Charges the emulated CPU cycles to the subroutines on a shadow call stack, off by default.
+// JSR and interrupt entries push a frame with the stack pointer below their return address.
+// After every instruction the frames whose return address is above the stack pointer are
+// popped: that is RTS and RTI, and also a game dropping return addresses with PLA or TXS.
+// An RTS to an address the game pushed itself (a jump table) stays in the current frame.
+// DMA stalls are not charged.
+class CallProfiler
+{
+public:
+    static constexpr uint32_t root = 0; // the code outside any call, from the reset vector
+    static constexpr size_t max_nodes = 0x10000; // the calls past it stay in their caller
+    static constexpr size_t max_depth = 256;
+
+    CallProfiler();
+
+    // Clears the tree and the stack
+    void attach(Cartridge* cart);
+    Cartridge* get_cart() const { return pages_.get_cart(); }
+    void clear();
+
+    void on_instruction(uint32_t cycles)
+    {
+        nodes_[current_()].exclusive_ += cycles;
+        total_cycles_ += cycles;
+    }
+
+    // handler is the first instruction, sp below the pushed PC and status
+    void on_interrupt(address_t handler, byte_t sp, uint32_t cycles)
+    {
+        push_(handler, sp, true);
+        on_instruction(cycles);
+    }
+
+    // After an instruction executed, pc and sp are the new ones
+    void on_execute(byte_t operation, address_t pc, byte_t sp)
+    {
+        if (operation == ops::kJSR)
+            push_(pc, sp, false);
+
+        while (!stack_.empty() && stack_.back().sp_ < sp)
+            stack_.pop_back();
+    }
+
+    // The machine was reset or a state loaded: the frames above sp are dropped
+    void on_reset() { stack_.clear(); }
+    void resync(byte_t sp);
+
+    uint64_t total_cycles() const { return total_cycles_; }
+    size_t depth() const { return stack_.size(); }
+
+    // Index 0 is the root, parents come before their children
+    const std::vector<CallNode>& nodes() const { return nodes_; }
+
+    // The inclusive cycles are summed on demand, not per instruction
+    void update_inclusive();
+
+    // Every subroutine, by inclusive cycles
+    std::vector<CallFunction> functions();
+
+    // "03:E123" with a ROM bank, "0300" without, "int:" before interrupt handlers
+    static std::string function_name(address_t entry, int bank, bool interrupt);
+    std::string node_name(uint32_t node) const;
+
+    // One line per calling context with cycles of its own, "reset;03:E123;03:8000 1234",
+    // the input of flamegraph.pl and speedscope
+    void write_folded(std::ostream& os) const;
+
+private:
+    struct Frame
+    {
+        uint32_t node_;
+        byte_t sp_; // the return address (and status) are above it
+    };
+
+    uint32_t current_() const { return stack_.empty() ? root : stack_.back().node_; }
+
+    void push_(address_t entry, byte_t sp, bool interrupt);
+    uint32_t find_child_(uint32_t parent, address_t entry, int bank, bool interrupt);
+
+    PrgPageTable pages_;
+
+    std::vector<CallNode> nodes_;
+    std::vector<Frame> stack_;
+    uint64_t total_cycles_ = 0;
+};
@@ -0,0 +1,128 @@
+#include "capi/nesemul_env.h"
+
+#include "batch_env.h"
+
+#include <exception>
+#include <string>
+
+struct nesemul_env
+{
+    BatchEnv env_;
+};
+
+static thread_local std::string last_error;
+
+// Exceptions must not cross the C boundary
+template <typename F>
+static int guarded(F&& f)
+{
+    try
+    {
+        f();
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        last_error = e.what();
+    }
+    catch (...)
+    {
+        last_error = "Unknown error";
+    }
+
+    return -1;
+}
+
+uint32_t nesemul_env_abi_version(void)
+{
+    return NESEMUL_ENV_ABI_VERSION;
+}
+
+nesemul_env* nesemul_env_create(const char* rom_path, const nesemul_env_config* config)
+{
+    if (!rom_path || !config)
+    {
+        last_error = "Invalid argument";
+        return nullptr;
+    }
+
+    nesemul_env* env = nullptr;
+    guarded([&]
+    {
+        BatchEnvConfig cfg;
+        cfg.instances_ = config->instances;
+        cfg.frame_skip_ = static_cast<int>(config->frame_skip);
+        cfg.observation_ = config->observation == NESEMUL_OBS_RGBA ? EnvObservation::RGBA : EnvObservation::Greyscale84;
+        cfg.threads_ = config->threads;
+
+        const stdfs::path rom(reinterpret_cast<const char8_t*>(rom_path));
+        env = new nesemul_env { BatchEnv(rom, cfg) };
+    });
+
+    return env;
+}
+
+void nesemul_env_destroy(nesemul_env* env)
+{
+    delete env;
+}
+
+const char* nesemul_env_last_error(void)
+{
+    return last_error.c_str();
+}
+
+int nesemul_env_reset(nesemul_env* env)
+{
+    return guarded([&] { env->env_.reset(); });
+}
+
+int nesemul_env_step(nesemul_env* env, const uint8_t* actions, size_t count)
+{
+    return guarded([&] { env->env_.step({ actions, count }); });
+}
+
+size_t nesemul_env_size(const nesemul_env* env)
+{
+    return env->env_.size();
+}
+
+const uint8_t* nesemul_env_frame(const nesemul_env* env, size_t instance, size_t* size)
+{
+    if (instance >= env->env_.size())
+        return nullptr;
+
+    const EnvView view = env->env_.observe(instance);
+    if (size)
+        *size = view.frame_.size();
+    return view.frame_.data();
+}
+
+const uint8_t* nesemul_env_ram(const nesemul_env* env, size_t instance, size_t* size)
+{
+    if (instance >= env->env_.size())
+        return nullptr;
+
+    const EnvView view = env->env_.observe(instance);
+    if (size)
+        *size = view.ram_.size();
+    return view.ram_.data();
+}
+
+const uint8_t* nesemul_env_greyscale_batch(const nesemul_env* env, size_t* size)
+{
+    const std::span<const byte_t> grey = env->env_.grey_batch();
+    if (size)
+        *size = grey.size();
+    return grey.empty() ? nullptr : grey.data();
+}
+
+uint64_t nesemul_env_frame_count(const nesemul_env* env, size_t instance)
+{
+    return instance < env->env_.size() ? env->env_.frame(instance) : 0;
+}
+
+int nesemul_env_is_halted(const nesemul_env* env, size_t instance)
+{
+    return instance < env->env_.size() && env->env_.is_halted(instance) ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+#ifndef __NESEMUL_ENV_H__
+#define __NESEMUL_ENV_H__
+
+/* C interface to BatchEnv, for bindings (ctypes, cffi...).
+ * Bump NESEMUL_ENV_ABI_VERSION on any change to the signatures or structs below. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(NESEMUL_ENV_EXPORTS)
+#    define NESEMUL_ENV_API __declspec(dllexport)
+#  else
+#    define NESEMUL_ENV_API __declspec(dllimport)
+#  endif
+#else
+#  define NESEMUL_ENV_API __attribute__((visibility("default")))
+#endif
+
+#define NESEMUL_ENV_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct nesemul_env nesemul_env;
+
+enum
+{
+    NESEMUL_OBS_RGBA = 0,       /* 256x240x4, views of the PPU output */
+    NESEMUL_OBS_GREYSCALE84 = 1 /* 84x84x1, one contiguous buffer for the batch */
+};
+
+typedef struct nesemul_env_config
+{
+    uint32_t instances;
+    uint32_t frame_skip;
+    uint32_t observation;
+    uint32_t threads; /* 0 for hardware concurrency */
+} nesemul_env_config;
+
+NESEMUL_ENV_API uint32_t nesemul_env_abi_version(void);
+
+/* Returns NULL on failure, see nesemul_env_last_error. rom_path is UTF-8. */
+NESEMUL_ENV_API nesemul_env* nesemul_env_create(const char* rom_path, const nesemul_env_config* config);
+NESEMUL_ENV_API void nesemul_env_destroy(nesemul_env* env);
+
+/* Message of the last failed call on this thread. */
+NESEMUL_ENV_API const char* nesemul_env_last_error(void);
+
+/* Return 0 on success, -1 on failure. */
+NESEMUL_ENV_API int nesemul_env_reset(nesemul_env* env);
+/* One byte per instance: A, B, Select, Start, Up, Down, Left, Right from bit 0 to 7. */
+NESEMUL_ENV_API int nesemul_env_step(nesemul_env* env, const uint8_t* actions, size_t count);
+
+NESEMUL_ENV_API size_t nesemul_env_size(const nesemul_env* env);
+
+/* Pointers stay valid for the lifetime of the env, the content changes on step and reset. */
+NESEMUL_ENV_API const uint8_t* nesemul_env_frame(const nesemul_env* env, size_t instance, size_t* size);
+NESEMUL_ENV_API const uint8_t* nesemul_env_ram(const nesemul_env* env, size_t instance, size_t* size);
+NESEMUL_ENV_API const uint8_t* nesemul_env_greyscale_batch(const nesemul_env* env, size_t* size);
+
+NESEMUL_ENV_API uint64_t nesemul_env_frame_count(const nesemul_env* env, size_t instance);
+NESEMUL_ENV_API int nesemul_env_is_halted(const nesemul_env* env, size_t instance);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,7 +1,9 @@
 #include "cartridge.h"
 
+#include "hash.h"
 #include "ines.h"
-#include "mappers/mapper.h"
+#include "mappers/dispatch.h"
+#include "save_state.h"
 
 Cartridge::Cartridge()
 {
@@ -18,33 +20,14 @@ address_t Cartridge::map_to_cpu_addr(address_t addr)
     return 0;
 }
 
-bool Cartridge::on_cpu_read(address_t addr, byte_t& value)
-{
-    if (addr >= 0x4020)
-        return mapper_->on_cpu_read(addr, value);
-    return false;
-}
-
-bool Cartridge::on_cpu_write(address_t addr, byte_t value)
-{
-    if (addr >= 0x4020)
-        return mapper_->on_cpu_write(addr, value);
-    return false;
-}
-
-bool Cartridge::on_ppu_read(address_t addr, byte_t& value)
-{
-    return mapper_->on_ppu_read(addr, value);
-}
-
-bool Cartridge::on_ppu_write(address_t addr, byte_t value)
+void Cartridge::on_ppu_scanline(int scanline)
 {
-    return mapper_->on_ppu_write(addr, value);
+    visit_mapper([=](auto& mapper) { mapper.on_ppu_scanline(scanline); });
 }
 
-void Cartridge::on_ppu_scanline(int scanline)
+const byte_t* Cartridge::get_cpu_page(address_t addr)
 {
-    mapper_->on_ppu_scanline(scanline);
+    return visit_mapper([=](auto& mapper) { return mapper.get_cpu_page(addr); });
 }
 
 void Cartridge::load_roms(INESReader& reader)
@@ -80,12 +63,31 @@ void Cartridge::load_roms(INESReader& reader)
     {
         // If no rom banks, expand to one bank of chr ram.
         chr_rom_.resize(chr_bank_sz);
+        has_chr_ram_ = true;
     }
 
+    rom_hash_ = hash_bytes(prg_rom_);
+    if (!has_chr_ram_)
+        rom_hash_ = hash_bytes(chr_rom_, rom_hash_);
+
     if (h.has_prg_ram_)
         battery_.reset(new Battery(Battery::make_save_filepath(reader.filepath_)));
 
     mapper_.reset(Mapper::create(h.mapper_, *this));
+    mapper_code_ = h.mapper_;
+}
+
+void Cartridge::serialize_state(StateStream& state)
+{
+    state.process(wram_);
+
+    if (has_chr_ram_)
+        state.process(std::span(chr_rom_));
+
+    if (battery_)
+        state.process(battery_->memory());
+
+    visit_mapper([&](auto& mapper) { mapper.serialize_state(state, *this); });
 }
 
 BankView Cartridge::get_cpu_mapped_bank(address_t addr) const
@@ -3,10 +3,14 @@
 #include "battery.h"
 #include "types.h"
 
-#include <ranges>
+#include <memory>
+#include <span>
+#include <vector>
 
+class BUS;
 class INESReader;
 class Mapper;
+class StateStream;
 
 struct BankView
 {
@@ -74,19 +78,30 @@ public:
 
     address_t map_to_cpu_addr(address_t addr);
 
-    bool on_cpu_read(address_t addr, byte_t& value);
-    bool on_cpu_write(address_t addr, byte_t value);
-    bool on_ppu_read(address_t addr, byte_t& value);
-    bool on_ppu_write(address_t addr, byte_t value);
+    // Hot paths, defined in mappers/dispatch.h so they inline into the bus.
+    inline bool on_cpu_read(address_t addr, byte_t& value);
+    inline bool on_cpu_write(address_t addr, byte_t value);
+    inline bool on_ppu_read(address_t addr, byte_t& value);
+    inline bool on_ppu_write(address_t addr, byte_t value);
 
     void on_ppu_scanline(int scanline);
 
+    const byte_t* get_cpu_page(address_t addr);
+
     void load_roms(INESReader& reader);
 
     BankView get_cpu_mapped_bank(address_t addr) const;
     const MemoryMap& get_mapped_prg() const;
     const MemoryMap& get_mapped_chr() const;
 
+    byte_t get_mapper_code() const { return mapper_code_; }
+
+    // Hash of the PRG and CHR ROM, save states reference the ROM by it.
+    uint64_t get_rom_hash() const { return rom_hash_; }
+
+    // WRAM, CHR-RAM and mapper registers, ROM data is not saved.
+    void serialize_state(StateStream& state);
+
     size_t calc_prg_offset(int idx, size_t bank_sz = prg_bank_sz) const;
     size_t calc_chr_offset(int idx, size_t bank_sz = chr_bank_sz) const;
 
@@ -95,11 +110,18 @@ public:
     std::span<byte_t> get_chr_bank(int idx, size_t bank_sz = chr_bank_sz);
     std::span<const byte_t> get_chr_bank(int idx, size_t bank_sz = chr_bank_sz) const;
 
-    auto get_prg_banks() const { return std::views::chunk(prg_rom_, prg_bank_sz); }
-    auto get_chr_banks() const { return std::views::chunk(chr_rom_, chr_bank_sz); }
+    size_t get_prg_bank_count() const { return prg_rom_.size() / prg_bank_sz; }
+    size_t get_chr_bank_count() const { return chr_rom_.size() / chr_bank_sz; }
+
+    // Calls f with the mapper downcast to its concrete (final) type, see mappers/dispatch.h.
+    template <typename F>
+    decltype(auto) visit_mapper(F&& f);
 
 private:
     std::unique_ptr<Mapper> mapper_;
+    byte_t mapper_code_ = 0;
+    uint64_t rom_hash_ = 0;
+    bool has_chr_ram_ = false;
 
 public:
     static constexpr size_t prg_bank_sz = 0x4000;
@@ -110,4 +132,10 @@ public:
     std::vector<byte_t> chr_rom_;
 
     std::unique_ptr<Battery> battery_;
+
+    // Mapper register writes that remapped a PRG or CHR bank, not saved
+    uint64_t bank_switches_ = 0;
+
+    // Set by BUS::load_cartridge, lets mappers reach the cpu (IRQ) and the ppu (mirroring).
+    BUS* bus_ = nullptr;
 };
\ No newline at end of file
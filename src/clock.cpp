@@ -1,19 +1,19 @@
 #include "clock.h"
 
-#include "emulator.h"
+#include "ppu.h"
 
-#include <SFML/System.hpp>
+#include <algorithm>
 
-static sf::Clock global_clock_;
+static const std::chrono::steady_clock::time_point global_clock_start_ = std::chrono::steady_clock::now();
 
 time_unit Clock::now_ms()
 {
-    return global_clock_.getElapsedTime().asMilliseconds();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - global_clock_start_).count();
 }
 
 time_unit Clock::now_us()
 {
-    return global_clock_.getElapsedTime().asMicroseconds();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - global_clock_start_).count();
 }
 
 Timer::Timer(time_unit timeout)
@@ -49,24 +49,21 @@ void Timer::set_timeout(time_unit timeout)
 
 time_unit Timer::elapsed_us() const
 {
-    return std::max(Clock::now_us() - start_time_, 0ll);
+    return std::max<time_unit>(Clock::now_us() - start_time_, 0);
 }
 
-time_unit FPSCounter::get_ppu_fps()
+time_unit FPSCounter::get_ppu_fps(const PPU& ppu)
 {
     time_unit now = Clock::now_ms();
     if ((now - last_time_) < 1000ll)
         return fps_;
 
-    if (const PPU* ppu = Emulator::instance()->get_ppu())
+    time_unit frame = ppu.frame();
+    if (frame != last_ppu_frame_)
     {
-        time_unit frame = ppu->frame();
-        if (frame != last_ppu_frame_)
-        {
-            fps_ = frame - last_ppu_frame_;
-            last_ppu_frame_ = frame;
-            last_time_ = now;
-        }
+        fps_ = frame - last_ppu_frame_;
+        last_ppu_frame_ = frame;
+        last_time_ = now;
     }
 
     return fps_;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 
 using time_unit = int64_t;
 inline constexpr time_unit sixtieth_us = 1000000ll/60;
@@ -31,10 +32,12 @@ private:
     time_unit start_time_ = 0;
 };
 
+class PPU;
+
 class FPSCounter
 {
 public:
-    time_unit get_ppu_fps();
+    time_unit get_ppu_fps(const PPU& ppu);
 
 private:
     time_unit last_ppu_frame_ = 0;
@@ -1,5 +1,7 @@
 #include "controller.h"
 
+#include "save_state.h"
+
 bool Controller::on_read(address_t addr, byte_t& value) const
 {
     if (addr == 0x4016)
@@ -34,9 +36,23 @@ bool Controller::on_write(address_t addr, byte_t value)
 {
     if (addr == 0x4016)
     {
+        if (read_state_ == 0xFF && !(value & 0x01))
+        {
+            ++strobes_;
+            latched_ = state();
+        }
+
         read_state_ = (value & 0x01) ? 0xFF : 0;
         return  true;
     }
 
     return false;
-}
\ No newline at end of file
+}
+
+void Controller::serialize_state(StateStream& state)
+{
+    state.process(buttons_state_);
+    state.process(read_state_);
+    state.process(strobes_);
+    state.process(latched_);
+}
@@ -2,6 +2,8 @@
 
 #include "types.h"
 
+class StateStream;
+
 class Controller
 {
 public:
@@ -24,9 +26,21 @@ public:
     void press(Button button) { state() |= button; }
     void release(Button button) { state() &= ~button; }
 
+    byte_t get_state() const { return state(); }
+    void set_state(byte_t buttons) { state() = buttons; }
+
+    // Latches (strobe high then low) on $4016 and the buttons they caught.
+    // A frame without one is a lag frame, the game did not look at the input.
+    uint64_t get_strobe_count() const { return strobes_; }
+    byte_t get_latched_state() const { return latched_; }
+
+    void serialize_state(StateStream& state);
+
 private:
     byte_t buttons_state_ = 0;
     mutable byte_t read_state_ = 0;
+    uint64_t strobes_ = 0;
+    byte_t latched_ = 0;
 
     byte_t& state() { return buttons_state_; }
     byte_t state() const { return buttons_state_; }
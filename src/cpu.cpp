@@ -1,11 +1,15 @@
 #include "cpu.h"
 
 #include "bus.h"
+#include "call_profiler.h"
 #include "debugger.h"
+#include "hotspot_profiler.h"
 #include "ops.h"
 #include "ram.h"
+#include "save_state.h"
 #include "types.h"
 
+#include <functional>
 #include <stdexcept>
 
 #include <fmt/format.h>
@@ -83,14 +87,21 @@ CPU::State CPU::step_fetch_()
         nmi_requested_ = false;
 
         if (idle_ticks_ > 0)
+        {
+            if (profiler_) [[unlikely]]
+                profiler_->on_interrupt(program_counter_, idle_ticks_);
+
+            if (call_profiler_) [[unlikely]]
+                call_profiler_->on_interrupt(program_counter_, stack_pointer_, idle_ticks_);
+
             return kIRQ;
+        }
     }
 
     instr_ = fetch_instr_(program_counter_);
 
-#if 0
-    log_(instr_);
-#endif
+    if (tracer_) [[unlikely]]
+        log_(instr_);
 
     if (opcode_data(instr_.opcode).operation == kUKN)
     {
@@ -109,8 +120,15 @@ CPU::State CPU::step_fetch_()
         idle_ticks_ += idle_ticks_from_addressing_(instr_);
 
     instr_.time = idle_ticks_ + 1;
+
+    // Before it executes, the bank it was fetched from is still mapped
+    if (profiler_) [[unlikely]]
+        profiler_->on_instruction(program_counter_, instr_.time);
+
+    if (call_profiler_) [[unlikely]]
+        call_profiler_->on_instruction(instr_.time);
     
-    Debugger::instance()->on_cpu_fetch(*this);
+    bus_->debugger_.on_cpu_fetch(*this);
 
     return kIdle;
 }
@@ -121,6 +139,9 @@ auto CPU::step_execute_() -> State
     program_counter_ += opcode_data(instr_.opcode).get_size();
     exec_(instr_);
 
+    if (call_profiler_) [[unlikely]]
+        call_profiler_->on_execute(instr_.meta.operation, program_counter_, stack_pointer_);
+
     auto& entry = stats_.data_[instr_.opcode];
     if (entry.count_ > 0)
     {
@@ -217,7 +238,6 @@ void CPU::reset()
 {
     old_pc_ = 0x0000;
     program_counter_ = load_addr_(0xFFFC);
-    //program_counter_ = 0x8000; //for CPU tests with nestest.nes
 
     accumulator_ = 0;
     register_x_ = 0;
@@ -233,6 +253,32 @@ void CPU::reset()
     state_ = kIRQ;
 }
 
+// The call stats are debugging data, they are not part of the machine state.
+void CPU::serialize_state(StateStream& state)
+{
+    state.process(state_);
+    state.process(cycle_);
+    state.process(idle_ticks_);
+    state.process(program_counter_);
+    state.process(old_pc_);
+
+    state.process(accumulator_);
+    state.process(register_x_);
+    state.process(register_y_);
+    state.process(status_);
+    state.process(stack_pointer_);
+
+    state.process(irq_requested_);
+    state.process(nmi_requested_);
+
+    state.process(instr_.opcode);
+    state.process(instr_.operands);
+    state.process(instr_.time);
+
+    if (!state.is_writing())
+        instr_.meta = opcode_data(instr_.opcode);
+}
+
 void CPU::pull_irq()
 {
     irq_requested_ = true;
@@ -246,24 +292,19 @@ void CPU::pull_nmi()
 void CPU::log_(Instr instr)
 {
     auto& opdata = opcode_data(instr.opcode);
-    auto it = log_ring_[log_idx_].begin();
-    
-    it = fmt::format_to(it, "{:04x}    {:02x}", program_counter_, instr.opcode);
-
-    if (opdata.get_size() > 1)
-        it = fmt::format_to(it, "  {:02x}", instr.operands[0]);
-    else
-        it = fmt::format_to(it, "    ");
-
-    if (opdata.get_size() > 2)
-        it = fmt::format_to(it, "  {:02x}", instr.operands[1]);
-    else
-        it = fmt::format_to(it, "    ");
-
-    it = fmt::format_to(it, " {} {:<27}", opdata.str, debug_addr_(opdata.addressing, instr.to_addr()));
-    fmt::format_to(it, " A:{:02x} X:{:02x} Y:{:02x} P:{:02x} SP:{:02x}", accumulator_, register_x_, register_y_, status_, stack_pointer_);
-
-    //fmt::print("{}\n", log_ring_[log_idx_].data());
+    auto& line = log_ring_[log_idx_];
+
+    // The last byte stays for the terminator
+    const auto [it, size] = fmt::format_to_n(line.begin(), line.size() - 1,
+        "{:04x}    {:02x}{}{} {} {:<27} A:{:02x} X:{:02x} Y:{:02x} P:{:02x} SP:{:02x} CYC:{}",
+        program_counter_, instr.opcode,
+        opdata.get_size() > 1 ? fmt::format("  {:02x}", instr.operands[0]) : "    ",
+        opdata.get_size() > 2 ? fmt::format("  {:02x}", instr.operands[1]) : "    ",
+        opdata.str, debug_addr_(opdata.addressing, instr.to_addr()),
+        accumulator_, register_x_, register_y_, status_, stack_pointer_, cycle_);
+    *it = '\0';
+
+    tracer_->on_instruction({ line.data(), static_cast<size_t>(it - line.begin()) });
     (++log_idx_) %= 64;
 }
 
@@ -7,9 +7,21 @@
 #include <vector>
 #include <tuple>
 #include <string>
+#include <string_view>
 
 class BUS;
+class CallProfiler;
+class HotspotProfiler;
+class StateStream;
 
+// Receives a nestest style line for every instruction, before it executes:
+// PC, opcode bytes, disassembly, A/X/Y/P/SP and the cycle.
+class CpuTracer
+{
+public:
+    virtual ~CpuTracer() = default;
+    virtual void on_instruction(std::string_view line) = 0;
+};
 
 struct CallStats
 {
@@ -96,6 +108,9 @@ public:
     void step();
     void reset();
 
+    // nestest's automation mode starts at $C000 instead of the reset vector
+    void set_program_counter(address_t addr) { program_counter_ = addr; }
+
     void dma_clock() { ++cycle_; }
 
     void pull_irq();
@@ -103,7 +118,20 @@ public:
 
     CPU_State const& get_state() const { return *this; }
 
-    std::array<std::array<char, 80>, 64> log_ring_;
+    // For test harnesses, the state_ and idle_ticks_ set where the next step() resumes.
+    void set_state(const CPU_State& state) { static_cast<CPU_State&>(*this) = state; }
+
+    void serialize_state(StateStream& state);
+
+    // Not owned, nullptr (the default) turns the trace off.
+    void set_tracer(CpuTracer* tracer) { tracer_ = tracer; }
+
+    // Not owned, nullptr (the default) turns the profiling off.
+    void set_profiler(HotspotProfiler* profiler) { profiler_ = profiler; }
+    void set_call_profiler(CallProfiler* profiler) { call_profiler_ = profiler; }
+
+    // The last traced lines, zero terminated
+    std::array<std::array<char, 96>, 64> log_ring_ {};
     int log_idx_ = 0;
 
 private:
@@ -122,6 +150,10 @@ private:
     // bus
     BUS* bus_ = nullptr;
 
+    CpuTracer* tracer_ = nullptr;
+    HotspotProfiler* profiler_ = nullptr;
+    CallProfiler* call_profiler_ = nullptr;
+
     // bus access
     void store_(address_t addr, byte_t operand);
     void store_(address_t addr, address_t addr_value);
@@ -0,0 +1,248 @@
+#include "cpu_test_vectors.h"
+
+#include "bus.h"
+#include "cpu.h"
+#include "emulator.h"
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+namespace nl = nlohmann;
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+    // The longest instruction is 7 cycles, anything past this is a runaway
+    constexpr int max_cycles = 16;
+
+    // B and the unused bit only exist on the stack
+    constexpr byte_t status_mask = static_cast<byte_t>(~(CPU_State::kBreak | CPU_State::kDummy));
+
+    class VectorContext
+    {
+    public:
+        VectorContext()
+            : memory_(0x10000, 0)
+        {
+            emulator_.set_verbose(false);
+            emulator_.set_host_break(false);
+            emulator_.get_bus()->set_flat_memory(memory_.data());
+        }
+
+        // Empty on success, otherwise what differed
+        std::string run(const nl::json& vector)
+        {
+            const nl::json& initial = vector.at("initial");
+            const nl::json& expected = vector.at("final");
+
+            CPU_State state;
+            state.state_ = CPU_State::kFetching;
+            state.program_counter_ = initial.at("pc").get<address_t>();
+            state.stack_pointer_ = initial.at("s").get<byte_t>();
+            state.accumulator_ = initial.at("a").get<byte_t>();
+            state.register_x_ = initial.at("x").get<byte_t>();
+            state.register_y_ = initial.at("y").get<byte_t>();
+            state.status_ = initial.at("p").get<byte_t>();
+
+            for (const nl::json& cell : initial.at("ram"))
+                memory_[cell.at(0).get<address_t>()] = cell.at(1).get<byte_t>();
+
+            CPU& cpu = *emulator_.get_cpu();
+            cpu.set_state(state);
+
+            std::string error;
+            int cycles = 0;
+            try
+            {
+                do
+                {
+                    cpu.step();
+                } while (cpu.get_state().state_ != CPU_State::kFetching && ++cycles < max_cycles);
+
+                ++cycles;
+            }
+            catch (const std::exception& e)
+            {
+                error = e.what();
+            }
+
+            if (error.empty())
+                error = compare_(expected, cycles, vector.at("cycles").size());
+
+            // Only the listed cells were touched, the memory is clean again for the next vector
+            for (const nl::json& cell : initial.at("ram"))
+                memory_[cell.at(0).get<address_t>()] = 0;
+            for (const nl::json& cell : expected.at("ram"))
+                memory_[cell.at(0).get<address_t>()] = 0;
+
+            return error;
+        }
+
+    private:
+        std::string compare_(const nl::json& expected, int cycles, size_t expected_cycles) const
+        {
+            const CPU_State& state = emulator_.get_cpu()->get_state();
+            std::string error;
+
+            auto check = [&](std::string_view name, unsigned actual, unsigned wanted, int width)
+            {
+                if (actual != wanted)
+                    error += fmt::format("{} ${:0{}X} expected ${:0{}X}; ", name, actual, width, wanted, width);
+            };
+
+            check("PC", state.program_counter_, expected.at("pc").get<address_t>(), 4);
+            check("S", state.stack_pointer_, expected.at("s").get<byte_t>(), 2);
+            check("A", state.accumulator_, expected.at("a").get<byte_t>(), 2);
+            check("X", state.register_x_, expected.at("x").get<byte_t>(), 2);
+            check("Y", state.register_y_, expected.at("y").get<byte_t>(), 2);
+            check("P", state.status_ & status_mask, expected.at("p").get<byte_t>() & status_mask, 2);
+
+            for (const nl::json& cell : expected.at("ram"))
+            {
+                const address_t addr = cell.at(0).get<address_t>();
+                check(fmt::format("[${:04X}]", addr), memory_[addr], cell.at(1).get<byte_t>(), 2);
+            }
+
+            if (static_cast<size_t>(cycles) != expected_cycles)
+                error += fmt::format("{} cycles expected {}; ", cycles, expected_cycles);
+
+            if (!error.empty())
+                error.resize(error.size() - 2);
+
+            return error;
+        }
+
+        std::vector<byte_t> memory_;
+        Emulator emulator_;
+    };
+
+    CpuVectorStats run_vectors(VectorContext& context, const nl::json& vectors, std::string_view name, size_t max_failures)
+    {
+        CpuVectorStats stats;
+        stats.files_ = 1;
+
+        for (const nl::json& vector : vectors)
+        {
+            ++stats.vectors_;
+
+            // Unofficial opcodes the CPU does not implement would only throw
+            const nl::json& ram = vector.at("initial").at("ram");
+            const address_t pc = vector.at("initial").at("pc").get<address_t>();
+            const auto opcode = std::ranges::find_if(ram, [pc](const nl::json& cell) { return cell.at(0).get<address_t>() == pc; });
+
+            if (opcode != ram.end() && ops::opcode_data(opcode->at(1).get<byte_t>()).operation == ops::kUKN)
+            {
+                ++stats.skipped_;
+                continue;
+            }
+
+            const std::string error = context.run(vector);
+            if (error.empty())
+            {
+                ++stats.passed_;
+                continue;
+            }
+
+            ++stats.failed_;
+            if (stats.failures_.size() < max_failures)
+                stats.failures_.push_back(fmt::format("{}: {}: {}", name, vector.value("name", std::string()), error));
+        }
+
+        return stats;
+    }
+}
+
+void CpuVectorStats::merge(CpuVectorStats&& other, size_t max_failures)
+{
+    files_ += other.files_;
+    vectors_ += other.vectors_;
+    passed_ += other.passed_;
+    failed_ += other.failed_;
+    skipped_ += other.skipped_;
+    errors_ += other.errors_;
+
+    for (std::string& failure : other.failures_)
+    {
+        if (failures_.size() >= max_failures)
+            break;
+        failures_.push_back(std::move(failure));
+    }
+}
+
+CpuTestVectors::CpuTestVectors(size_t threads, size_t max_failures)
+    : threads_(threads ? threads : std::thread::hardware_concurrency())
+    , max_failures_(max_failures)
+{
+}
+
+CpuVectorStats CpuTestVectors::run(std::span<const stdfs::path> files) const
+{
+    std::vector<CpuVectorStats> results(files.size());
+
+    const size_t threads = std::clamp<size_t>(threads_, 1, std::max<size_t>(files.size(), 1));
+
+    // The files are picked in order by whichever thread is free, each has its own CPU and memory
+    std::atomic<size_t> next = 0;
+    auto work = [&]
+    {
+        VectorContext context;
+        for (size_t idx = next++; idx < files.size(); idx = next++)
+        {
+            const std::string name = files[idx].filename().string();
+            try
+            {
+                std::ifstream ifs(files[idx]);
+                if (!ifs)
+                    throw std::runtime_error("Can't open file");
+
+                results[idx] = run_vectors(context, nl::json::parse(ifs), name, max_failures_);
+            }
+            catch (const std::exception& e)
+            {
+                results[idx].files_ = 1;
+                results[idx].errors_ = 1;
+                results[idx].failures_.push_back(fmt::format("{}: {}", name, e.what()));
+            }
+        }
+    };
+
+    std::vector<std::jthread> workers;
+    for (size_t i = 1; i < threads; ++i)
+        workers.emplace_back(work);
+
+    work();
+    workers.clear();
+
+    // Merged in file order, the failures listed don't depend on the scheduling
+    CpuVectorStats stats;
+    for (CpuVectorStats& result : results)
+        stats.merge(std::move(result), max_failures_);
+
+    return stats;
+}
+
+CpuVectorStats CpuTestVectors::run_stream(std::istream& is, std::string_view name) const
+{
+    VectorContext context;
+    return run_vectors(context, nl::json::parse(is), name, max_failures_);
+}
+
+std::vector<stdfs::path> CpuTestVectors::find_files(const stdfs::path& dir)
+{
+    std::vector<stdfs::path> files;
+    for (const auto& entry : stdfs::recursive_directory_iterator(dir))
+    {
+        std::string ext = entry.path().extension().string();
+        std::ranges::transform(ext, ext.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (entry.is_regular_file() && ext == ".json")
+            files.push_back(entry.path());
+    }
+
+    std::ranges::sort(files);
+    return files;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+struct CpuVectorStats
+{
+    size_t files_ = 0;
+    size_t vectors_ = 0;
+    size_t passed_ = 0;
+    size_t failed_ = 0;
+    size_t skipped_ = 0; // opcodes the CPU does not implement
+    size_t errors_ = 0; // files that could not be read
+    std::vector<std::string> failures_; // the first ones, "file: name: what"
+
+    void merge(CpuVectorStats&& other, size_t max_failures);
+};
+
+// Runs single-step processor test vectors (one JSON file per opcode, each an array of
+// { name, initial, final, cycles }) against CPU, on a flat 64KB bus.
+// Registers, the listed memory and the cycle count are checked. The per-cycle bus activity
+// is not: CPU does its accesses at the end of the instruction, not cycle by cycle.
+// The NES variant of the vectors is expected, the decimal flag has no effect on the 2A03.
+class CpuTestVectors
+{
+public:
+    explicit CpuTestVectors(size_t threads = 0, size_t max_failures = 32);
+
+    // Files are spread over the threads
+    CpuVectorStats run(std::span<const stdfs::path> files) const;
+
+    // One file worth of vectors, on the calling thread
+    CpuVectorStats run_stream(std::istream& is, std::string_view name) const;
+
+    // .json files under the directory, sorted
+    static std::vector<stdfs::path> find_files(const stdfs::path& dir);
+
+private:
+    size_t threads_;
+    size_t max_failures_;
+};
@@ -5,8 +5,6 @@
 
 #include <algorithm>
 
-Debugger* Debugger::instance_ = nullptr;
-
 bool Breakpoint::check(const CPU_State& state) const
 {
     switch (reason_)
@@ -28,8 +26,6 @@ bool Breakpoint::check(const CPU_State& state) const
 Debugger::Debugger(Emulator& emulator)
     : emulator_(emulator)
 {
-    NES_ASSERT(instance_ == nullptr);
-    instance_ = this;
 }
 
 void Debugger::request_break(Mode mode)
@@ -51,6 +47,8 @@ void Debugger::resume()
 
 void Debugger::on_cpu_fetch(const CPU_State& state)
 {
+    ++hook_calls_;
+
     if (requested_mode_ == MODE_CPU_FETCH)
         mode_ = requested_mode_;
 
@@ -60,12 +58,16 @@ void Debugger::on_cpu_fetch(const CPU_State& state)
 
 void Debugger::on_ppu_frame()
 {
+    ++hook_calls_;
+
     if (requested_mode_ == MODE_PPU_FRAME)
         mode_ = requested_mode_;
 }
 
 void Debugger::on_ppu_line()
 {
+    ++hook_calls_;
+
     if (requested_mode_ == MODE_PPU_LINE)
         mode_ = requested_mode_;
 }
@@ -35,8 +35,6 @@ public:
 public:
     Debugger(Emulator& emulator);
 
-    static Debugger* instance() { return instance_; }
-
     Mode get_mode() const { return mode_; }
 
     void request_break(Mode mode);
@@ -48,12 +46,14 @@ public:
     void on_ppu_frame();
     void on_ppu_line();
 
+    // Calls of the on_* hooks since construction
+    uint64_t get_hook_calls() const { return hook_calls_; }
+
     std::vector<Breakpoint> breakpoints_;
 
 private:
     Emulator& emulator_;
     Mode mode_ = MODE_RUNNING;
     Mode requested_mode_ = MODE_RUNNING;
-
-    static Debugger* instance_;
+    uint64_t hook_calls_ = 0;
 };
\ No newline at end of file
@@ -18,15 +18,14 @@ void Disassembler::load(const BUS& bus)
     if (cart_ == nullptr)
         return;
 
-    auto rom_banks = cart_->get_prg_banks();
-    const int count = static_cast<int>(std::size(rom_banks));
+    const int count = static_cast<int>(cart_->get_prg_bank_count());
 
     banks_.reserve(count);
 
     for (int i = 0; i < count; ++i)
     {
         PrgBank& bank = banks_.emplace_back();
-        bank.rom_ = &*std::begin(rom_banks[i]);
+        bank.rom_ = cart_->prg_rom_.data() + i * Cartridge::prg_bank_sz;
         bank.rom_bank_idx_ = i;
 
         load_bank_(bank, bank.rom_, rom_size);
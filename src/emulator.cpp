@@ -1,14 +1,13 @@
 #include "emulator.h"
 
 #include "types.h"
-#include "clock.h"
 #include "ines.h"
-
-#include "ui/global.h"
+#include "hash.h"
+#include "save_state.h"
 
 #include <fmt/core.h>
-#include <fmt/xchar.h>
 
+#include <array>
 #include <stdexcept>
 
 Emulator::Emulator()
@@ -18,24 +17,20 @@ Emulator::Emulator()
     , ram_(new RAM)
     , debugger_(*this)
 {
-    bus_.reset(new BUS(*cpu_, *apu_, *ppu_, *ram_));
+    bus_.reset(new BUS(*cpu_, *apu_, *ppu_, *ram_, debugger_));
     cpu_->init(bus_.get());
+    apu_->init(bus_.get());
     ppu_->init(bus_.get());
-
-    NES_ASSERT(instance_ == nullptr);
-    instance_ = this;
 }
 
-Emulator::~Emulator()
-{
-    memset(&instance_, 0xDEAD, sizeof(instance_));
-}
+Emulator::~Emulator() = default;
 
 void Emulator::read_rom(std::wstring_view filename)
 {
     cart_.reset();
-    
-    fmt::print(L"Loading {}\n\n", filename);
+
+    if (verbose_)
+        fmt::print("Loading {}\n\n", stdfs::path(filename).string());
 
     INESReader reader;
     if (!reader.read_from_file(filename))
@@ -65,29 +60,45 @@ void Emulator::read_rom(std::wstring_view filename)
         return "UNKNOWN"sv;
     };
 
-    fmt::print("config:\n    iNES version: {}\n    mirroring: {}\n    battery: {}\n    trainer: {}\n\n",
-        h.is_ines2_ ? "2" : "1",
-        mirroring_name(),
-        h.has_prg_ram_,
-        h.has_trainer_);
-
     // Compatibility
     if (!h.is_ines2_ && h.prg_ram_size_ == 0)
         h.prg_ram_size_ = 1;
 
-    fmt::print("num_16kb_prg_rom_banks: {}\n", h.prg_rom_size_);
-    fmt::print("num_8kb_chr_rom_banks: {}\n", h.chr_rom_size_);
-    fmt::print("num_8kb_prg_ram_banks: {}\n", h.prg_ram_size_);
+    if (verbose_)
+    {
+        fmt::print("config:\n    iNES version: {}\n    mirroring: {}\n    battery: {}\n    trainer: {}\n\n",
+            h.is_ines2_ ? "2" : "1",
+            mirroring_name(),
+            h.has_prg_ram_,
+            h.has_trainer_);
+
+        fmt::print("num_16kb_prg_rom_banks: {}\n", h.prg_rom_size_);
+        fmt::print("num_8kb_chr_rom_banks: {}\n", h.chr_rom_size_);
+        fmt::print("num_8kb_prg_ram_banks: {}\n", h.prg_ram_size_);
+    }
 
     cart_.reset(new Cartridge);
     cart_->load_roms(reader);
+    rom_path_ = filename;
 
     ppu_->set_mirroring(h.mirroring_);
 
     bus_->load_cartridge(cart_.get());
     disassembler_.load(*bus_);
 
-    ui::push_recent_file(filename);
+    // Off, the profilers let go of the old cartridge and its counts, set_*profiling attaches this one
+    profiler_.attach(profiling_ ? cart_.get() : nullptr);
+    call_profiler_.attach(call_profiling_ ? cart_.get() : nullptr);
+
+    power_on();
+}
+
+// A new cartridge is a power cycle: memory is cleared, which also keeps reused instances deterministic.
+void Emulator::power_on()
+{
+    ram_->clear();
+    ppu_->power_on();
+    bus_->ctrl_ = {};
 
     reset();
 }
@@ -99,6 +110,9 @@ void Emulator::reset()
     ppu_->reset();
     cycle_ = 0;
     dma_cycle_counter_ = 0;
+    dma_page_copied_ = false;
+
+    call_profiler_.on_reset();
 }
 
 void Emulator::update()
@@ -108,10 +122,16 @@ void Emulator::update()
 
     if (is_stepping())
     {
+        error_.clear();
+
+        if (instrumentation_.is_enabled())
+            instrumentation_.begin_frame(cart_->bank_switches_, debugger_.get_hook_calls());
+
         cpu_cycle_start_of_frame = get_cpu()->get_state().cycle_;
         ppu_cycle_start_of_frame = get_ppu()->get_state().cycle_counter_;
 
-        while (!ppu_->grab_frame_done())
+        bool frame_done = false;
+        while (!(frame_done = ppu_->grab_frame_done()))
         {
             try
             {
@@ -120,16 +140,21 @@ void Emulator::update()
 
                 clock_ppu_();
             }
-            catch (std::exception e)
+            catch (const std::exception& e)
             {
-                fmt::print("Exception: {}\n", e.what());
-                NES_BREAKPOINT;
+                error_ = e.what();
+                if (verbose_)
+                    fmt::print("Exception: {}\n", e.what());
+                if (host_break_)
+                    NES_BREAKPOINT;
                 debugger_.break_now();
                 break;
             }
             catch (...)
             {
-                NES_BREAKPOINT;
+                error_ = "unknown exception";
+                if (host_break_)
+                    NES_BREAKPOINT;
                 debugger_.break_now();
                 break;
             }
@@ -146,8 +171,98 @@ void Emulator::update()
 
             const uint64_t ppu_cycle = get_ppu()->get_state().cycle_counter_;
             ppu_cycle_per_frame = ppu_cycle - ppu_cycle_start_of_frame;
+
+            instrumentation_.run(Subsystem::APU, [&]
+            {
+                apu_->end_frame(cpu_cycle);
+                flush_audio_();
+            });
+        }
+
+        if (frame_hashing_ && frame_done)
+        {
+            const PPU::Output& output = ppu_->output();
+            frame_hashes_.frame_ = ppu_->frame();
+            frame_hashes_.output_ = hash_bytes({ output.data(), output.size() });
+            frame_hashes_.state_ = hash_state();
         }
+
+        if (instrumentation_.is_enabled())
+            instrumentation_.end_frame(ppu_->frame(), cart_->bank_switches_, debugger_.get_hook_calls());
+    }
+}
+
+void Emulator::save_state(std::vector<byte_t>& buffer)
+{
+    if (!is_ready())
+        throw std::runtime_error("No cartridge loaded");
+
+    SaveStateHeader header;
+    header.mapper_ = cart_->get_mapper_code();
+    header.rom_hash_ = cart_->get_rom_hash();
+
+    buffer.clear();
+    StateStream state(buffer);
+    state.process(header);
+    serialize_state_(state);
+
+    // Patch the size in, now that it is known
+    header.size_ = buffer.size();
+    std::memcpy(buffer.data(), &header, sizeof(header));
+}
+
+void Emulator::load_state(std::span<const byte_t> buffer)
+{
+    if (!is_ready())
+        throw std::runtime_error("No cartridge loaded");
+
+    StateStream state(buffer);
+    SaveStateHeader header;
+    state.process(header);
+
+    if (!state.good() || header.magic_ != save_state_magic)
+        throw std::runtime_error("Not a save state");
+
+    if (header.version_ != save_state_version)
+        throw std::runtime_error(fmt::format("Unsupported save state version {}", header.version_));
+
+    if (header.mapper_ != cart_->get_mapper_code() || header.rom_hash_ != cart_->get_rom_hash())
+        throw std::runtime_error("Save state is for another ROM");
+
+    if (header.size_ != buffer.size())
+        throw std::runtime_error("Truncated save state");
+
+    // A bad body is only seen while the components read it
+    load_backup_.clear();
+    StateStream backup(load_backup_);
+    serialize_state_(backup);
+
+    serialize_state_(state);
+
+    if (!state.good())
+    {
+        StateStream restore { std::span<const byte_t>(load_backup_) };
+        serialize_state_(restore);
+        throw std::runtime_error("Corrupted save state");
     }
+
+    // The mapper registers changed without a bank switch, the stack without calls
+    profiler_.invalidate_mapping();
+    call_profiler_.resync(cpu_->get_state().stack_pointer_);
+}
+
+void Emulator::serialize_state_(StateStream& state)
+{
+    cpu_->serialize_state(state);
+    ppu_->serialize_state(state);
+    apu_->serialize_state(state);
+    state.process(ram_->memory());
+    bus_->ctrl_.serialize_state(state);
+    cart_->serialize_state(state);
+
+    state.process(cycle_);
+    state.process(dma_cycle_counter_);
+    state.process(dma_page_copied_);
 }
 
 void Emulator::toggle_pause()
@@ -162,6 +277,72 @@ void Emulator::toggle_pause()
     paused_ = !paused_;
 }
 
+void Emulator::set_audio_sink(AudioSink* sink)
+{
+    audio_sink_ = sink;
+    if (audio_sink_)
+        apu_->set_sample_rate(audio_sink_->sample_rate());
+}
+
+void Emulator::set_audio_muted(bool muted)
+{
+    audio_muted_ = muted;
+    apu_->set_muted(muted);
+}
+
+void Emulator::flush_audio_()
+{
+    if (!audio_sink_ || audio_muted_)
+        return;
+
+    std::array<int16_t, 0x400> samples;
+    while (const int count = apu_->read_samples(samples))
+        audio_sink_->push(std::span(samples).first(count));
+}
+
+uint64_t Emulator::hash_state() const
+{
+    const CPU_State& cpu = cpu_->get_state();
+
+    // Registers packed, the struct padding is not hashed
+    const std::array<byte_t, 7> regs = {
+        static_cast<byte_t>(cpu.program_counter_), static_cast<byte_t>(cpu.program_counter_ >> 8),
+        cpu.accumulator_, cpu.register_x_, cpu.register_y_, cpu.status_, cpu.stack_pointer_,
+    };
+
+    uint64_t hash = hash_bytes({ ram_->data(), 0x800 });
+    hash = hash_bytes({ ppu_->data(), 0x1000 }, hash);
+    hash = hash_bytes(ppu_->palette_data(), hash);
+    hash = hash_bytes({ ppu_->oam_data(), 0x100 }, hash);
+    return hash_bytes(regs, hash);
+}
+
+void Emulator::set_instrumented(bool enabled)
+{
+    instrumentation_.set_enabled(enabled);
+    bus_->set_counters(enabled ? &instrumentation_.bus_counters() : nullptr);
+}
+
+void Emulator::set_profiling(bool enabled)
+{
+    profiling_ = enabled;
+
+    if (enabled && profiler_.get_cart() != cart_.get())
+        profiler_.attach(cart_.get());
+
+    cpu_->set_profiler(enabled ? &profiler_ : nullptr);
+}
+
+void Emulator::set_call_profiling(bool enabled)
+{
+    call_profiling_ = enabled;
+
+    if (enabled && call_profiler_.get_cart() != cart_.get())
+        call_profiler_.attach(cart_.get());
+
+    cpu_->set_call_profiler(enabled ? &call_profiler_ : nullptr);
+}
+
 void Emulator::press_button(Controller::Button button)
 {
     bus_->ctrl_.press(button);
@@ -176,27 +357,41 @@ NES_DEOPTIMIZE
 // NTSC emulation: 29780.5 cpu cycles per frame: ~60 Hz
 void Emulator::clock_cpu_()
 {
-    apu_->step();
+    instrumentation_.run(Subsystem::APU, [&] { apu_->step(cpu_->get_state().cycle_); });
 
     if (dma_cycle_counter_ == 0)
     {
-        cpu_->step();
+        instrumentation_.run(Subsystem::CPU, [&] { cpu_->step(); });
     }
     else
     {
-        --dma_cycle_counter_;
-        if ((dma_cycle_counter_ & 0x1) == 0 && dma_cycle_counter_ < 512)
-            ppu_->dma_copy_byte(255_byte - int_cast<byte_t>(dma_cycle_counter_ / 2));
-        cpu_->dma_clock();
+        instrumentation_.run(Subsystem::DMA, [&]
+        {
+            --dma_cycle_counter_;
+            if (!dma_page_copied_ && (dma_cycle_counter_ & 0x1) == 0 && dma_cycle_counter_ < 512)
+                ppu_->dma_copy_byte(255_byte - int_cast<byte_t>(dma_cycle_counter_ / 2));
+            cpu_->dma_clock();
+
+            if (profiling_) [[unlikely]]
+                profiler_.on_dma_cycle();
+        });
     }
 
     if (ppu_->grab_dma_request())
-        dma_cycle_counter_ = 513 + (cpu_->get_state().cycle_ & 0x1);
+    {
+        // The cpu is stalled for the whole transfer, so a RAM/ROM page can be copied at once.
+        // I/O pages keep the per-byte reads. Both paths charge the same 513/514 cycles.
+        instrumentation_.run(Subsystem::DMA, [&]
+        {
+            dma_cycle_counter_ = 513 + (cpu_->get_state().cycle_ & 0x1);
+            dma_page_copied_ = ppu_->dma_copy_page();
+        });
+    }
 }
 
 void Emulator::clock_ppu_()
 {
-    ppu_->step();
+    instrumentation_.run(Subsystem::PPU, [&] { ppu_->step(); });
 
     // Debugging vblank timing
     uint64_t cycle = get_cpu()->get_state().cycle_;
@@ -1,17 +1,34 @@
 #pragma once
 
 #include <memory>
+#include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "bus.h"
 #include "cpu.h"
 #include "apu.h"
+#include "audio_sink.h"
 #include "ppu.h"
 #include "ram.h"
 #include "cartridge.h"
 #include "controller.h"
 #include "debugger.h"
 #include "disassembler.h"
+#include "call_profiler.h"
+#include "hotspot_profiler.h"
+#include "instrumentation.h"
+
+class StateStream;
+
+// Hashes of the frame that just completed, for golden regression runs.
+struct FrameHashes
+{
+    uint64_t frame_ = 0; // PPU frame number
+    uint64_t output_ = 0; // PPU::output()
+    uint64_t state_ = 0; // RAM, VRAM and CPU registers
+};
 
 class Emulator
 {
@@ -22,8 +39,24 @@ public:
     void read_rom(std::wstring_view filename);
 
     void reset();
+    void power_on();
     void update();
 
+    // Whole machine as a versioned binary blob, the ROM is referenced by hash.
+    // load_state throws on a blob from another ROM or version and leaves the machine untouched.
+    void save_state(std::vector<byte_t>& buffer);
+    void load_state(std::span<const byte_t> buffer);
+
+    // Prints the ROM header when loading, on by default.
+    void set_verbose(bool verbose) { verbose_ = verbose; }
+
+    // An exception in the emulation also traps into the host debugger, on by default.
+    // Without a debugger attached that ends the process, unattended runs turn it off.
+    void set_host_break(bool enabled) { host_break_ = enabled; }
+
+    // The message of the exception that stopped the last update, empty otherwise.
+    const std::string& get_error() const { return error_; }
+
     bool is_stepping() const { return !is_paused() && !is_debugging(); }
     bool is_debugging() const { return debugger_.get_mode() != Debugger::MODE_RUNNING; }
     bool is_paused() const { return paused_; }
@@ -31,6 +64,42 @@ public:
 
     void toggle_pause();
 
+    // The sink is not owned, it receives the APU samples at the end of every frame.
+    void set_audio_sink(AudioSink* sink);
+    AudioSink* get_audio_sink() const { return audio_sink_; }
+
+    // Frames emulated while muted don't reach the sink (run-ahead speculation).
+    void set_audio_muted(bool muted);
+
+    const stdfs::path& get_rom_path() const { return rom_path_; }
+
+    // Off by default, hashes the picture and the state at the end of every frame.
+    void set_frame_hashing(bool enabled) { frame_hashing_ = enabled; }
+    bool is_frame_hashing() const { return frame_hashing_; }
+    const FrameHashes& get_frame_hashes() const { return frame_hashes_; }
+
+    // RAM, PPU nametables, palette and OAM, CPU registers
+    uint64_t hash_state() const;
+
+    // Off by default, host time and event counts per subsystem for every frame.
+    void set_instrumented(bool enabled);
+    bool is_instrumented() const { return instrumentation_.is_enabled(); }
+    Instrumentation& get_instrumentation() { return instrumentation_; }
+    const Instrumentation& get_instrumentation() const { return instrumentation_; }
+
+    // Off by default, emulated cycles per instruction address and PRG bank.
+    // The counts are kept when it is turned off, and cleared with a new cartridge.
+    void set_profiling(bool enabled);
+    bool is_profiling() const { return profiling_; }
+    HotspotProfiler& get_profiler() { return profiler_; }
+    const HotspotProfiler& get_profiler() const { return profiler_; }
+
+    // Off by default, emulated cycles per subroutine and calling context, kept the same way.
+    void set_call_profiling(bool enabled);
+    bool is_call_profiling() const { return call_profiling_; }
+    CallProfiler& get_call_profiler() { return call_profiler_; }
+    const CallProfiler& get_call_profiler() const { return call_profiler_; }
+
     Disassembler disassembler_;
     Debugger debugger_;
 
@@ -38,13 +107,12 @@ public:
     CPU* get_cpu() const { return cpu_.get(); }
     PPU* get_ppu() const { return ppu_.get(); }
     APU* get_apu() const { return apu_.get(); }
+    RAM* get_ram() const { return ram_.get(); }
     Cartridge* get_cart() const { return cart_.get(); }
 
     void press_button(Controller::Button b);
     void release_button(Controller::Button b);
 
-    static Emulator* instance() { return instance_; }
-
     uint64_t cpu_cycle_at_vblank = 0;
     uint64_t cpu_cycle_last_vblank = 0;
     uint64_t cpu_cycle_start_of_frame = 0;
@@ -55,8 +123,8 @@ public:
 private:
     void clock_ppu_();
     void clock_cpu_();
-
-    inline static Emulator* instance_ = nullptr;
+    void flush_audio_();
+    void serialize_state_(StateStream& state);
 
     std::unique_ptr<BUS> bus_;
     std::unique_ptr<CPU> cpu_;
@@ -64,9 +132,30 @@ private:
     std::unique_ptr<PPU> ppu_;
     std::unique_ptr<RAM> ram_;
     std::unique_ptr<Cartridge> cart_;
+    stdfs::path rom_path_;
+
+    AudioSink* audio_sink_ = nullptr;
+    bool audio_muted_ = false;
+
+    bool frame_hashing_ = false;
+    FrameHashes frame_hashes_;
+
+    std::vector<byte_t> load_backup_; // the machine before a load, restored when the body is bad
+
+    Instrumentation instrumentation_;
+
+    HotspotProfiler profiler_;
+    bool profiling_ = false;
+
+    CallProfiler call_profiler_;
+    bool call_profiling_ = false;
 
     uint64_t cycle_ = 0;
     int dma_cycle_counter_ = 0;
+    bool dma_page_copied_ = false;
 
     bool paused_ = false;
+    bool verbose_ = true;
+    bool host_break_ = true;
+    std::string error_;
 };
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "emulator_pool.h"
+
+#include "emulator.h"
+#include "hash.h"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <stdexcept>
+
+EmulatorPool::EmulatorPool(size_t thread_count)
+{
+    thread_count = std::max<size_t>(thread_count, 1);
+
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i)
+        workers_.emplace_back(new Worker);
+
+    for (size_t i = 0; i < thread_count; ++i)
+        workers_[i]->thread_ = std::thread([this, i] { run_worker_(i); });
+}
+
+EmulatorPool::~EmulatorPool()
+{
+    {
+        std::lock_guard lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto& worker : workers_)
+        worker->thread_.join();
+}
+
+std::future<EmulatorJobResult> EmulatorPool::submit(EmulatorJob job)
+{
+    Task task { std::move(job), {} };
+    std::future<EmulatorJobResult> future = task.promise_.get_future();
+
+    Worker& worker = *workers_[next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size()];
+    {
+        std::lock_guard lock(worker.mutex_);
+        worker.queue_.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard lock(wake_mutex_);
+        ++pending_;
+    }
+    wake_.notify_one();
+
+    return future;
+}
+
+bool EmulatorPool::pop_task_(size_t idx, Task& task)
+{
+    // Own queue first, oldest job first.
+    {
+        Worker& worker = *workers_[idx];
+        std::lock_guard lock(worker.mutex_);
+        if (!worker.queue_.empty())
+        {
+            task = std::move(worker.queue_.front());
+            worker.queue_.pop_front();
+            return true;
+        }
+    }
+
+    // Steal the most recently queued job of another worker, it is the least likely to start soon.
+    for (size_t i = 1; i < workers_.size(); ++i)
+    {
+        Worker& victim = *workers_[(idx + i) % workers_.size()];
+        std::lock_guard lock(victim.mutex_);
+        if (!victim.queue_.empty())
+        {
+            task = std::move(victim.queue_.back());
+            victim.queue_.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void EmulatorPool::run_worker_(size_t idx)
+{
+    Worker& worker = *workers_[idx];
+
+    for (;;)
+    {
+        {
+            std::unique_lock lock(wake_mutex_);
+            wake_.wait(lock, [this] { return pending_ > 0 || stopping_; });
+
+            if (pending_ == 0)
+                return;
+
+            --pending_;
+        }
+
+        Task task;
+        if (!pop_task_(idx, task))
+            continue;
+
+        try
+        {
+            if (!worker.emulator_)
+            {
+                worker.emulator_.reset(new Emulator);
+                worker.emulator_->set_verbose(false);
+                worker.emulator_->set_host_break(false);
+            }
+
+            EmulatorJobResult result = run_job(*worker.emulator_, task.job_);
+            result.worker_ = idx;
+            task.promise_.set_value(std::move(result));
+        }
+        catch (...)
+        {
+            task.promise_.set_exception(std::current_exception());
+        }
+    }
+}
+
+EmulatorJobResult EmulatorPool::run_job(Emulator& emulator, const EmulatorJob& job)
+{
+    using clock = std::chrono::steady_clock;
+    const clock::time_point start = clock::now();
+
+    // The previous job may have halted
+    if (emulator.is_debugging())
+        emulator.debugger_.resume();
+
+    emulator.read_rom(job.rom_.wstring());
+
+    EmulatorJobResult result;
+    Controller& ctrl = emulator.get_bus()->ctrl_;
+
+    for (uint64_t frame = 0; frame < job.frames_; ++frame)
+    {
+        if (!job.inputs_.empty())
+            ctrl.set_state(job.inputs_[std::min<size_t>(frame, job.inputs_.size() - 1)]);
+
+        emulator.update();
+
+        if (emulator.is_debugging())
+        {
+            throw std::runtime_error(fmt::format("{} halted at ${:04X} on frame {}: {}", job.rom_.string(),
+                emulator.get_cpu()->get_state().program_counter_, frame + 1, emulator.get_error()));
+        }
+    }
+
+    result.frames_ = job.frames_;
+
+    const PPU::Output& output = emulator.get_ppu()->output();
+
+    if (job.frame_hash_)
+        result.frame_hash_ = hash_bytes({ output.data(), output.size() });
+
+    if (job.ram_dump_)
+        result.ram_.assign(emulator.get_ram()->data(), emulator.get_ram()->data() + 0x800);
+
+    if (job.frame_dump_)
+        result.frame_.assign(output.data(), output.data() + output.size());
+
+    result.elapsed_ms_ = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+class Emulator;
+
+struct EmulatorJob
+{
+    stdfs::path rom_;
+
+    // Frame budget, and controller 1 state for each frame (the last state is held).
+    uint64_t frames_ = 0;
+    std::vector<byte_t> inputs_;
+
+    // Output spec
+    bool frame_hash_ = true;
+    bool ram_dump_ = false;
+    bool frame_dump_ = false;
+};
+
+struct EmulatorJobResult
+{
+    uint64_t frames_ = 0;
+    uint64_t frame_hash_ = 0;
+    std::vector<byte_t> ram_;
+    std::vector<byte_t> frame_; // RGBA, 256x240
+    double elapsed_ms_ = 0.0;
+    size_t worker_ = 0;
+};
+
+// Runs emulation jobs on a fixed set of worker threads.
+// Each worker reuses its own Emulator between jobs. Jobs are distributed round-robin
+// to per-worker queues and idle workers steal from the others, so long and short
+// jobs balance. A job that throws sets the exception on its future, an emulation
+// exception halting the CPU included.
+class EmulatorPool
+{
+public:
+    explicit EmulatorPool(size_t thread_count = std::thread::hardware_concurrency());
+    ~EmulatorPool();
+
+    EmulatorPool(const EmulatorPool&) = delete;
+    EmulatorPool& operator=(const EmulatorPool&) = delete;
+
+    std::future<EmulatorJobResult> submit(EmulatorJob job);
+
+    size_t thread_count() const { return workers_.size(); }
+
+    static EmulatorJobResult run_job(Emulator& emulator, const EmulatorJob& job);
+
+private:
+    struct Task
+    {
+        EmulatorJob job_;
+        std::promise<EmulatorJobResult> promise_;
+    };
+
+    // Workers are written by their own thread all the time, keep them on separate cache lines.
+    struct alignas(64) Worker
+    {
+        std::mutex mutex_;
+        std::deque<Task> queue_;
+        std::unique_ptr<Emulator> emulator_;
+        std::thread thread_;
+    };
+
+    void run_worker_(size_t idx);
+    bool pop_task_(size_t idx, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_worker_ { 0 };
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+};
@@ -0,0 +1,127 @@
+#include "frame_pacer.h"
+
+#include "emulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Maximum deviation of the audio resampling ratio, small enough to be inaudible.
+static constexpr double max_rate_deviation = 0.005;
+
+FramePacer::FramePacer(Emulator* emulator, Mode mode)
+    : emulator_(emulator)
+    , mode_(mode)
+    , frame_period_(std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / ntsc_frame_rate)))
+    , deadline_(clock::now())
+    , last_frame_(deadline_)
+{
+}
+
+void FramePacer::set_mode(Mode mode)
+{
+    mode_ = mode;
+    deadline_ = clock::now();
+}
+
+void FramePacer::wait()
+{
+    AudioSink* sink = emulator_->get_audio_sink();
+
+    // A paused emulator produces no samples, fall back to the timer.
+    if (mode_ == Mode::Audio && sink && emulator_->is_stepping())
+    {
+        // Let the audio device drain the buffer below half, bounded in case the device stalls.
+        const clock::time_point timeout = clock::now() + 2 * frame_period_;
+        while (sink->buffered() > sink->capacity() / 2 && clock::now() < timeout)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        deadline_ = clock::now();
+        return;
+    }
+
+    if (mode_ == Mode::VSync)
+        return;
+
+    wait_deadline_();
+}
+
+void FramePacer::wait_deadline_()
+{
+    deadline_ += frame_period_;
+
+    clock::time_point now = clock::now();
+    if (now > deadline_ + frame_period_)
+    {
+        // Too far behind, drop the lost time instead of running frames back to back.
+        ++late_frames_;
+        deadline_ = now;
+        return;
+    }
+
+    // Sleep is coarse, sleep until shortly before the deadline then yield.
+    constexpr auto spin_margin = std::chrono::milliseconds(2);
+    if (deadline_ - now > spin_margin)
+        std::this_thread::sleep_for(deadline_ - now - spin_margin);
+
+    while (clock::now() < deadline_)
+        std::this_thread::yield();
+}
+
+void FramePacer::frame_done()
+{
+    record_frame_time_(clock::now());
+    update_rate_control_();
+}
+
+void FramePacer::update_rate_control_()
+{
+    AudioSink* sink = emulator_->get_audio_sink();
+    if (!sink || !emulator_->is_stepping())
+        return;
+
+    // Produce slightly more samples when the buffer is under half full, fewer when over.
+    const double fill = static_cast<double>(sink->buffered()) / sink->capacity();
+    rate_adjust_ = 1.0 + max_rate_deviation * std::clamp(1.0 - 2.0 * fill, -1.0, 1.0);
+
+    emulator_->get_apu()->set_rate_adjust(rate_adjust_);
+}
+
+void FramePacer::record_frame_time_(clock::time_point now)
+{
+    const auto elapsed = std::chrono::duration<float, std::micro>(now - last_frame_);
+    last_frame_ = now;
+
+    frame_times_[frame_count_ % frame_times_.size()] = elapsed.count();
+    ++frame_count_;
+}
+
+FrameTimingStats FramePacer::get_stats() const
+{
+    FrameTimingStats stats;
+    stats.rate_adjust_ = rate_adjust_;
+    stats.late_frames_ = late_frames_;
+
+    const size_t count = std::min(frame_count_, frame_times_.size());
+    if (count == 0)
+        return stats;
+
+    double sum = 0.0;
+    double max = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        sum += frame_times_[i];
+        max = std::max<double>(max, frame_times_[i]);
+    }
+
+    const double mean = sum / count;
+
+    double variance = 0.0;
+    for (size_t i = 0; i < count; ++i)
+        variance += (frame_times_[i] - mean) * (frame_times_[i] - mean);
+
+    stats.mean_us_ = mean;
+    stats.stddev_us_ = std::sqrt(variance / count);
+    stats.max_us_ = max;
+    return stats;
+}
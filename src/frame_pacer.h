@@ -0,0 +1,71 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <chrono>
+
+class Emulator;
+
+struct FrameTimingStats
+{
+    double mean_us_ = 0.0;
+    double stddev_us_ = 0.0;
+    double max_us_ = 0.0;
+    double rate_adjust_ = 1.0; // audio resampling ratio applied by the rate control
+    uint64_t late_frames_ = 0; // frames that missed their deadline by more than a frame
+};
+
+// Paces the emulation at the NTSC rate (60.0988 Hz).
+// - Timer: sleeps until an absolute deadline, late frames resynchronize instead of bursting.
+// - Audio: runs a frame whenever the audio sink needs more samples.
+// - VSync: relies on the display's vertical sync to block, the caller enables it on the
+//   window (SFMLRenderer::set_vsync).
+// With an audio sink attached, the APU sample rate is nudged by at most 0.5% to keep
+// the audio buffer half full (dynamic rate control), which avoids both drift and latency build-up.
+class FramePacer
+{
+public:
+    enum class Mode
+    {
+        Timer,
+        Audio,
+        VSync,
+    };
+
+    static constexpr double ntsc_frame_rate = 60.0988;
+
+    FramePacer(Emulator* emulator, Mode mode = Mode::Timer);
+
+    // Blocks until the next frame is due.
+    void wait();
+
+    // Call once the frame was emulated.
+    void frame_done();
+
+    Mode get_mode() const { return mode_; }
+    void set_mode(Mode mode);
+
+    FrameTimingStats get_stats() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    void wait_deadline_();
+    void update_rate_control_();
+    void record_frame_time_(clock::time_point now);
+
+    Emulator* emulator_;
+    Mode mode_;
+
+    clock::duration frame_period_;
+    clock::time_point deadline_;
+    clock::time_point last_frame_;
+
+    double rate_adjust_ = 1.0;
+    uint64_t late_frames_ = 0;
+
+    // rolling window of frame times, in microseconds
+    std::array<float, 128> frame_times_ {};
+    size_t frame_count_ = 0;
+};
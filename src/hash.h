@@ -0,0 +1,108 @@
+#pragma once
+
+#include "types.h"
+
+#include <bit>
+#include <cstring>
+#include <span>
+
+namespace hash_detail
+{
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+    // Little endian hosts only, like the save states
+    inline uint64_t read64(const byte_t* p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t read32(const byte_t* p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t round(uint64_t acc, uint64_t input)
+    {
+        acc += input * prime2;
+        return std::rotl(acc, 31) * prime1;
+    }
+
+    inline uint64_t merge(uint64_t acc, uint64_t value)
+    {
+        acc ^= round(0, value);
+        return acc * prime1 + prime4;
+    }
+}
+
+// XXH64, several GB/s: frames and memory can be hashed every frame.
+// The four independent lanes over 32 byte stripes keep the multipliers busy.
+inline uint64_t hash_bytes(std::span<const byte_t> data, uint64_t seed = 0)
+{
+    using namespace hash_detail;
+
+    const byte_t* p = data.data();
+    const byte_t* const end = p + data.size();
+
+    uint64_t hash;
+    if (data.size() >= 32)
+    {
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+
+        for (; end - p >= 32; p += 32)
+        {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+
+        hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        hash = merge(hash, v1);
+        hash = merge(hash, v2);
+        hash = merge(hash, v3);
+        hash = merge(hash, v4);
+    }
+    else
+    {
+        hash = seed + prime5;
+    }
+
+    hash += data.size();
+
+    for (; end - p >= 8; p += 8)
+    {
+        hash ^= round(0, read64(p));
+        hash = std::rotl(hash, 27) * prime1 + prime4;
+    }
+
+    if (end - p >= 4)
+    {
+        hash ^= read32(p) * prime1;
+        hash = std::rotl(hash, 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    for (; p < end; ++p)
+    {
+        hash ^= *p * prime5;
+        hash = std::rotl(hash, 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
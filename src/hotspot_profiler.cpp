@@ -0,0 +1,60 @@
+#include "hotspot_profiler.h"
+
+#include <algorithm>
+
+void HotspotProfiler::attach(Cartridge* cart)
+{
+    pages_.attach(cart);
+    counters_.assign(rom_base + (cart ? cart->prg_rom_.size() : 0), {});
+    clear();
+}
+
+void HotspotProfiler::clear()
+{
+    std::fill(counters_.begin(), counters_.end(), Counter {});
+    total_cycles_ = 0;
+    dma_cycles_ = 0;
+}
+
+HotSpot HotspotProfiler::to_hotspot_(size_t index) const
+{
+    const Counter& counter = counters_[index];
+    const int bank = index >= rom_base ? PrgPageTable::bank(index - rom_base) : -1;
+    return { counter.pc_, bank, counter.cycles_, counter.count_ };
+}
+
+HotSpot HotspotProfiler::get(address_t pc)
+{
+    HotSpot spot = to_hotspot_(index_(pc));
+    spot.pc_ = pc;
+    return spot;
+}
+
+HotSpot HotspotProfiler::get_rom(size_t offset) const
+{
+    const size_t index = rom_base + offset;
+    return index < counters_.size() ? to_hotspot_(index) : HotSpot {};
+}
+
+std::vector<HotSpot> HotspotProfiler::top(size_t count) const
+{
+    std::vector<size_t> hot;
+    for (size_t i = 0; i < counters_.size(); ++i)
+    {
+        if (counters_[i].cycles_ > 0)
+            hot.push_back(i);
+    }
+
+    count = std::min(count, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + count, hot.end(), [&](size_t lhs, size_t rhs)
+    {
+        return counters_[lhs].cycles_ > counters_[rhs].cycles_;
+    });
+
+    std::vector<HotSpot> spots;
+    spots.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        spots.push_back(to_hotspot_(hot[i]));
+
+    return spots;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "types.h"
+#include "prg_page_table.h"
+
+#include <vector>
+
+struct HotSpot
+{
+    address_t pc_ = 0; // where it ran last
+    int bank_ = -1; // 8KB PRG ROM bank, -1 below $8000 (RAM, WRAM) or when not mapped to ROM
+    uint64_t cycles_ = 0;
+    uint64_t count_ = 0; // instructions executed
+};
+
+// Charges every emulated CPU cycle to the instruction it belongs to, off by default.
+// One flat counter per CPU address below $8000 and one per PRG ROM byte above it, so the
+// same address in two switched banks is told apart.
+// Interrupt entries are charged to the first instruction of the handler; DMA stalls are
+// not charged to any PC and are counted apart.
+class HotspotProfiler
+{
+public:
+    // Sized for the cartridge's PRG ROM (none with nullptr), clears the counts
+    void attach(Cartridge* cart);
+    Cartridge* get_cart() const { return pages_.get_cart(); }
+    void clear();
+
+    void on_instruction(address_t pc, uint32_t cycles)
+    {
+        Counter& counter = counters_[index_(pc)];
+        counter.cycles_ += cycles;
+        ++counter.count_;
+        counter.pc_ = pc;
+        total_cycles_ += cycles;
+    }
+
+    void on_interrupt(address_t handler, uint32_t cycles)
+    {
+        Counter& counter = counters_[index_(handler)];
+        counter.cycles_ += cycles;
+        counter.pc_ = handler;
+        total_cycles_ += cycles;
+    }
+
+    void on_dma_cycle() { ++dma_cycles_; }
+
+    // For mapping changes that are not bank switches: loading a state
+    void invalidate_mapping() { pages_.invalidate(); }
+
+    // Cycles charged to PCs, the DMA cycles are not part of them
+    uint64_t total_cycles() const { return total_cycles_; }
+    uint64_t dma_cycles() const { return dma_cycles_; }
+
+    // The counter of pc in the current mapping, or of a PRG ROM byte
+    HotSpot get(address_t pc);
+    HotSpot get_rom(size_t offset) const;
+
+    // The hottest addresses, by cycles
+    std::vector<HotSpot> top(size_t count) const;
+
+private:
+    struct Counter
+    {
+        uint64_t cycles_ = 0;
+        uint64_t count_ = 0;
+        address_t pc_ = 0;
+    };
+
+    static constexpr size_t rom_base = 0x10000; // first ROM counter, after the CPU addresses
+
+    size_t index_(address_t pc)
+    {
+        const size_t offset = pages_.rom_offset(pc);
+        return offset == PrgPageTable::none ? pc : rom_base + offset;
+    }
+
+    HotSpot to_hotspot_(size_t index) const;
+
+    PrgPageTable pages_;
+
+    std::vector<Counter> counters_ = std::vector<Counter>(rom_base);
+    uint64_t total_cycles_ = 0;
+    uint64_t dma_cycles_ = 0;
+};
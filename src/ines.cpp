@@ -1,5 +1,6 @@
 #include "ines.h"
 
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 
@@ -12,7 +13,7 @@ bool INESHeader::init(std::span<byte_t, 16> data)
         || data[3] != 0x1A) // end-of-file
         return false;
 
-    struct : register_t<byte_t>
+    struct : reg_t<byte_t>
     {
         byte_t mirroring_ : 1;
         byte_t has_prg_ram_ : 1;
@@ -23,7 +24,7 @@ bool INESHeader::init(std::span<byte_t, 16> data)
 
     flag6.set(data[6]);
 
-    struct : register_t<byte_t>
+    struct : reg_t<byte_t>
     {
         byte_t vs_unisystem_ : 1;
         byte_t playchoise_10_: 1;
@@ -33,7 +34,7 @@ bool INESHeader::init(std::span<byte_t, 16> data)
 
     flag7.set(data[7]);
 
-    struct : register_t<byte_t>
+    struct : reg_t<byte_t>
     {
         byte_t tv_system_ : 1; // 0 is ntsc, 1 is pal
         byte_t reserved : 7; // unused, must be all 0;
@@ -76,8 +77,8 @@ INESReader::~INESReader() = default;
 
 bool INESReader::read_from_file(std::wstring_view filename)
 {
-    stream_ = std::make_unique<bifstream>(filename.data(), std::ios_base::binary);
-    bifstream& ifs = *stream_;
+    stream_ = std::make_unique<std::ifstream>(std::filesystem::path(filename), std::ios_base::binary);
+    std::ifstream& ifs = *stream_;
 
     if (!ifs)
         return false;
@@ -85,7 +86,7 @@ bool INESReader::read_from_file(std::wstring_view filename)
     filepath_ = filename;
 
     byte_t header[16];
-    ifs.read(header, 16);
+    ifs.read(reinterpret_cast<char*>(header), 16);
 
     if (!header_.init(header))
     {
@@ -104,7 +105,7 @@ void INESReader::read_prg_rom(int idx, std::span<byte_t, 0x4000> bank)
     if (!stream_)
         return;
 
-    bifstream& ifs = *stream_;
+    std::ifstream& ifs = *stream_;
 
     if (!ifs)
         return;
@@ -114,7 +115,7 @@ void INESReader::read_prg_rom(int idx, std::span<byte_t, 0x4000> bank)
     if (!ifs)
         return;
 
-    ifs.read(bank.data(), 0x4000);
+    ifs.read(reinterpret_cast<char*>(bank.data()), 0x4000);
 }
 
 void INESReader::read_chr_rom(int idx, std::span<byte_t, 0x2000> bank)
@@ -122,7 +123,7 @@ void INESReader::read_chr_rom(int idx, std::span<byte_t, 0x2000> bank)
     if (!stream_)
         return;
 
-    bifstream& ifs = *stream_;
+    std::ifstream& ifs = *stream_;
 
     if (!ifs)
         return;
@@ -132,5 +133,5 @@ void INESReader::read_chr_rom(int idx, std::span<byte_t, 0x2000> bank)
     if (!ifs)
         return;
 
-    ifs.read(bank.data(), 0x2000);
+    ifs.read(reinterpret_cast<char*>(bank.data()), 0x2000);
 }
@@ -7,8 +7,6 @@
 #include <string_view>
 #include <memory>
 
-using bifstream = std::basic_ifstream<byte_t>;
-
 struct INESHeader
 {
     byte_t mapper_;
@@ -44,7 +42,7 @@ public:
     std::wstring filepath_;
 
 private:
-    std::unique_ptr<bifstream> stream_;
+    std::unique_ptr<std::ifstream> stream_;
     std::streampos prg_rom_offset_;
     std::streampos chr_rom_offset_;
 };
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "instrumentation.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <ostream>
+
+std::string_view subsystem_name(Subsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case Subsystem::CPU: return "cpu";
+    case Subsystem::PPU: return "ppu";
+    case Subsystem::APU: return "apu";
+    case Subsystem::DMA: return "dma";
+    case Subsystem::Count: break;
+    }
+
+    return "?";
+}
+
+std::string_view BusCounters::region_name(size_t region)
+{
+    static constexpr std::array<std::string_view, region_count> names = {
+        "ram", "ppu", "io", "wram", "prg8", "prga", "prgc", "prge",
+    };
+
+    return region < region_count ? names[region] : "?";
+}
+
+void Instrumentation::set_enabled(bool enabled)
+{
+    enabled_ = enabled;
+    if (!enabled_)
+        return;
+
+    // Back to back reads, the smallest is what timing an empty call costs
+    overhead_ticks_ = UINT64_MAX;
+    for (int i = 0; i < 256; ++i)
+    {
+        const uint64_t start = read_ticks();
+        overhead_ticks_ = std::min(overhead_ticks_, read_ticks() - start);
+    }
+}
+
+bool Instrumentation::set_perf_counters(bool enabled)
+{
+    perf_sampling_ = false;
+
+    if (!enabled)
+    {
+        perf_.close();
+        return true;
+    }
+
+    if (!perf_.is_open() && !perf_.open())
+        return false;
+
+    // Empty brackets, the smallest count of each event is what the reads themselves cost
+    perf_overhead_.counts_.fill(UINT64_MAX);
+    for (int i = 0; i < 64; ++i)
+    {
+        PerfSample start;
+        PerfSample end;
+        if (!perf_.read_user(start) || !perf_.read_user(end))
+            continue;
+
+        for (size_t e = 0; e < perf_event_count; ++e)
+            perf_overhead_.counts_[e] = std::min(perf_overhead_.counts_[e], end.counts_[e] - start.counts_[e]);
+    }
+
+    perf_sampling_ = perf_.has_user_read() && perf_overhead_.counts_[0] != UINT64_MAX;
+    return true;
+}
+
+void Instrumentation::add_perf_(Slot& slot, const PerfSample& start)
+{
+    PerfSample end;
+    if (!perf_.read_user(end))
+        return;
+
+    for (size_t e = 0; e < perf_event_count; ++e)
+    {
+        const uint64_t count = end.counts_[e] - start.counts_[e];
+        slot.perf_.counts_[e] += count > perf_overhead_.counts_[e] ? count - perf_overhead_.counts_[e] : 0;
+    }
+}
+
+void Instrumentation::set_sample_period(uint32_t period)
+{
+    period_ = std::max<uint32_t>(period, 1);
+
+    for (Slot& slot : slots_)
+        slot.countdown_ = 1;
+}
+
+void Instrumentation::begin_frame(uint64_t bank_switches, uint64_t debugger_hooks)
+{
+    // The countdowns carry over, the first calls of a frame are not favoured
+    for (Slot& slot : slots_)
+    {
+        slot.calls_ = 0;
+        slot.sampled_ = 0;
+        slot.ticks_ = 0;
+        slot.perf_ = {};
+    }
+
+    bus_ = {};
+
+    bank_switches_start_ = bank_switches;
+    debugger_hooks_start_ = debugger_hooks;
+
+    if (perf_.is_open())
+        perf_.read(frame_start_perf_);
+
+    frame_start_ = clock::now();
+    frame_start_ticks_ = read_ticks();
+}
+
+void Instrumentation::end_frame(uint64_t frame, uint64_t bank_switches, uint64_t debugger_hooks)
+{
+    const uint64_t ticks = read_ticks() - frame_start_ticks_;
+    const double frame_ns = std::chrono::duration<double, std::nano>(clock::now() - frame_start_).count();
+    const double ns_per_tick = ticks > 0 ? frame_ns / ticks : 0.0;
+
+    PerfSample perf_end;
+    const bool has_perf = perf_.is_open() && perf_.read(perf_end);
+
+    last_ = {};
+    last_.frame_ = frame;
+    last_.frame_ns_ = frame_ns;
+    last_.bus_ = bus_;
+    last_.bank_switches_ = bank_switches - bank_switches_start_;
+    last_.debugger_hooks_ = debugger_hooks - debugger_hooks_start_;
+    last_.has_perf_ = has_perf;
+
+    if (has_perf)
+        last_.perf_ = perf_end - frame_start_perf_;
+
+    for (size_t i = 0; i < subsystem_count; ++i)
+    {
+        const Slot& slot = slots_[i];
+        last_.calls_[i] = slot.calls_;
+
+        if (slot.sampled_ == 0)
+            continue;
+
+        const double scale = static_cast<double>(slot.calls_) / slot.sampled_;
+        last_.ns_[i] = slot.ticks_ * ns_per_tick * scale;
+
+        if (has_perf && perf_sampling_)
+        {
+            for (size_t e = 0; e < perf_event_count; ++e)
+                last_.subsystem_perf_[i].counts_[e] = static_cast<uint64_t>(slot.perf_.counts_[e] * scale);
+        }
+    }
+
+    const size_t idx = frames_ % history_size;
+    frame_ms_[idx] = static_cast<float>(frame_ns / 1e6);
+    for (size_t i = 0; i < subsystem_count; ++i)
+        subsystem_ms_[i][idx] = static_cast<float>(last_.ns_[i] / 1e6);
+
+    ++frames_;
+}
+
+void Instrumentation::write_csv_header(std::ostream& os, bool perf)
+{
+    os << "frame,frame_ns";
+
+    for (size_t i = 0; i < subsystem_count; ++i)
+    {
+        const std::string_view name = subsystem_name(static_cast<Subsystem>(i));
+        os << fmt::format(",{0}_ns,{0}_calls", name);
+    }
+
+    for (size_t i = 0; i < BusCounters::region_count; ++i)
+        os << fmt::format(",{0}_reads,{0}_writes", BusCounters::region_name(i));
+
+    os << ",bank_switches,debugger_hooks";
+
+    if (perf)
+    {
+        os << ",cycles,instructions,branch_misses,l1d_misses,ipc,branch_mpki,l1d_mpki";
+
+        for (size_t i = 0; i < subsystem_count; ++i)
+            os << fmt::format(",{0}_ipc,{0}_branch_mpki,{0}_l1d_mpki", subsystem_name(static_cast<Subsystem>(i)));
+    }
+
+    os << '\n';
+}
+
+void Instrumentation::write_csv_row(std::ostream& os, const FrameCounters& counters)
+{
+    os << fmt::format("{},{:.0f}", counters.frame_, counters.frame_ns_);
+
+    for (size_t i = 0; i < subsystem_count; ++i)
+        os << fmt::format(",{:.0f},{}", counters.ns_[i], counters.calls_[i]);
+
+    for (size_t i = 0; i < BusCounters::region_count; ++i)
+        os << fmt::format(",{},{}", counters.bus_.reads_[i], counters.bus_.writes_[i]);
+
+    os << fmt::format(",{},{}", counters.bank_switches_, counters.debugger_hooks_);
+
+    if (counters.has_perf_)
+    {
+        const PerfSample& perf = counters.perf_;
+        os << fmt::format(",{},{},{},{},{:.3f},{:.3f},{:.3f}",
+            perf[PerfEvent::Cycles], perf[PerfEvent::Instructions], perf[PerfEvent::BranchMisses], perf[PerfEvent::L1DMisses],
+            perf.ipc(), perf.branch_mpki(), perf.l1d_mpki());
+
+        for (const PerfSample& sub : counters.subsystem_perf_)
+            os << fmt::format(",{:.3f},{:.3f},{:.3f}", sub.ipc(), sub.branch_mpki(), sub.l1d_mpki());
+    }
+
+    os << '\n';
+}
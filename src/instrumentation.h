@@ -0,0 +1,192 @@
+#pragma once
+
+#include "types.h"
+#include "perf_counters.h"
+
+#include <array>
+#include <chrono>
+#include <iosfwd>
+#include <string_view>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum class Subsystem : byte_t
+{
+    CPU, // instruction execution
+    PPU, // dots, rendering included
+    APU, // per cycle step, end of frame and the audio flush
+    DMA, // OAM transfers, the stalled cpu cycles included
+    Count
+};
+
+constexpr size_t subsystem_count = static_cast<size_t>(Subsystem::Count);
+
+std::string_view subsystem_name(Subsystem subsystem);
+
+// CPU accesses per 8KB region: RAM, PPU registers, APU/IO, WRAM, then four PRG regions.
+struct BusCounters
+{
+    static constexpr size_t region_count = 8;
+
+    std::array<uint64_t, region_count> reads_ {};
+    std::array<uint64_t, region_count> writes_ {};
+
+    static size_t region(address_t addr) { return addr >> 13; }
+    static std::string_view region_name(size_t region);
+};
+
+// One emulated frame.
+struct FrameCounters
+{
+    uint64_t frame_ = 0; // PPU frame number
+    double frame_ns_ = 0.0; // Emulator::update, wall time
+    std::array<double, subsystem_count> ns_ {}; // host time, estimated from the sampled calls
+    std::array<uint64_t, subsystem_count> calls_ {};
+    BusCounters bus_;
+    uint64_t bank_switches_ = 0;
+    uint64_t debugger_hooks_ = 0; // their time is part of the CPU and PPU times
+
+    // Hardware counters, with Instrumentation::set_perf_counters
+    bool has_perf_ = false;
+    PerfSample perf_; // the whole Emulator::update
+    std::array<PerfSample, subsystem_count> subsystem_perf_ {}; // estimated like ns_, zero without rdpmc
+};
+
+// Accumulates host time and event counts per subsystem over every frame, off by default.
+// Reading the clock around each of the ~150k calls per frame would cost as much as the calls,
+// so one call in sample_period (at random, to not alias with the instruction mix) is timed
+// and the total is scaled by the call count. A period of 1 times every call.
+class Instrumentation
+{
+public:
+    static constexpr size_t history_size = 128;
+
+    bool is_enabled() const { return enabled_; }
+    void set_enabled(bool enabled);
+
+    void set_sample_period(uint32_t period);
+
+    // Runs f, timed as part of the subsystem when enabled
+    template <typename F>
+    void run(Subsystem subsystem, F&& f)
+    {
+        if (!enabled_) [[likely]]
+        {
+            f();
+            return;
+        }
+
+        Slot& slot = slots_[static_cast<size_t>(subsystem)];
+        ++slot.calls_;
+
+        if (--slot.countdown_ > 0)
+        {
+            f();
+            return;
+        }
+
+        slot.countdown_ = next_countdown_();
+
+        PerfSample perf_start;
+        const bool counted = perf_sampling_ && perf_.read_user(perf_start);
+
+        const uint64_t start = read_ticks();
+        f();
+        const uint64_t ticks = read_ticks() - start;
+
+        if (counted) [[unlikely]]
+            add_perf_(slot, perf_start);
+
+        slot.ticks_ += ticks > overhead_ticks_ ? ticks - overhead_ticks_ : 0;
+        ++slot.sampled_;
+    }
+
+    // Linux perf_event counters on top of the timings, counting the calling thread.
+    // The frame totals are exact. The subsystems are sampled like the times, which needs
+    // rdpmc from user space (x86, /sys/bus/event_source/devices/cpu/rdpmc not 0):
+    // a system call per sample would disturb the caches it is meant to measure.
+    // False with perf_error() set when they can't be opened.
+    bool set_perf_counters(bool enabled);
+    bool has_perf_counters() const { return perf_.is_open(); }
+    bool has_subsystem_perf() const { return perf_sampling_; }
+    const std::string& perf_error() const { return perf_.error(); }
+
+    // Set on the bus while enabled
+    BusCounters& bus_counters() { return bus_; }
+
+    // Totals since power on, the frame counters are the differences
+    void begin_frame(uint64_t bank_switches, uint64_t debugger_hooks);
+    void end_frame(uint64_t frame, uint64_t bank_switches, uint64_t debugger_hooks);
+
+    const FrameCounters& last_frame() const { return last_; }
+
+    // Rolling windows in milliseconds, oldest first from history_offset(), for plotting
+    const std::array<float, history_size>& frame_history() const { return frame_ms_; }
+    const std::array<float, history_size>& history(Subsystem subsystem) const { return subsystem_ms_[static_cast<size_t>(subsystem)]; }
+    size_t history_offset() const { return frames_ % history_size; }
+
+    // The hardware counter columns are only written with perf
+    static void write_csv_header(std::ostream& os, bool perf = false);
+    static void write_csv_row(std::ostream& os, const FrameCounters& counters);
+
+private:
+    struct Slot
+    {
+        uint64_t calls_ = 0;
+        uint64_t sampled_ = 0;
+        uint64_t ticks_ = 0;
+        uint32_t countdown_ = 1;
+        PerfSample perf_;
+    };
+
+    void add_perf_(Slot& slot, const PerfSample& start);
+
+    using clock = std::chrono::steady_clock;
+
+    // The TSC where there is one, converted with the rate measured over the frame
+    static uint64_t read_ticks()
+    {
+#if defined(_M_X64) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // Uniform in [1, 2 * period - 1], so the mean distance between samples is the period
+    uint32_t next_countdown_()
+    {
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 17;
+        rng_ ^= rng_ << 5;
+        return period_ == 1 ? 1 : 1 + rng_ % (2 * period_ - 1);
+    }
+
+    bool enabled_ = false;
+    uint32_t period_ = 16;
+    uint32_t rng_ = 0x9E3779B9;
+    uint64_t overhead_ticks_ = 0; // of reading the clock twice, taken out of every sample
+
+    PerfCounters perf_;
+    bool perf_sampling_ = false;
+    PerfSample perf_overhead_; // same for the hardware counters
+    PerfSample frame_start_perf_;
+
+    std::array<Slot, subsystem_count> slots_ {};
+    BusCounters bus_;
+
+    clock::time_point frame_start_;
+    uint64_t frame_start_ticks_ = 0;
+    uint64_t bank_switches_start_ = 0;
+    uint64_t debugger_hooks_start_ = 0;
+
+    FrameCounters last_;
+
+    std::array<float, history_size> frame_ms_ {};
+    std::array<std::array<float, history_size>, subsystem_count> subsystem_ms_ {};
+    size_t frames_ = 0;
+};
@@ -1,6 +1,9 @@
 #include "000.h"
 
+#include "save_state.h"
+
 M000::M000(Cartridge& cart)
+    : cart_(cart)
 {
     prg_l_ = { cart.get_prg_bank(0), 0x8000 };
     prg_map_[0] = prg_l_;
@@ -12,42 +15,36 @@ M000::M000(Cartridge& cart)
     chr_map_[0] = chr_;
 }
 
-bool M000::on_cpu_read(address_t addr, byte_t& value) 
+// The 8KB of WRAM at $6000 some boards have (Family Basic), also where test ROMs report.
+bool M000::on_cpu_write(address_t addr, byte_t value)
 {
-    if (addr >= 0x8000 && addr < 0xC000)
+    if (addr >= 0x6000 && addr < 0x8000)
     {
-        prg_l_.read(addr & 0x3FFF, value);
-        return true;
-    }
-
-    if (addr >= 0xC000)
-    {
-        prg_h_.read(addr & 0x3FFF, value);
+        if (!(cart_.battery_ && cart_.battery_->write(addr, value)))
+            cart_.wram_[addr & 0x1FFF] = value;
         return true;
     }
 
     return false;
 }
 
-bool M000::on_cpu_write(address_t addr, byte_t value)
+bool M000::on_ppu_write(address_t addr, byte_t value)
 {
     return false;
 }
 
-bool M000::on_ppu_read(address_t addr, byte_t& value)
+const byte_t* M000::get_cpu_page(address_t addr) const
 {
-    if (addr < 0x2000)
-    {
-        chr_.read(addr & 0x1FFF, value);
-        return true;
-    }
+    if (addr >= 0x6000 && addr < 0x8000)
+        return cart_.battery_ ? nullptr : cart_.wram_.data() + (addr & 0x1F00);
 
-    return false;
-}
+    if (addr >= 0x8000 && addr < 0xC000)
+        return prg_l_.data_.data() + (addr & 0x3F00);
 
-bool M000::on_ppu_write(address_t addr, byte_t value)
-{
-    return false;
+    if (addr >= 0xC000)
+        return prg_h_.data_.data() + (addr & 0x3F00);
+
+    return nullptr;
 }
 
 address_t M000::map_to_cpu_addr(address_t addr) const
@@ -57,3 +54,12 @@ address_t M000::map_to_cpu_addr(address_t addr) const
 
     return addr;
 }
+
+void M000::serialize_state(StateStream& state, Cartridge& cart)
+{
+    serialize_maps_(state, cart);
+
+    serialize_view_(state, prg_l_, cart.prg_rom_);
+    serialize_view_(state, prg_h_, cart.prg_rom_);
+    serialize_view_(state, chr_, cart.chr_rom_);
+}
@@ -3,9 +3,11 @@
 #include "mappers/mapper.h"
 
 // NROM
-class M000 : public Mapper
+class M000 final : public Mapper
 {
 public:
+    static constexpr byte_t ines_code = 0;
+
     M000(Cartridge& cart);
 
     bool on_cpu_read(address_t addr, byte_t& value) override;
@@ -14,10 +16,51 @@ public:
     bool on_ppu_read(address_t addr, byte_t& value) override;
     bool on_ppu_write(address_t addr, byte_t value) override;
 
+    const byte_t* get_cpu_page(address_t addr) const;
+
+    void serialize_state(StateStream& state, Cartridge& cart);
+
     address_t map_to_cpu_addr(address_t addr) const override;
 
 private:
+    Cartridge& cart_;
+
     BankView prg_l_;
     BankView prg_h_;
     BankView chr_;
-};
\ No newline at end of file
+};
+
+inline bool M000::on_cpu_read(address_t addr, byte_t& value)
+{
+    if (addr >= 0x6000 && addr < 0x8000)
+    {
+        if (!(cart_.battery_ && cart_.battery_->read(addr, value)))
+            value = cart_.wram_[addr & 0x1FFF];
+        return true;
+    }
+
+    if (addr >= 0x8000 && addr < 0xC000)
+    {
+        prg_l_.read(addr & 0x3FFF, value);
+        return true;
+    }
+
+    if (addr >= 0xC000)
+    {
+        prg_h_.read(addr & 0x3FFF, value);
+        return true;
+    }
+
+    return false;
+}
+
+inline bool M000::on_ppu_read(address_t addr, byte_t& value)
+{
+    if (addr < 0x2000)
+    {
+        chr_.read(addr & 0x1FFF, value);
+        return true;
+    }
+
+    return false;
+}
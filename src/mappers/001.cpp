@@ -1,6 +1,8 @@
 #include "001.h"
 #include "cartridge.h"
-#include "emulator.h"
+#include "bus.h"
+#include "ppu.h"
+#include "save_state.h"
 
 M001::M001(Cartridge& cart)
     : cart_(cart)
@@ -18,30 +20,6 @@ M001::M001(Cartridge& cart)
     chr_map_[1] = chr_h_;
 }
 
-bool M001::on_cpu_read(address_t addr, byte_t& value) 
-{
-    if (addr >= 0x6000 && addr < 0x8000)
-    {
-        if (!(cart_.battery_ && cart_.battery_->read(addr, value)))
-            value = cart_.wram_[addr & 0x1FFF];
-        return true;
-    }
-
-    if (addr >= 0x8000 && addr < 0xC000)
-    {
-        prg_l_.read(addr & 0x3FFF, value);
-        return true;
-    }
-
-    if (addr >= 0xC000)
-    {
-        prg_h_.read(addr & 0x3FFF, value);
-        return true;
-    }
-
-    return false;
-}
-
 bool M001::on_cpu_write(address_t addr, byte_t value)
 {
     if (addr >= 0x6000 && addr < 0x8000)
@@ -62,12 +40,15 @@ bool M001::on_cpu_write(address_t addr, byte_t value)
             if (op == 0)
                 control_ |= 0xC;
             else if (op == 3)
+            {
                 prg_h_.data_ = cart_.get_prg_bank(-1);
+                ++cart_.bank_switches_;
+            }
 
             return true;
         }
 
-        (register_.latch >>= 1) |= ((0x1 & value) << 4);
+        register_.latch = (register_.latch >> 1) | ((0x1 & value) << 4);
         ++register_.writes;
 
         if (register_.writes >= 5)
@@ -83,7 +64,7 @@ bool M001::on_cpu_write(address_t addr, byte_t value)
                 if (mirroring == 2) m = NT_Mirroring::Vertical;
                 if (mirroring == 3) m = NT_Mirroring::Horizontal;
 
-                Emulator::instance()->get_ppu()->set_mirroring(m);
+                cart_.bus_->ppu_.set_mirroring(m);
             }
             break;
 
@@ -108,22 +89,6 @@ bool M001::on_cpu_write(address_t addr, byte_t value)
     return false;
 }
 
-bool M001::on_ppu_read(address_t addr, byte_t& value)
-{
-    if (addr < 0x1000)
-    {
-        chr_l_.read(addr & 0x0FFF, value);
-        return true;
-    }
-    else if (addr >= 0x1000 && addr < 0x2000)
-    {
-        chr_h_.read(addr & 0x0FFF, value);
-        return true;
-    }
-
-    return false;
-}
-
 bool M001::on_ppu_write(address_t addr, byte_t value)
 {
     if (addr < 0x2000)
@@ -136,6 +101,20 @@ bool M001::on_ppu_write(address_t addr, byte_t value)
     return false;
 }
 
+const byte_t* M001::get_cpu_page(address_t addr) const
+{
+    if (addr >= 0x6000 && addr < 0x8000)
+        return cart_.battery_ ? nullptr : cart_.wram_.data() + (addr & 0x1F00);
+
+    if (addr >= 0x8000 && addr < 0xC000)
+        return prg_l_.data_.data() + (addr & 0x3F00);
+
+    if (addr >= 0xC000)
+        return prg_h_.data_.data() + (addr & 0x3F00);
+
+    return nullptr;
+}
+
 void M001::chr_low_switch()
 {
     const bool mode_8kb = (control_ & 0x10) == 0;
@@ -145,6 +124,7 @@ void M001::chr_low_switch()
         idx &= 0xFE;
 
     chr_l_.data_ = cart_.get_chr_bank(idx, 0x1000);
+    ++cart_.bank_switches_;
 
     if (mode_8kb)
         chr_h_.data_ = cart_.get_chr_bank(idx + 1, 0x1000);
@@ -159,6 +139,7 @@ void M001::chr_high_switch()
         return;
 
     chr_h_.data_ = cart_.get_chr_bank(idx, 0x1000);
+    ++cart_.bank_switches_;
 }
 
 void M001::prg_switch()
@@ -166,6 +147,8 @@ void M001::prg_switch()
     byte_t mode = (control_ >> 2) & 0b11;
     byte_t idx = register_.latch & 0b1111;
 
+    ++cart_.bank_switches_;
+
     switch (mode)
     {
     case 0:
@@ -191,4 +174,17 @@ void M001::prg_switch()
     }
     break;
     }
-}
\ No newline at end of file
+}
+
+void M001::serialize_state(StateStream& state, Cartridge& cart)
+{
+    serialize_maps_(state, cart);
+
+    serialize_view_(state, prg_l_, cart.prg_rom_);
+    serialize_view_(state, prg_h_, cart.prg_rom_);
+    serialize_view_(state, chr_l_, cart.chr_rom_);
+    serialize_view_(state, chr_h_, cart.chr_rom_);
+
+    state.process(register_);
+    state.process(control_);
+}
@@ -3,9 +3,11 @@
 #include "mappers/mapper.h"
 
 // SxROM
-class M001 : public Mapper
+class M001 final : public Mapper
 {
 public:
+    static constexpr byte_t ines_code = 1;
+
     M001(Cartridge& cart);
 
     bool on_cpu_read(address_t addr, byte_t& value) override;
@@ -14,6 +16,10 @@ public:
     bool on_ppu_read(address_t addr, byte_t& value) override;
     bool on_ppu_write(address_t addr, byte_t value) override;
 
+    const byte_t* get_cpu_page(address_t addr) const;
+
+    void serialize_state(StateStream& state, Cartridge& cart);
+
 private:
     Cartridge& cart_;
 
@@ -22,7 +28,7 @@ private:
     BankView chr_l_;
     BankView chr_h_;
 
-    struct : public register_t<byte_t> 
+    struct : public reg_t<byte_t> 
     { 
         byte_t latch : 5;
         byte_t writes : 3;
@@ -32,4 +38,44 @@ private:
     void chr_low_switch();
     void chr_high_switch();
     void prg_switch();
-};
\ No newline at end of file
+};
+
+inline bool M001::on_cpu_read(address_t addr, byte_t& value)
+{
+    if (addr >= 0x6000 && addr < 0x8000)
+    {
+        if (!(cart_.battery_ && cart_.battery_->read(addr, value)))
+            value = cart_.wram_[addr & 0x1FFF];
+        return true;
+    }
+
+    if (addr >= 0x8000 && addr < 0xC000)
+    {
+        prg_l_.read(addr & 0x3FFF, value);
+        return true;
+    }
+
+    if (addr >= 0xC000)
+    {
+        prg_h_.read(addr & 0x3FFF, value);
+        return true;
+    }
+
+    return false;
+}
+
+inline bool M001::on_ppu_read(address_t addr, byte_t& value)
+{
+    if (addr < 0x1000)
+    {
+        chr_l_.read(addr & 0x0FFF, value);
+        return true;
+    }
+    else if (addr >= 0x1000 && addr < 0x2000)
+    {
+        chr_h_.read(addr & 0x0FFF, value);
+        return true;
+    }
+
+    return false;
+}
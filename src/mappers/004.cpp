@@ -1,6 +1,9 @@
 #include "004.h"
 
-#include "emulator.h"
+#include "bus.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "save_state.h"
 
 NES_DEOPTIMIZE
 M004::M004(Cartridge& cart)
@@ -23,24 +26,6 @@ M004::M004(Cartridge& cart)
     chr_map_[7] = { empty_view, 0x1C00 };
 }
 
-bool M004::on_cpu_read(address_t addr, byte_t& value) 
-{
-    if (addr >= 0x6000 && addr < 0x8000)
-    {
-        if (!(cart_.battery_ && cart_.battery_->read(addr, value)))
-            value = cart_.wram_[addr & 0x1FFF];
-        return true;
-    }
-
-    if (addr >= 0x8000)
-    {
-        prg_map_.get_mapping(addr).read(addr & 0x1FFF, value);
-        return true;
-    }
-
-    return false;
-}
-
 bool M004::on_cpu_write(address_t addr, byte_t value)
 {
     if (addr >= 0x6000 && addr < 0x8000)
@@ -96,27 +81,30 @@ bool M004::on_cpu_write(address_t addr, byte_t value)
     return false;
 }
 
-bool M004::on_ppu_read(address_t addr, byte_t& value)
+bool M004::on_ppu_write(address_t addr, byte_t value)
 {
     if (addr < 0x2000)
     {
-        chr_map_.get_mapping(addr).read(addr & 0x03FF, value);
+        // CHR RAM is always at bank 0 ?
+        cart_.get_chr_bank(0)[addr] = value;
         return true;
     }
 
     return false;
 }
 
-bool M004::on_ppu_write(address_t addr, byte_t value)
+const byte_t* M004::get_cpu_page(address_t addr) const
 {
-    if (addr < 0x2000)
+    if (addr >= 0x6000 && addr < 0x8000)
+        return cart_.battery_ ? nullptr : cart_.wram_.data() + (addr & 0x1F00);
+
+    if (addr >= 0x8000)
     {
-        // CHR RAM is always at bank 0 ?
-        cart_.get_chr_bank(0)[addr] = value;
-        return true;
+        const BankView bank = prg_map_.get_mapping(addr);
+        return bank.data_.empty() ? nullptr : bank.data_.data() + (addr & 0x1F00);
     }
 
-    return false;
+    return nullptr;
 }
 
 void M004::on_ppu_scanline(int scanline)
@@ -132,7 +120,7 @@ void M004::on_ppu_scanline(int scanline)
     irq_reload_ = false;
 
     if (raise_irq)
-        Emulator::instance()->get_cpu()->pull_irq();
+        cart_.bus_->cpu_.pull_irq();
 }
 
 void M004::on_bank_select_(byte_t value)
@@ -143,6 +131,7 @@ void M004::on_bank_select_(byte_t value)
     if (register_.prg_mode_ != recv.prg_mode_)
     {
         std::swap(prg_map_[0].data_, prg_map_[2].data_);
+        ++cart_.bank_switches_;
     }
 
     register_.set(value);
@@ -150,6 +139,8 @@ void M004::on_bank_select_(byte_t value)
 
 void M004::on_bank_data_(byte_t value)
 {
+    ++cart_.bank_switches_;
+
     switch (register_.bank_select_)
     {
     case 0b000:
@@ -206,11 +197,11 @@ void M004::on_bank_data_(byte_t value)
 
 void M004::on_mirroring_(byte_t value)
 {
-    PPU* ppu = Emulator::instance()->get_ppu();
+    PPU& ppu = cart_.bus_->ppu_;
 
-    if (ppu->get_mirroring() != NT_Mirroring::None)
+    if (ppu.get_mirroring() != NT_Mirroring::None)
     {
-        ppu->set_mirroring((value & 0b1) == 0 ? NT_Mirroring::Vertical : NT_Mirroring::Horizontal);
+        ppu.set_mirroring((value & 0b1) == 0 ? NT_Mirroring::Vertical : NT_Mirroring::Horizontal);
     }
 }
 
@@ -240,3 +231,14 @@ void M004::on_irq_enable_()
 {
     irq_enabled_ = true;
 }
+
+void M004::serialize_state(StateStream& state, Cartridge& cart)
+{
+    serialize_maps_(state, cart);
+
+    state.process(register_);
+    state.process(irq_latch_);
+    state.process(irq_counter_);
+    state.process(irq_enabled_);
+    state.process(irq_reload_);
+}
@@ -3,9 +3,11 @@
 #include "mappers/mapper.h"
 
 // TxROM / MMC3
-class M004 : public Mapper
+class M004 final : public Mapper
 {
 public:
+    static constexpr byte_t ines_code = 4;
+
     M004(Cartridge& cart);
 
     bool on_cpu_read(address_t addr, byte_t& value) override;
@@ -14,12 +16,16 @@ public:
     bool on_ppu_read(address_t addr, byte_t& value) override;
     bool on_ppu_write(address_t addr, byte_t value) override;
 
+    const byte_t* get_cpu_page(address_t addr) const;
+
+    void serialize_state(StateStream& state, Cartridge& cart);
+
     void on_ppu_scanline(int scanline) override;
 
 private:
     Cartridge& cart_;
 
-    struct Register : register_t<byte_t>
+    struct Register : reg_t<byte_t>
     {
         byte_t bank_select_ : 3;
         byte_t _ : 2;
@@ -41,4 +47,33 @@ private:
     void on_irq_reload_();
     void on_irq_disable_();
     void on_irq_enable_();
-};
\ No newline at end of file
+};
+
+inline bool M004::on_cpu_read(address_t addr, byte_t& value)
+{
+    if (addr >= 0x6000 && addr < 0x8000)
+    {
+        if (!(cart_.battery_ && cart_.battery_->read(addr, value)))
+            value = cart_.wram_[addr & 0x1FFF];
+        return true;
+    }
+
+    if (addr >= 0x8000)
+    {
+        prg_map_.get_mapping(addr).read(addr & 0x1FFF, value);
+        return true;
+    }
+
+    return false;
+}
+
+inline bool M004::on_ppu_read(address_t addr, byte_t& value)
+{
+    if (addr < 0x2000)
+    {
+        chr_map_.get_mapping(addr).read(addr & 0x03FF, value);
+        return true;
+    }
+
+    return false;
+}
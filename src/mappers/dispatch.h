@@ -0,0 +1,47 @@
+#pragma once
+
+#include "cartridge.h"
+
+#include "mappers/000.h"
+#include "mappers/001.h"
+#include "mappers/004.h"
+
+// Static dispatch over the supported mappers: the switch downcasts to the final
+// mapper type, so the on_* calls below are direct and inline into the caller.
+// Every mapper listed in Mapper::create must have a case here.
+template <typename F>
+decltype(auto) Cartridge::visit_mapper(F&& f)
+{
+    switch (mapper_code_)
+    {
+    case M000::ines_code: return f(static_cast<M000&>(*mapper_));
+    case M001::ines_code: return f(static_cast<M001&>(*mapper_));
+    default:
+        NES_ASSERT(mapper_code_ == M004::ines_code);
+        return f(static_cast<M004&>(*mapper_));
+    }
+}
+
+inline bool Cartridge::on_cpu_read(address_t addr, byte_t& value)
+{
+    if (addr >= 0x4020)
+        return visit_mapper([&](auto& mapper) { return mapper.on_cpu_read(addr, value); });
+    return false;
+}
+
+inline bool Cartridge::on_cpu_write(address_t addr, byte_t value)
+{
+    if (addr >= 0x4020)
+        return visit_mapper([&](auto& mapper) { return mapper.on_cpu_write(addr, value); });
+    return false;
+}
+
+inline bool Cartridge::on_ppu_read(address_t addr, byte_t& value)
+{
+    return visit_mapper([&](auto& mapper) { return mapper.on_ppu_read(addr, value); });
+}
+
+inline bool Cartridge::on_ppu_write(address_t addr, byte_t value)
+{
+    return visit_mapper([&](auto& mapper) { return mapper.on_ppu_write(addr, value); });
+}
@@ -4,10 +4,12 @@
 #include "mappers/000.h"
 #include "mappers/001.h"
 #include "mappers/004.h"
+#include "save_state.h"
 
 #include <fmt/core.h>
 #include <stdexcept>
 
+// New mappers must also be added to Cartridge::visit_mapper (mappers/dispatch.h).
 Mapper* Mapper::create(byte_t ines_code, Cartridge& cart)
 {
     Mapper* mapper = nullptr;
@@ -22,4 +24,38 @@ Mapper* Mapper::create(byte_t ines_code, Cartridge& cart)
     }
 
     return mapper;
-}
\ No newline at end of file
+}
+void Mapper::serialize_view_(StateStream& state, BankView& view, std::span<byte_t> memory)
+{
+    int32_t offset = -1;
+    uint32_t size = 0;
+
+    if (state.is_writing() && !view.data_.empty())
+    {
+        offset = int_cast<int32_t>(view.data_.data() - memory.data());
+        size = int_cast<uint32_t>(view.data_.size());
+    }
+
+    state.process(offset);
+    state.process(size);
+    state.process(view.addr_);
+
+    if (!state.is_writing() && state.good())
+    {
+        if (offset < 0)
+            view.data_ = {};
+        else if (offset + size <= memory.size())
+            view.data_ = memory.subspan(offset, size);
+        else
+            state.fail();
+    }
+}
+
+void Mapper::serialize_maps_(StateStream& state, Cartridge& cart)
+{
+    for (BankView& view : prg_map_.map_)
+        serialize_view_(state, view, cart.prg_rom_);
+
+    for (BankView& view : chr_map_.map_)
+        serialize_view_(state, view, cart.chr_rom_);
+}
@@ -6,6 +6,8 @@
 #include <array>
 #include <vector>
 
+class StateStream;
+
 class Mapper
 {
 public:
@@ -22,6 +24,10 @@ public:
 
     virtual void on_ppu_scanline(int scanline) {}
 
+    // Contiguous 256 bytes backing the cpu page at addr, or nullptr when the page
+    // must be read byte per byte (see BUS::read_cpu_page).
+    const byte_t* get_cpu_page(address_t addr) const { return nullptr; }
+
     virtual BankView get_cpu_mapped_bank(address_t addr) const
     {
         return prg_map_.get_mapping(map_to_cpu_addr(addr));
@@ -44,6 +50,10 @@ public:
     }
 
 protected:
+    // Bank views are saved as offsets into the cartridge memory they point to.
+    static void serialize_view_(StateStream& state, BankView& view, std::span<byte_t> memory);
+    void serialize_maps_(StateStream& state, Cartridge& cart);
+
     MemoryMap prg_map_;
     MemoryMap chr_map_;
 };
\ No newline at end of file
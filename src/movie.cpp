@@ -0,0 +1,267 @@
+#include "movie.h"
+
+#include "controller.h"
+#include "emulator.h"
+
+#include <fmt/format.h>
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    template <typename T>
+    void write_raw(std::ostream& os, const T& value)
+    {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    bool read_raw(std::istream& is, T& value)
+    {
+        return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    void write_varint(std::ostream& os, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            os.put(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+
+        os.put(static_cast<char>(value));
+    }
+
+    bool read_varint(std::istream& is, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const int c = is.get();
+            if (c == std::char_traits<char>::eof())
+                return false;
+
+            value |= static_cast<uint64_t>(c & 0x7F) << shift;
+            if (!(c & 0x80))
+                return true;
+        }
+
+        return false;
+    }
+}
+
+void Movie::save(const stdfs::path& filepath) const
+{
+    std::ofstream ofs(filepath, std::ios::binary);
+    if (!ofs.is_open())
+        throw std::runtime_error(fmt::format("Can't write {}", filepath.string()));
+
+    write(ofs);
+}
+
+// Header, then runs of identical frames: varint count, buttons, command.
+void Movie::write(std::ostream& os) const
+{
+    write_raw(os, magic);
+    write_raw(os, version);
+    write_raw(os, uint16_t { 0 });
+    write_raw(os, rom_hash_);
+    write_raw(os, static_cast<uint64_t>(frames_.size()));
+
+    for (size_t i = 0; i < frames_.size();)
+    {
+        size_t run = 1;
+        while (i + run < frames_.size() && frames_[i + run] == frames_[i])
+            ++run;
+
+        write_varint(os, run);
+        os.put(static_cast<char>(frames_[i].buttons_));
+        os.put(static_cast<char>(frames_[i].command_));
+        i += run;
+    }
+
+    if (!os)
+        throw std::runtime_error("Can't write movie");
+}
+
+Movie Movie::load(const stdfs::path& filepath)
+{
+    const bool fm2 = filepath.extension() == ".fm2";
+
+    std::ifstream ifs(filepath, fm2 ? std::ios::in : std::ios::binary);
+    if (!ifs.is_open())
+        throw std::runtime_error(fmt::format("Can't read {}", filepath.string()));
+
+    return fm2 ? read_fm2(ifs) : read(ifs);
+}
+
+Movie Movie::read(std::istream& is)
+{
+    uint32_t file_magic = 0;
+    uint16_t file_version = 0;
+    uint16_t reserved = 0;
+    uint64_t count = 0;
+
+    Movie movie;
+    if (!read_raw(is, file_magic) || file_magic != magic)
+        throw std::runtime_error("Not a movie");
+
+    if (!read_raw(is, file_version) || file_version != version)
+        throw std::runtime_error("Unsupported movie version");
+
+    if (!read_raw(is, reserved) || !read_raw(is, movie.rom_hash_) || !read_raw(is, count))
+        throw std::runtime_error("Truncated movie");
+
+    while (movie.frames_.size() < count)
+    {
+        uint64_t run = 0;
+        if (!read_varint(is, run))
+            throw std::runtime_error("Truncated movie");
+
+        const int buttons = is.get();
+        const int command = is.get();
+        if (buttons == std::char_traits<char>::eof() || command == std::char_traits<char>::eof())
+            throw std::runtime_error("Truncated movie");
+
+        if (command > static_cast<int>(MovieCommand::PowerOn) || run == 0 || run > count - movie.frames_.size())
+            throw std::runtime_error("Corrupted movie");
+
+        movie.frames_.insert(movie.frames_.end(), run, { static_cast<byte_t>(buttons), static_cast<MovieCommand>(command) });
+    }
+
+    return movie;
+}
+
+// Input lines look like |commands|RLDUTSBA|port1|port2|, anything but '.' or ' ' is pressed.
+Movie Movie::read_fm2(std::istream& is)
+{
+    static constexpr Controller::Button order[8] = {
+        Controller::Right, Controller::Left, Controller::Down, Controller::Up,
+        Controller::Start, Controller::Select, Controller::B, Controller::A,
+    };
+
+    Movie movie;
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(is, line))
+    {
+        ++line_number;
+
+        std::string_view sv = line;
+        if (sv.ends_with('\r'))
+            sv.remove_suffix(1);
+
+        if (!sv.starts_with('|'))
+        {
+            if (sv == "binary 1" || sv == "binary true")
+                throw std::runtime_error("Binary fm2 movies are not supported");
+
+            continue;
+        }
+
+        // |commands|
+        sv.remove_prefix(1);
+        const size_t commands_end = sv.find('|');
+        if (commands_end == std::string_view::npos)
+            throw std::runtime_error(fmt::format("Bad fm2 input on line {}", line_number));
+
+        int commands = 0;
+        for (char c : sv.substr(0, commands_end))
+        {
+            if (c < '0' || c > '9')
+                throw std::runtime_error(fmt::format("Bad fm2 command on line {}", line_number));
+            commands = commands * 10 + (c - '0');
+        }
+
+        sv.remove_prefix(commands_end + 1);
+
+        MovieFrame frame;
+        if (commands & 0x02)
+            frame.command_ = MovieCommand::PowerOn;
+        else if (commands & 0x01)
+            frame.command_ = MovieCommand::Reset;
+
+        // An empty field when port 0 has no gamepad
+        const std::string_view port0 = sv.substr(0, sv.find('|'));
+        if (!port0.empty() && port0.size() != 8)
+            throw std::runtime_error(fmt::format("Bad fm2 gamepad on line {}", line_number));
+
+        for (size_t i = 0; i < port0.size(); ++i)
+        {
+            if (port0[i] != '.' && port0[i] != ' ')
+                frame.buttons_ |= order[i];
+        }
+
+        movie.frames_.push_back(frame);
+    }
+
+    return movie;
+}
+
+void MovieRecorder::begin(const Emulator& emulator)
+{
+    movie_ = {};
+    movie_.rom_hash_ = emulator.is_ready() ? emulator.get_cart()->get_rom_hash() : 0;
+    strobes_ = emulator.get_bus()->ctrl_.get_strobe_count();
+    lag_frames_ = 0;
+}
+
+void MovieRecorder::on_frame(const Emulator& emulator)
+{
+    const Controller& ctrl = emulator.get_bus()->ctrl_;
+
+    MovieFrame frame;
+    if (ctrl.get_strobe_count() != strobes_)
+    {
+        frame.buttons_ = ctrl.get_latched_state();
+    }
+    else
+    {
+        frame.buttons_ = ctrl.get_state();
+        ++lag_frames_;
+    }
+
+    strobes_ = ctrl.get_strobe_count();
+    movie_.frames_.push_back(frame);
+}
+
+MoviePlayer::MoviePlayer(const Movie& movie, const Emulator& emulator)
+    : movie_(movie)
+{
+    if (movie_.rom_hash_ != 0 && emulator.is_ready() && movie_.rom_hash_ != emulator.get_cart()->get_rom_hash())
+        throw std::runtime_error("Movie is for another ROM");
+}
+
+bool MoviePlayer::apply(Emulator& emulator)
+{
+    if (is_done())
+        return false;
+
+    const MovieFrame& frame = movie_.frames_[frame_++];
+
+    if (frame.command_ == MovieCommand::Reset)
+        emulator.reset();
+    else if (frame.command_ == MovieCommand::PowerOn)
+        emulator.power_on();
+
+    // Only the buttons that changed
+    const byte_t changed = emulator.get_bus()->ctrl_.get_state() ^ frame.buttons_;
+    for (int bit = 0; bit < 8; ++bit)
+    {
+        const auto button = static_cast<Controller::Button>(1 << bit);
+        if (!(changed & button))
+            continue;
+
+        if (frame.buttons_ & button)
+            emulator.press_button(button);
+        else
+            emulator.release_button(button);
+    }
+
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <iosfwd>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+class Emulator;
+
+enum class MovieCommand : byte_t
+{
+    None,
+    Reset,   // before the frame
+    PowerOn, // before the frame
+};
+
+struct MovieFrame
+{
+    byte_t buttons_ = 0; // Controller::Button bits of port 1
+    MovieCommand command_ = MovieCommand::None;
+
+    bool operator==(const MovieFrame&) const = default;
+};
+
+// Controller 1 input for every frame since power on.
+// The binary format run-length encodes identical frames, a held button costs a few bytes.
+struct Movie
+{
+    static constexpr uint32_t magic = 0x4D53454E; // "NESM"
+    static constexpr uint16_t version = 1;
+
+    uint64_t rom_hash_ = 0; // 0 when unknown (imported), not checked then
+    std::vector<MovieFrame> frames_;
+
+    // All throw std::runtime_error on failure
+    void save(const stdfs::path& filepath) const;
+    void write(std::ostream& os) const;
+
+    // Picks the format from the extension, .fm2 or the binary one
+    static Movie load(const stdfs::path& filepath);
+    static Movie read(std::istream& is);
+
+    // FCEUX text movies, only the port 0 gamepad and the reset/power commands are used.
+    static Movie read_fm2(std::istream& is);
+};
+
+// Records the buttons the game latched through $4016 each frame, the current ones on lag frames.
+class MovieRecorder
+{
+public:
+    // Starts a movie at the current frame, call right after power on for a replayable one.
+    void begin(const Emulator& emulator);
+
+    // Call after every emulated frame.
+    void on_frame(const Emulator& emulator);
+
+    const Movie& movie() const { return movie_; }
+    uint64_t lag_frames() const { return lag_frames_; }
+
+private:
+    Movie movie_;
+    uint64_t strobes_ = 0;
+    uint64_t lag_frames_ = 0;
+};
+
+// Drives Emulator::press_button/release_button from a movie.
+class MoviePlayer
+{
+public:
+    // Throws if the movie was recorded on another ROM.
+    MoviePlayer(const Movie& movie, const Emulator& emulator);
+
+    // Call before every emulated frame, false once the movie is over.
+    bool apply(Emulator& emulator);
+
+    bool is_done() const { return frame_ >= movie_.frames_.size(); }
+    size_t frame() const { return frame_; }
+
+private:
+    const Movie& movie_;
+    size_t frame_ = 0;
+};
@@ -0,0 +1,247 @@
+#include "perf_counters.h"
+
+#include <fmt/format.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#endif
+
+double PerfSample::ipc() const
+{
+    const uint64_t cycles = (*this)[PerfEvent::Cycles];
+    return cycles ? static_cast<double>((*this)[PerfEvent::Instructions]) / cycles : 0.0;
+}
+
+double PerfSample::branch_mpki() const
+{
+    const uint64_t instructions = (*this)[PerfEvent::Instructions];
+    return instructions ? 1000.0 * (*this)[PerfEvent::BranchMisses] / instructions : 0.0;
+}
+
+double PerfSample::l1d_mpki() const
+{
+    const uint64_t instructions = (*this)[PerfEvent::Instructions];
+    return instructions ? 1000.0 * (*this)[PerfEvent::L1DMisses] / instructions : 0.0;
+}
+
+PerfSample& PerfSample::operator+=(const PerfSample& other)
+{
+    for (size_t i = 0; i < perf_event_count; ++i)
+        counts_[i] += other.counts_[i];
+    return *this;
+}
+
+PerfSample PerfSample::operator-(const PerfSample& other) const
+{
+    PerfSample diff;
+    for (size_t i = 0; i < perf_event_count; ++i)
+        diff.counts_[i] = counts_[i] - other.counts_[i];
+    return diff;
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+#if defined(__linux__)
+
+namespace
+{
+    struct EventConfig
+    {
+        uint32_t type_;
+        uint64_t config_;
+    };
+
+    constexpr std::array<EventConfig, perf_event_count> event_configs = { {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    } };
+
+    // PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+    struct GroupRead
+    {
+        uint64_t nr_;
+        uint64_t time_enabled_;
+        uint64_t time_running_;
+        std::array<uint64_t, perf_event_count> values_;
+    };
+
+    long perf_event_open(perf_event_attr& attr, int group_fd)
+    {
+        // This thread, any cpu
+        return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t read_pmc(uint32_t counter)
+    {
+        uint32_t lo, hi;
+        asm volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+        return lo | static_cast<uint64_t>(hi) << 32;
+    }
+
+    // The seqlock protocol from linux/perf_event.h, false when the counter is not on a PMC
+    bool read_mmap_counter(const perf_event_mmap_page& page, uint64_t& value)
+    {
+        uint32_t seq;
+        do
+        {
+            seq = page.lock;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+
+            const uint32_t index = page.index;
+            if (!page.cap_user_rdpmc || index == 0)
+                return false;
+
+            int64_t pmc = static_cast<int64_t>(read_pmc(index - 1));
+            const int shift = 64 - page.pmc_width;
+            pmc = (pmc << shift) >> shift;
+
+            value = page.offset + pmc;
+
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } while (page.lock != seq);
+
+        return true;
+    }
+#endif
+}
+
+bool PerfCounters::open()
+{
+    close();
+    error_.clear();
+
+    for (size_t i = 0; i < perf_event_count; ++i)
+    {
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        attr.type = event_configs[i].type_;
+        attr.config = event_configs[i].config_;
+        attr.disabled = i == 0; // the leader starts the whole group
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const long fd = perf_event_open(attr, i == 0 ? -1 : fds_[0]);
+        if (fd < 0)
+        {
+            error_ = fmt::format("perf_event_open: {} (event {})", std::strerror(errno), i);
+            close();
+            return false;
+        }
+
+        fds_[i] = static_cast<int>(fd);
+    }
+
+    // One page each, for rdpmc
+    rdpmc_ = true;
+    for (size_t i = 0; i < perf_event_count; ++i)
+    {
+        void* page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fds_[i], 0);
+        if (page == MAP_FAILED)
+        {
+            rdpmc_ = false;
+            continue;
+        }
+
+        pages_[i] = page;
+        rdpmc_ = rdpmc_ && static_cast<const perf_event_mmap_page*>(page)->cap_user_rdpmc;
+    }
+
+#if !defined(__x86_64__) && !defined(__i386__)
+    rdpmc_ = false;
+#endif
+
+    ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void PerfCounters::close()
+{
+    for (size_t i = perf_event_count; i-- > 0;)
+    {
+        if (pages_[i])
+            munmap(pages_[i], sysconf(_SC_PAGESIZE));
+        pages_[i] = nullptr;
+
+        if (fds_[i] >= 0)
+            ::close(fds_[i]);
+        fds_[i] = -1;
+    }
+
+    rdpmc_ = false;
+}
+
+bool PerfCounters::read(PerfSample& sample) const
+{
+    if (!is_open())
+        return false;
+
+    GroupRead group {};
+    if (::read(fds_[0], &group, sizeof(group)) != static_cast<ssize_t>(sizeof(group)) || group.nr_ != perf_event_count)
+        return false;
+
+    // Multiplexed with other users of the PMU, extrapolated from the time it was scheduled
+    const double scale = group.time_running_ > 0 ? static_cast<double>(group.time_enabled_) / group.time_running_ : 0.0;
+
+    for (size_t i = 0; i < perf_event_count; ++i)
+        sample.counts_[i] = group.time_running_ == group.time_enabled_ ? group.values_[i] : static_cast<uint64_t>(group.values_[i] * scale);
+
+    return true;
+}
+
+bool PerfCounters::read_user(PerfSample& sample) const
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (!rdpmc_)
+        return false;
+
+    for (size_t i = 0; i < perf_event_count; ++i)
+    {
+        if (!read_mmap_counter(*static_cast<const perf_event_mmap_page*>(pages_[i]), sample.counts_[i]))
+            return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+#else
+
+bool PerfCounters::open()
+{
+    error_ = "hardware counters are only available on Linux";
+    return false;
+}
+
+void PerfCounters::close()
+{
+}
+
+bool PerfCounters::read(PerfSample& sample) const
+{
+    return false;
+}
+
+bool PerfCounters::read_user(PerfSample& sample) const
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <string>
+
+enum class PerfEvent : byte_t
+{
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1DMisses, // data reads
+    Count
+};
+
+constexpr size_t perf_event_count = static_cast<size_t>(PerfEvent::Count);
+
+struct PerfSample
+{
+    std::array<uint64_t, perf_event_count> counts_ {};
+
+    uint64_t operator[](PerfEvent event) const { return counts_[static_cast<size_t>(event)]; }
+
+    double ipc() const;
+    // Misses per thousand instructions
+    double branch_mpki() const;
+    double l1d_mpki() const;
+
+    PerfSample& operator+=(const PerfSample& other);
+    PerfSample operator-(const PerfSample& other) const;
+};
+
+// Hardware counters of the calling thread through perf_event_open, user space only.
+// Linux only, open() fails elsewhere, in most VMs and with kernel.perf_event_paranoid > 2.
+class PerfCounters
+{
+public:
+    PerfCounters() = default;
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Starts counting, false with error() set when the counters are not available
+    bool open();
+    void close();
+
+    bool is_open() const { return fds_[0] >= 0; }
+    const std::string& error() const { return error_; }
+
+    // Counts since open(), scaled if the kernel multiplexed them. A system call.
+    bool read(PerfSample& sample) const;
+
+    // The raw counts through rdpmc, cheap enough to bracket a single emulated cycle.
+    // False when the kernel doesn't allow it or a counter is not on the PMU right now.
+    bool read_user(PerfSample& sample) const;
+    bool has_user_read() const { return rdpmc_; }
+
+private:
+    std::array<int, perf_event_count> fds_ = { -1, -1, -1, -1 };
+    std::array<void*, perf_event_count> pages_ {}; // perf_event_mmap_page of every counter
+    bool rdpmc_ = false;
+    std::string error_;
+};
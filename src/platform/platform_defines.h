@@ -5,7 +5,7 @@
 #endif
 
 #ifndef IS_WINDOWS
-#defined IS_WINDOWS 0
+#define IS_WINDOWS 0
 #endif
 
 
@@ -2,6 +2,7 @@
 
 #include "debugger.h"
 #include "ram.h"
+#include "save_state.h"
 
 
 void PPU::step()
@@ -37,6 +38,31 @@ void PPU::reset()
     oam_.fill(0xFF);
 }
 
+void PPU::power_on()
+{
+    memory_.fill(0);
+    palette_.fill(0);
+    reset();
+}
+
+void PPU::serialize_state(StateStream& state)
+{
+    state.process(get_state());
+
+    state.process(memory_);
+    state.process(palette_);
+    state.process(oam_);
+
+    state.process(bg_next_tile_);
+    state.process(bg_shifter_);
+    state.process(secondary_oam_);
+
+    state.process(ppuctrl_);
+    state.process(ppumask_);
+    state.process(ppustatus_);
+    state.process(cursor_);
+}
+
 bool PPU::on_write_cpu(address_t addr, byte_t value)
 {
     // Mirroring
@@ -224,6 +250,11 @@ void PPU::dma_copy_byte(byte_t rw_cycle)
     oam_[rw_cycle] = data;
 }
 
+bool PPU::dma_copy_page()
+{
+    return bus_->read_cpu_page(dma_page_idx_, oam_);
+}
+
 void PPU::bg_eval_()
 {
     auto& v = cursor_.v;
@@ -498,14 +529,14 @@ void PPU::tick_()
         cycle_ = 0;
         ++scanline_;
 
-        Debugger::instance()->on_ppu_line();
+        bus_->debugger_.on_ppu_line();
 
         if (scanline_ > 260)
         {
             scanline_ = -1;
             ++frame_;
             frame_done_ = true;
-            Debugger::instance()->on_ppu_frame();
+            bus_->debugger_.on_ppu_frame();
         }
     }
 
@@ -638,4 +669,31 @@ address_t PPU::mirror_addr_(address_t addr) const
     }
 
     return addr;
-}
\ No newline at end of file
+}
+
+Palette ppu_read_palette(const BUS& bus, int idx)
+{
+    NES_ASSERT(idx >= 0 && idx < 8);
+    if (idx < 4)
+    {
+        static constexpr address_t palette_bg[] = {0x3F01, 0x3F05, 0x3F09, 0x3F0D};
+        address_t paladdr = palette_bg[idx];
+        return Palette(
+            g_palette[bus.read_ppu(0x3F00)],
+            g_palette[bus.read_ppu(paladdr + 0)],
+            g_palette[bus.read_ppu(paladdr + 1)],
+            g_palette[bus.read_ppu(paladdr + 2)]
+        );
+    }
+    else
+    {
+        static constexpr address_t palette_fg[] = {0x3F11, 0x3F15, 0x3F19, 0x3F1D};
+        address_t paladdr = palette_fg[idx - 4];
+        return Palette(
+            {0xFF, 0xFF, 0xFF, 0x00},
+            g_palette[bus.read_ppu(paladdr + 0)],
+            g_palette[bus.read_ppu(paladdr + 1)],
+            g_palette[bus.read_ppu(paladdr + 2)]
+        );
+    }
+}
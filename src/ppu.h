@@ -4,12 +4,14 @@
 #include "bus.h"
 #include "cpu.h"
 #include "cartridge.h"
-#include "ui/ppu_utils.h"
+#include "ppu_types.h"
 
 #include <array>
 #include <span>
 #include <cstring>
 
+class StateStream;
+
 
 struct TileShifter
 {
@@ -92,6 +94,10 @@ public:
 
     void step();
     void reset();
+    void power_on();
+
+    // The output image is not saved, the next frame redraws it.
+    void serialize_state(StateStream& state);
 
     bool on_write_cpu(address_t addr, byte_t value);
     bool on_read_cpu(address_t addr, byte_t& value);
@@ -100,6 +106,7 @@ public:
     bool on_read_ppu(address_t addr, byte_t& value);
 
     void dma_copy_byte(byte_t rw_cycle);
+    bool dma_copy_page();
 
     byte_t* data()
     {
@@ -111,6 +118,8 @@ public:
         return memory_.data();
     }
 
+    std::span<const byte_t, 0x20> palette_data() const { return palette_; }
+
     byte_t* oam_data()
     {
         return oam_.data();
@@ -126,6 +135,9 @@ public:
         return output_;
     }
 
+    // Shows a picture emulated elsewhere (run-ahead), the next frame draws over it.
+    void set_output(const Output& output) { output_ = output; }
+
     inline uint64_t frame() const { return frame_; }
     
     bool grab_dma_request()
@@ -213,7 +225,7 @@ private:
     BUS* bus_ = nullptr;
 
     // registers
-    struct : public register_t<byte_t>
+    struct : public reg_t<byte_t>
     {
         byte_t nam_x_ : 1; // (bit 0)
         byte_t nam_y_ : 1; // (bit 1)
@@ -226,7 +238,7 @@ private:
     } ppuctrl_;
     static_assert(sizeof(decltype(ppuctrl_)) == sizeof(byte_t));
 
-    struct : public register_t<byte_t>
+    struct : public reg_t<byte_t>
     {
         byte_t greyscale_ : 1; // (bit 0)
         byte_t left_bg_ : 1; // (bit 1)
@@ -239,7 +251,7 @@ private:
     } ppumask_;
     static_assert(sizeof(decltype(ppumask_)) == sizeof(byte_t));
 
-    struct : public register_t<byte_t>
+    struct : public reg_t<byte_t>
     {
         byte_t garbage_ : 5; // (bits 0-4)
         byte_t sprite_overflow_ : 1; // (bit 5)
@@ -251,7 +263,7 @@ private:
     // vram cursor (PPUSCROLL, PPUADDR and PPUDATA)
     struct Cursor
     {
-        struct VRAM : public register_t<address_t>
+        struct VRAM : public reg_t<address_t>
         {
             address_t X : 5; // Coarse X scroll (bits 0-4)
             address_t Y : 5; // Coarse Y scroll (bits 5-9)
@@ -0,0 +1,15 @@
+#include "prg_page_table.h"
+
+void PrgPageTable::remap_()
+{
+    mapped_switches_ = cart_->bank_switches_;
+
+    const byte_t* rom = cart_->prg_rom_.data();
+    const byte_t* rom_end = rom + cart_->prg_rom_.size();
+
+    for (size_t i = 0; i < pages_.size(); ++i)
+    {
+        const byte_t* page = cart_->get_cpu_page(static_cast<address_t>(0x8000 + (i << 8)));
+        pages_[i] = (page >= rom && page < rom_end) ? static_cast<size_t>(page - rom) : none;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "types.h"
+#include "cartridge.h"
+
+#include <array>
+
+// PRG ROM offsets of the $8000-$FFFF mapping, per 256 bytes page, for the profilers.
+// Rebuilt on the first lookup after the cartridge counts a bank switch; invalidate()
+// covers the mapping changes that are not counted (loading a state).
+class PrgPageTable
+{
+public:
+    static constexpr size_t bank_size = 0x2000; // the banks offsets are reported in
+    static constexpr size_t none = SIZE_MAX;
+
+    void attach(Cartridge* cart)
+    {
+        cart_ = cart;
+        invalidate();
+    }
+
+    Cartridge* get_cart() const { return cart_; }
+
+    void invalidate() { mapped_switches_ = UINT64_MAX; }
+
+    // The PRG ROM offset of the byte at addr, none below $8000 or where no ROM is mapped
+    size_t rom_offset(address_t addr)
+    {
+        if (addr < 0x8000 || cart_ == nullptr)
+            return none;
+
+        if (cart_->bank_switches_ != mapped_switches_) [[unlikely]]
+            remap_();
+
+        const size_t page = pages_[(addr >> 8) & 0x7F];
+        return page == none ? none : page + (addr & 0xFF);
+    }
+
+    static int bank(size_t offset) { return offset == none ? -1 : static_cast<int>(offset / bank_size); }
+
+private:
+    void remap_();
+
+    Cartridge* cart_ = nullptr;
+    uint64_t mapped_switches_ = UINT64_MAX;
+    std::array<size_t, 0x80> pages_ {};
+};
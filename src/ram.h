@@ -2,7 +2,9 @@
 
 #include "types.h"
 
+#include <array>
 #include <cstring>
+#include <span>
 
 class RAM
 {
@@ -30,6 +32,11 @@ public:
     }
 
     byte_t* data() { return memory_.data(); }
+    const byte_t* data() const { return memory_.data(); }
+
+    void clear() { memory_.fill(0); }
+
+    std::span<byte_t, 0x800> memory() { return memory_; }
 
 private:
     // 2KB for internal RAM
@@ -0,0 +1,331 @@
+#include "rewind.h"
+
+#include "emulator.h"
+
+#include <algorithm>
+
+// Shorter zero runs are kept in the literals, a run costs two varints
+static constexpr size_t min_zero_run = 4;
+
+static void put_varint(std::vector<byte_t>& out, size_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<byte_t>(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<byte_t>(value));
+}
+
+static bool get_varint(std::span<const byte_t> in, size_t& pos, size_t& value)
+{
+    value = 0;
+    for (int shift = 0; pos < in.size() && shift < 64; shift += 7)
+    {
+        const byte_t b = in[pos++];
+        value |= static_cast<size_t>(b & 0x7F) << shift;
+
+        if (!(b & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+RewindBuffer::RewindBuffer(const RewindConfig& config)
+    : config_(config)
+{
+    config_.interval_ = std::max(config_.interval_, 1);
+    config_.keyframe_interval_ = std::max(config_.keyframe_interval_, 1);
+
+    thread_ = std::thread([this] { run_worker_(); });
+}
+
+RewindBuffer::~RewindBuffer()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    thread_.join();
+}
+
+void RewindBuffer::on_frame(Emulator& emulator)
+{
+    if (!emulator.is_ready() || !emulator.is_stepping())
+        return;
+
+    // A new ROM invalidates every snapshot
+    const uint64_t rom_hash = emulator.get_cart()->get_rom_hash();
+    if (rom_hash != rom_hash_)
+    {
+        clear();
+        rom_hash_ = rom_hash;
+    }
+
+    if (++frame_ % config_.interval_ != 0)
+        return;
+
+    std::vector<byte_t> raw;
+    {
+        std::lock_guard lock(mutex_);
+        restored_ = false;
+
+        if (!spare_.empty())
+        {
+            raw = std::move(spare_.back());
+            spare_.pop_back();
+        }
+    }
+
+    emulator.save_state(raw);
+
+    {
+        std::lock_guard lock(mutex_);
+        pending_.push_back(std::move(raw));
+    }
+    wake_.notify_one();
+}
+
+bool RewindBuffer::step_back(Emulator& emulator)
+{
+    std::unique_lock lock(mutex_);
+    wait_idle_(lock);
+
+    // The latest entry is already on screen, go one further
+    if (restored_ && !entries_.empty())
+    {
+        bytes_ -= entries_.back().data_.size();
+        entries_.pop_back();
+    }
+
+    if (entries_.empty() || !reconstruct_(entries_.size() - 1, previous_))
+    {
+        entries_.clear();
+        bytes_ = 0;
+        previous_.clear();
+        since_keyframe_ = 0;
+        restored_ = false;
+        return false;
+    }
+
+    // New snapshots are deltas against the restored one
+    const auto keyframe = std::find_if(entries_.rbegin(), entries_.rend(), [](const Entry& e) { return e.keyframe_; });
+    since_keyframe_ = static_cast<int>(keyframe - entries_.rbegin());
+    restored_ = true;
+
+    emulator.load_state(previous_);
+    return true;
+}
+
+void RewindBuffer::clear()
+{
+    std::unique_lock lock(mutex_);
+    wait_idle_(lock);
+
+    entries_.clear();
+    bytes_ = 0;
+    previous_.clear();
+    since_keyframe_ = 0;
+    restored_ = false;
+    frame_ = 0;
+}
+
+RewindStats RewindBuffer::get_stats() const
+{
+    std::lock_guard lock(mutex_);
+
+    RewindStats stats;
+    stats.snapshots_ = entries_.size();
+    stats.bytes_ = bytes_;
+    stats.dropped_ = dropped_;
+
+    for (const Entry& entry : entries_)
+    {
+        stats.keyframes_ += entry.keyframe_ ? 1 : 0;
+        stats.raw_bytes_ += entry.size_;
+    }
+
+    return stats;
+}
+
+void RewindBuffer::encode(std::span<const byte_t> delta, std::vector<byte_t>& out)
+{
+    out.clear();
+
+    const size_t n = delta.size();
+    size_t i = 0;
+
+    while (i < n)
+    {
+        const size_t zeros_start = i;
+        while (i < n && delta[i] == 0)
+            ++i;
+
+        const size_t zeros = i - zeros_start;
+
+        // Literals stop at the first long enough zero run
+        const size_t literals_start = i;
+        while (i < n)
+        {
+            if (delta[i] != 0)
+            {
+                ++i;
+                continue;
+            }
+
+            size_t run = 0;
+            while (i + run < n && delta[i + run] == 0 && run < min_zero_run)
+                ++run;
+
+            if (run >= min_zero_run || i + run == n)
+                break;
+
+            i += run;
+        }
+
+        put_varint(out, zeros);
+        put_varint(out, i - literals_start);
+        out.insert(out.end(), delta.begin() + literals_start, delta.begin() + i);
+    }
+}
+
+bool RewindBuffer::decode_xor(std::span<const byte_t> in, std::span<byte_t> state)
+{
+    size_t pos = 0;
+    size_t out = 0;
+
+    while (pos < in.size())
+    {
+        size_t zeros = 0;
+        size_t count = 0;
+        if (!get_varint(in, pos, zeros) || !get_varint(in, pos, count))
+            return false;
+
+        if (zeros > state.size() - out)
+            return false;
+
+        out += zeros;
+
+        if (count > state.size() - out || count > in.size() - pos)
+            return false;
+
+        for (size_t i = 0; i < count; ++i)
+            state[out + i] ^= in[pos + i];
+
+        out += count;
+        pos += count;
+    }
+
+    return out == state.size();
+}
+
+void RewindBuffer::run_worker_()
+{
+    std::unique_lock lock(mutex_);
+
+    for (;;)
+    {
+        wake_.wait(lock, [this] { return !pending_.empty() || stopping_; });
+
+        if (stopping_)
+            return;
+
+        std::vector<byte_t> raw = std::move(pending_.front());
+        pending_.pop_front();
+        busy_ = true;
+
+        lock.unlock();
+        compress_(raw);
+        lock.lock();
+
+        spare_.push_back(std::move(raw));
+        busy_ = false;
+
+        if (pending_.empty())
+            idle_.notify_all();
+    }
+}
+
+// Runs on the helper thread, the fields it writes without the lock are only read by
+// step_back and clear once the thread is idle.
+void RewindBuffer::compress_(std::vector<byte_t>& raw)
+{
+    Entry entry;
+    entry.size_ = raw.size();
+    entry.keyframe_ = previous_.size() != raw.size() || since_keyframe_ + 1 >= config_.keyframe_interval_;
+
+    if (entry.keyframe_)
+    {
+        encode(raw, entry.data_);
+        since_keyframe_ = 0;
+    }
+    else
+    {
+        delta_.resize(raw.size());
+        for (size_t i = 0; i < raw.size(); ++i)
+            delta_[i] = raw[i] ^ previous_[i];
+
+        encode(delta_, entry.data_);
+        ++since_keyframe_;
+    }
+
+    entry.data_.shrink_to_fit();
+
+    // raw leaves with the previous snapshot, to be reused as a spare
+    previous_.swap(raw);
+
+    std::lock_guard lock(mutex_);
+    bytes_ += entry.data_.size();
+    entries_.push_back(std::move(entry));
+    evict_();
+}
+
+void RewindBuffer::evict_()
+{
+    while (bytes_ > config_.budget_)
+    {
+        // The oldest keyframe and its deltas can only go if a newer keyframe remains
+        const auto next = std::find_if(entries_.begin() + 1, entries_.end(), [](const Entry& e) { return e.keyframe_; });
+        if (next == entries_.end())
+            break;
+
+        for (auto it = entries_.begin(); it != next; ++it)
+        {
+            bytes_ -= it->data_.size();
+            ++dropped_;
+        }
+
+        entries_.erase(entries_.begin(), next);
+    }
+}
+
+void RewindBuffer::wait_idle_(std::unique_lock<std::mutex>& lock)
+{
+    idle_.wait(lock, [this] { return pending_.empty() && !busy_; });
+}
+
+// Decodes the nearest keyframe at or before idx, then applies the deltas up to idx.
+bool RewindBuffer::reconstruct_(size_t idx, std::vector<byte_t>& state) const
+{
+    size_t key = idx;
+    while (!entries_[key].keyframe_)
+    {
+        if (key == 0)
+            return false;
+        --key;
+    }
+
+    state.assign(entries_[key].size_, 0);
+
+    for (size_t i = key; i <= idx; ++i)
+    {
+        if (entries_[i].size_ != state.size() || !decode_xor(entries_[i].data_, state))
+            return false;
+    }
+
+    return true;
+}
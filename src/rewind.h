@@ -0,0 +1,97 @@
+#pragma once
+
+#include "types.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+class Emulator;
+
+struct RewindConfig
+{
+    int interval_ = 2; // frames between snapshots
+    int keyframe_interval_ = 60; // snapshots between full (non delta) snapshots
+    size_t budget_ = 32 << 20; // bytes of compressed snapshots
+};
+
+struct RewindStats
+{
+    size_t snapshots_ = 0;
+    size_t keyframes_ = 0;
+    size_t bytes_ = 0; // compressed
+    size_t raw_bytes_ = 0;
+    uint64_t dropped_ = 0; // snapshots evicted by the budget
+};
+
+// Ring of save states taken every few frames.
+// The emulation thread only copies the save state out, a helper thread XORs it against the
+// previous snapshot and run-length encodes the zero runs. Every keyframe_interval snapshots a
+// full state is stored instead, the oldest keyframe and its deltas are evicted over budget.
+class RewindBuffer
+{
+public:
+    explicit RewindBuffer(const RewindConfig& config = {});
+    ~RewindBuffer();
+
+    RewindBuffer(const RewindBuffer&) = delete;
+    RewindBuffer& operator=(const RewindBuffer&) = delete;
+
+    // Call after every emulated frame.
+    void on_frame(Emulator& emulator);
+
+    // Loads the latest snapshot, then the one before it on the next call...
+    // Returns false once the buffer is exhausted.
+    bool step_back(Emulator& emulator);
+
+    void clear();
+
+    RewindStats get_stats() const;
+
+    static void encode(std::span<const byte_t> delta, std::vector<byte_t>& out);
+    // XORs the decoded delta into state, false on malformed input.
+    static bool decode_xor(std::span<const byte_t> in, std::span<byte_t> state);
+
+private:
+    struct Entry
+    {
+        std::vector<byte_t> data_;
+        size_t size_ = 0; // of the save state
+        bool keyframe_ = false;
+    };
+
+    void run_worker_();
+    void compress_(std::vector<byte_t>& raw);
+    void evict_();
+    void wait_idle_(std::unique_lock<std::mutex>& lock);
+    bool reconstruct_(size_t idx, std::vector<byte_t>& state) const;
+
+    RewindConfig config_;
+
+    uint64_t frame_ = 0;
+    uint64_t rom_hash_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<std::vector<byte_t>> pending_;
+    std::vector<std::vector<byte_t>> spare_;
+    bool busy_ = false;
+    bool stopping_ = false;
+
+    // Owned by the helper thread while it is busy
+    std::deque<Entry> entries_;
+    std::vector<byte_t> previous_;
+    std::vector<byte_t> delta_;
+    int since_keyframe_ = 0;
+    size_t bytes_ = 0;
+    uint64_t dropped_ = 0;
+
+    // The latest entry was restored by step_back and nothing was captured since
+    bool restored_ = false;
+
+    std::thread thread_;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <span>
+
+// Lock-free single-producer/single-consumer ring buffer.
+// The capacity is rounded up to a power of two. Read and write indices grow
+// freely and are masked on access, so a full buffer needs no extra slot.
+template <typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(size_t capacity)
+        : mask_(std::bit_ceil(capacity) - 1)
+        , data_(new T[mask_ + 1])
+    {
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    size_t size() const
+    {
+        return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+    }
+
+    // Producer side, returns the number of items written.
+    size_t write(std::span<const T> items)
+    {
+        const size_t w = write_.load(std::memory_order_relaxed);
+        const size_t r = read_.load(std::memory_order_acquire);
+        const size_t count = std::min(items.size(), capacity() - (w - r));
+
+        const size_t first = std::min(count, capacity() - (w & mask_));
+        std::copy_n(items.data(), first, data_.get() + (w & mask_));
+        std::copy_n(items.data() + first, count - first, data_.get());
+
+        write_.store(w + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side, returns the number of items read.
+    size_t read(std::span<T> items)
+    {
+        const size_t r = read_.load(std::memory_order_relaxed);
+        const size_t w = write_.load(std::memory_order_acquire);
+        const size_t count = std::min(items.size(), w - r);
+
+        const size_t first = std::min(count, capacity() - (r & mask_));
+        std::copy_n(data_.get() + (r & mask_), first, items.data());
+        std::copy_n(data_.get(), count - first, items.data() + first);
+
+        read_.store(r + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side, drops everything currently buffered.
+    void discard()
+    {
+        read_.store(write_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t cache_line_size = 64;
+
+    // Each index is only written by one side, keep them on separate cache lines.
+    alignas(cache_line_size) std::atomic<size_t> write_ { 0 };
+    alignas(cache_line_size) std::atomic<size_t> read_ { 0 };
+
+    size_t mask_;
+    std::unique_ptr<T[]> data_;
+};
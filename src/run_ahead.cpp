@@ -0,0 +1,223 @@
+#include "run_ahead.h"
+
+#include "emulator.h"
+
+#include <algorithm>
+#include <numeric>
+
+RunAhead::RunAhead(int frames, bool shadow)
+{
+    set_frames(frames);
+    set_shadow(shadow);
+}
+
+RunAhead::~RunAhead()
+{
+    set_shadow(false);
+}
+
+void RunAhead::set_frames(int frames)
+{
+    frames_ = std::clamp(frames, 0, 8);
+}
+
+void RunAhead::set_shadow(bool shadow)
+{
+    if (shadow == is_shadow())
+        return;
+
+    if (shadow)
+    {
+        shadow_.reset(new Emulator);
+        shadow_->set_verbose(false);
+        shadow_->set_host_break(false);
+        shadow_rom_hash_ = 0;
+        stopping_ = false;
+
+        thread_ = std::thread([this] { run_worker_(); });
+    }
+    else
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+
+        thread_.join();
+        shadow_.reset();
+    }
+}
+
+void RunAhead::update(Emulator& emulator)
+{
+    if (frames_ == 0 || !emulator.is_ready() || !emulator.is_stepping())
+    {
+        emulator.update();
+        return;
+    }
+
+    if (shadow_)
+        update_shadow_(emulator);
+    else
+        update_inline_(emulator);
+}
+
+RunAheadStats RunAhead::get_stats() const
+{
+    RunAheadStats stats;
+    stats.frames_ = frames_;
+    stats.shadow_ = is_shadow();
+    stats.failures_ = failures_;
+
+    const size_t count = std::min(frame_count_, frame_times_.size());
+    if (count == 0)
+        return stats;
+
+    auto mean = [count](const std::array<float, 128>& times)
+    {
+        return std::accumulate(times.begin(), times.begin() + count, 0.0) / count;
+    };
+
+    stats.frame_us_ = mean(frame_times_);
+    stats.cost_us_ = mean(cost_times_);
+    stats.shadow_us_ = mean(shadow_times_);
+    return stats;
+}
+
+void RunAhead::update_inline_(Emulator& emulator)
+{
+    const auto start = clock::now();
+    emulator.update();
+    const auto frame_end = clock::now();
+
+    emulator.save_state(state_);
+
+    // The speculative frames must not be heard, their hashes, timings and profile would not be the real ones
+    const bool hashing = emulator.is_frame_hashing();
+    const bool instrumented = emulator.is_instrumented();
+    const bool profiling = emulator.is_profiling();
+    const bool call_profiling = emulator.is_call_profiling();
+    emulator.set_audio_muted(true);
+    emulator.set_frame_hashing(false);
+    emulator.set_instrumented(false);
+    emulator.set_profiling(false);
+    emulator.set_call_profiling(false);
+
+    for (int i = 0; i < frames_ && !emulator.is_debugging(); ++i)
+        emulator.update();
+
+    emulator.set_audio_muted(false);
+    emulator.set_frame_hashing(hashing);
+    emulator.set_instrumented(instrumented);
+    emulator.set_profiling(profiling);
+    emulator.set_call_profiling(call_profiling);
+
+    // The picture survives the rollback, it is not part of the state
+    if (emulator.is_debugging())
+    {
+        // The real frames will get there again
+        emulator.debugger_.resume();
+        ++failures_;
+    }
+
+    emulator.load_state(state_);
+
+    record_(frame_end - start, clock::now() - frame_end);
+}
+
+void RunAhead::update_shadow_(Emulator& emulator)
+{
+    const auto start = clock::now();
+
+    const uint64_t rom_hash = emulator.get_cart()->get_rom_hash();
+    if (rom_hash != shadow_rom_hash_)
+    {
+        shadow_->read_rom(emulator.get_rom_path().wstring());
+        shadow_rom_hash_ = rom_hash;
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        emulator.save_state(job_state_);
+        job_frames_ = frames_ + 1;
+        job_pending_ = true;
+    }
+    wake_.notify_one();
+
+    const auto submitted = clock::now();
+    emulator.update();
+    const auto frame_end = clock::now();
+
+    bool failed = false;
+    {
+        std::unique_lock lock(mutex_);
+        done_.wait(lock, [this] { return !job_pending_; });
+
+        failed = job_failed_;
+        shadow_times_[frame_count_ % shadow_times_.size()] = std::chrono::duration<float, std::micro>(job_time_).count();
+    }
+
+    if (failed)
+        ++failures_;
+    else
+        emulator.get_ppu()->set_output(shadow_->get_ppu()->output());
+
+    const auto end = clock::now();
+    record_(frame_end - submitted, (submitted - start) + (end - frame_end));
+}
+
+void RunAhead::run_worker_()
+{
+    std::unique_lock lock(mutex_);
+
+    for (;;)
+    {
+        wake_.wait(lock, [this] { return job_pending_ || stopping_; });
+
+        if (stopping_)
+            return;
+
+        lock.unlock();
+
+        const auto start = clock::now();
+        bool failed = false;
+
+        try
+        {
+            if (shadow_->is_debugging())
+                shadow_->debugger_.resume();
+
+            shadow_->load_state(job_state_);
+
+            for (int i = 0; i < job_frames_ && !shadow_->is_debugging(); ++i)
+                shadow_->update();
+
+            failed = shadow_->is_debugging();
+        }
+        catch (const std::exception&)
+        {
+            failed = true;
+        }
+
+        const auto elapsed = clock::now() - start;
+
+        lock.lock();
+        job_failed_ = failed;
+        job_time_ = elapsed;
+        job_pending_ = false;
+        done_.notify_all();
+    }
+}
+
+void RunAhead::record_(clock::duration frame, clock::duration cost)
+{
+    const size_t slot = frame_count_ % frame_times_.size();
+    frame_times_[slot] = std::chrono::duration<float, std::micro>(frame).count();
+    cost_times_[slot] = std::chrono::duration<float, std::micro>(cost).count();
+
+    if (!shadow_)
+        shadow_times_[slot] = 0.f;
+
+    ++frame_count_;
+}
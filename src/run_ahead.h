@@ -0,0 +1,85 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Emulator;
+
+struct RunAheadStats
+{
+    int frames_ = 0;
+    bool shadow_ = false;
+    double frame_us_ = 0.0; // the real frame
+    double cost_us_ = 0.0; // added on the emulation thread by run-ahead
+    double shadow_us_ = 0.0; // spent on the shadow thread
+    uint64_t failures_ = 0; // speculations that threw, the real frame was shown instead
+};
+
+// Hides the game's own input lag: after each real frame, frames more are emulated with the
+// current input and that picture is shown, then the machine is rolled back with a save state.
+// In shadow mode a second Emulator on its own thread starts from the state at the start of the
+// frame and emulates frames + 1 while the real frame runs, so the emulation thread only pays
+// for a save state and a copy of the picture.
+class RunAhead
+{
+public:
+    explicit RunAhead(int frames = 0, bool shadow = false);
+    ~RunAhead();
+
+    RunAhead(const RunAhead&) = delete;
+    RunAhead& operator=(const RunAhead&) = delete;
+
+    // 0 disables run-ahead
+    void set_frames(int frames);
+    int get_frames() const { return frames_; }
+
+    void set_shadow(bool shadow);
+    bool is_shadow() const { return shadow_ != nullptr; }
+
+    // Replaces Emulator::update().
+    void update(Emulator& emulator);
+
+    // Means over the last frames
+    RunAheadStats get_stats() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    void update_inline_(Emulator& emulator);
+    void update_shadow_(Emulator& emulator);
+    void run_worker_();
+    void record_(clock::duration frame, clock::duration cost);
+
+    int frames_ = 0;
+
+    // Inline mode
+    std::vector<byte_t> state_;
+
+    // Shadow mode, the job fields are only touched by the worker between wake_ and done_
+    std::unique_ptr<Emulator> shadow_;
+    uint64_t shadow_rom_hash_ = 0;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::vector<byte_t> job_state_;
+    int job_frames_ = 0;
+    bool job_pending_ = false;
+    bool job_failed_ = false;
+    bool stopping_ = false;
+    clock::duration job_time_ {};
+
+    // rolling windows, in microseconds
+    std::array<float, 128> frame_times_ {};
+    std::array<float, 128> cost_times_ {};
+    std::array<float, 128> shadow_times_ {};
+    size_t frame_count_ = 0;
+    uint64_t failures_ = 0;
+};
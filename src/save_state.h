@@ -0,0 +1,90 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+constexpr uint32_t save_state_magic = 0x5353454E; // "NESS"
+
+// Bump on any change to what the components write in serialize_state.
+// 2: the ROM hash moved from FNV-1a to XXH64
+// 3: the controller latches (strobe count and latched buttons)
+constexpr uint16_t save_state_version = 3;
+
+struct SaveStateHeader
+{
+    uint32_t magic_ = save_state_magic;
+    uint16_t version_ = save_state_version;
+    uint16_t mapper_ = 0;
+    uint64_t rom_hash_ = 0; // the ROM data itself is not saved
+    uint64_t size_ = 0; // whole blob, header included
+};
+
+// Binary counterpart of Serializer for the machine state.
+// Components call process() on their fields in a fixed order, the same code reads and writes.
+// Values are copied as raw bytes, only trivially copyable types are accepted.
+class StateStream
+{
+public:
+    // Appends to the buffer
+    explicit StateStream(std::vector<byte_t>& buffer)
+        : out_(&buffer)
+    {
+    }
+
+    explicit StateStream(std::span<const byte_t> buffer)
+        : in_(buffer)
+    {
+    }
+
+    bool is_writing() const { return out_ != nullptr; }
+
+    // Reading past the end (or a bad value) fails the stream, values are then left untouched.
+    bool good() const { return good_; }
+    void fail() { good_ = false; }
+
+    size_t position() const { return out_ ? out_->size() : pos_; }
+
+    void process_raw(void* data, size_t size)
+    {
+        if (out_)
+        {
+            const size_t pos = out_->size();
+            out_->resize(pos + size);
+            std::memcpy(out_->data() + pos, data, size);
+        }
+        else if (good_ && size <= in_.size() - pos_)
+        {
+            std::memcpy(data, in_.data() + pos_, size);
+            pos_ += size;
+        }
+        else
+        {
+            good_ = false;
+        }
+    }
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void process(T& value)
+    {
+        process_raw(&value, sizeof(T));
+    }
+
+    template <typename T, size_t N>
+        requires std::is_trivially_copyable_v<T>
+    void process(std::span<T, N> values)
+    {
+        process_raw(values.data(), values.size_bytes());
+    }
+
+private:
+    std::vector<byte_t>* out_ = nullptr;
+    std::span<const byte_t> in_;
+    size_t pos_ = 0;
+    bool good_ = true;
+};
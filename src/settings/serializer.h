@@ -5,6 +5,7 @@
 #include <nlohmann/json.hpp>
 namespace nl = nlohmann;
 
+#include <optional>
 #include <span>
 #include <string_view>
 #include <string>
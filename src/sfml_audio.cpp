@@ -0,0 +1,41 @@
+#include "sfml_audio.h"
+
+#include <algorithm>
+
+// ~1/60th of a second per chunk, with 100ms of buffering for the ring.
+SFMLAudioSink::SFMLAudioSink(int sample_rate)
+    : AudioSink(sample_rate, sample_rate / 10)
+    , chunk_(sample_rate / 60)
+{
+    sf::SoundStream::initialize(1, sample_rate);
+}
+
+SFMLAudioSink::~SFMLAudioSink()
+{
+    stop();
+}
+
+void SFMLAudioSink::play()
+{
+    started_ = false;
+    sf::SoundStream::play();
+}
+
+void SFMLAudioSink::stop()
+{
+    sf::SoundStream::stop();
+}
+
+bool SFMLAudioSink::onGetData(Chunk& data)
+{
+    // Wait for a chunk worth of samples before starting, to avoid counting underruns on startup.
+    const bool count_underrun = started_;
+    const size_t count = pull(chunk_, count_underrun);
+    started_ = started_ || count == chunk_.size();
+
+    std::fill(chunk_.begin() + count, chunk_.end(), int16_t(0));
+
+    data.samples = chunk_.data();
+    data.sampleCount = chunk_.size();
+    return true;
+}
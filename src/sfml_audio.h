@@ -0,0 +1,26 @@
+#pragma once
+
+#include "audio_sink.h"
+
+#include <SFML/Audio.hpp>
+
+#include <vector>
+
+// Plays the emulator output on the default audio device.
+// SFML pulls from its own thread, an empty ring buffer is filled with silence.
+class SFMLAudioSink : public AudioSink, private sf::SoundStream
+{
+public:
+    SFMLAudioSink(int sample_rate = 44100);
+    ~SFMLAudioSink();
+
+    void play();
+    void stop();
+
+private:
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time) override {}
+
+    std::vector<int16_t> chunk_;
+    bool started_ = false;
+};
@@ -30,7 +30,7 @@ static void open_rom(Emulator& emulator)
     {
         try
         {
-            emulator.read_rom(filepath);
+            ui::load_rom(emulator, filepath);
         }
         catch (const std::exception& e)
         {
@@ -75,6 +75,11 @@ bool SFMLRenderer::update()
     return window_->isOpen();
 }
 
+void SFMLRenderer::set_vsync(bool enabled)
+{
+    window_->setVerticalSyncEnabled(enabled);
+}
+
 void SFMLRenderer::poll_events_()
 {
     sf::Event ev;
@@ -96,6 +101,7 @@ void SFMLRenderer::poll_events_()
             switch (ev.key.code)
             {
             case sf::Keyboard::P: emulator_->toggle_pause(); break;
+            case sf::Keyboard::Backspace: rewinding_ = true; break;
             case sf::Keyboard::O: if (ev.key.control) open_rom(*emulator_); break;
 
             case sf::Keyboard::Hyphen: step_rate_ = std::max(step_rate_ - 100, 100ll); break;
@@ -119,6 +125,9 @@ void SFMLRenderer::poll_events_()
 
         if (ev.type == sf::Event::KeyReleased)
         {
+            if (ev.key.code == sf::Keyboard::Backspace)
+                rewinding_ = false;
+
             for (Map m : g_mapping)
             {
                 if (ev.key.code == m.sfmlKey)
@@ -140,14 +149,14 @@ void SFMLRenderer::draw()
 
     draw_game(ppu);
 
-    ui::imgui_mainmenu();
-    ui::imgui_debugwindows();
+    ui::imgui_mainmenu(*emulator_);
+    ui::imgui_debugwindows(*emulator_);
 }
 
 void SFMLRenderer::draw_game(PPU const& ppu)
 {
     static GameViewport viewport;
-    viewport.update(ppu);
+    viewport.update(ppu, emulator_->is_debugging());
 
     static sf::Vector2f offset{0.f, 16.f};
     sf::Vector2f viewSize{256.f, 240.f};
@@ -21,6 +21,11 @@ public:
     
     bool update();
 
+    void set_vsync(bool enabled);
+
+    // Backspace is held
+    bool is_rewinding() const { return rewinding_; }
+
 private:
     void poll_events_();
 
@@ -35,4 +40,5 @@ private:
     sf::Time last_update_;
     std::unique_ptr<sf::RenderWindow> window_;
     sf::Int64 step_rate_ = 1000;
+    bool rewinding_ = false;
 };
\ No newline at end of file
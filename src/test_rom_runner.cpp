@@ -0,0 +1,340 @@
+#include "test_rom_runner.h"
+
+#include "emulator.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <ostream>
+#include <thread>
+
+namespace
+{
+    using clock = std::chrono::steady_clock;
+
+    constexpr address_t nestest_start = 0xC000;
+    constexpr address_t nestest_end = 0xC66E;
+
+    // blargg asks for the reset to be held at least 100ms after the request
+    constexpr uint64_t reset_delay_frames = 7;
+
+    class Deadline
+    {
+    public:
+        explicit Deadline(double seconds)
+            : end_(clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds)))
+        {
+        }
+
+        bool expired() const { return clock::now() >= end_; }
+
+    private:
+        clock::time_point end_;
+    };
+
+    std::string halted_message(const Emulator& emulator)
+    {
+        return fmt::format("CPU halted at ${:04X}", emulator.get_cpu()->get_state().program_counter_);
+    }
+
+    void run_nestest(Emulator& emulator, const TestRomConfig& config, TestRomResult& result)
+    {
+        emulator.get_cpu()->set_program_counter(nestest_start);
+
+        Breakpoint end;
+        end.break_value_ = nestest_end;
+        emulator.debugger_.breakpoints_.push_back(end);
+
+        const Deadline deadline(config.timeout_s_);
+        while (!emulator.is_debugging())
+        {
+            if (result.frames_ >= config.max_frames_ || deadline.expired())
+            {
+                result.status_ = TestRomStatus::Timeout;
+                result.message_ = "did not reach the end of the tests";
+                return;
+            }
+
+            emulator.update();
+            ++result.frames_;
+        }
+
+        const byte_t official = emulator.get_ram()->data()[0x02];
+        const byte_t unofficial = emulator.get_ram()->data()[0x03];
+        result.code_ = official << 8 | unofficial;
+
+        const std::string codes = fmt::format("official ${:02X}, unofficial ${:02X}", official, unofficial);
+
+        if (emulator.get_cpu()->get_state().program_counter_ != nestest_end)
+        {
+            result.status_ = TestRomStatus::Error;
+            result.message_ = fmt::format("{} ({})", halted_message(emulator), codes);
+        }
+        else
+        {
+            result.status_ = result.code_ == 0 ? TestRomStatus::Passed : TestRomStatus::Failed;
+            result.message_ = codes;
+        }
+    }
+
+    std::string read_blargg_text(const BUS& bus)
+    {
+        std::string text;
+        for (address_t addr = 0x6004; addr < 0x8000; ++addr)
+        {
+            const char c = static_cast<char>(bus.read_cpu(addr));
+            if (c == '\0')
+                break;
+
+            // One line for the summary
+            if (c == '\n')
+            {
+                if (!text.empty() && text.back() != ' ')
+                    text += ' ';
+            }
+            else
+            {
+                text += c;
+            }
+        }
+
+        while (!text.empty() && text.back() == ' ')
+            text.pop_back();
+
+        return text;
+    }
+
+    void run_blargg(Emulator& emulator, const TestRomConfig& config, TestRomResult& result)
+    {
+        const BUS& bus = *emulator.get_bus();
+
+        bool signature = false;
+        uint64_t reset_frame = 0;
+        uint64_t last_reset = 0;
+
+        const Deadline deadline(config.timeout_s_);
+        while (result.frames_ < config.max_frames_ && !deadline.expired())
+        {
+            emulator.update();
+            ++result.frames_;
+
+            if (emulator.is_debugging())
+            {
+                result.status_ = TestRomStatus::Error;
+                result.message_ = halted_message(emulator);
+                return;
+            }
+
+            if (reset_frame != 0 && result.frames_ >= reset_frame)
+            {
+                emulator.reset();
+                reset_frame = 0;
+                last_reset = result.frames_;
+                continue;
+            }
+
+            signature = signature || (bus.read_cpu(0x6001) == 0xDE && bus.read_cpu(0x6002) == 0xB0 && bus.read_cpu(0x6003) == 0x61);
+            if (!signature)
+                continue;
+
+            const byte_t status = bus.read_cpu(0x6000);
+            if (status == 0x80)
+                continue;
+
+            if (status == 0x81)
+            {
+                // Still set right after the reset, until the ROM runs again
+                if (reset_frame == 0 && result.frames_ > last_reset + 1)
+                    reset_frame = result.frames_ + reset_delay_frames;
+                continue;
+            }
+
+            result.code_ = status;
+            result.status_ = status == 0 ? TestRomStatus::Passed : TestRomStatus::Failed;
+            result.message_ = read_blargg_text(bus);
+            if (status != 0)
+                result.message_ = fmt::format("#{} {}", status, result.message_);
+            return;
+        }
+
+        result.status_ = TestRomStatus::Timeout;
+        result.message_ = signature ? read_blargg_text(bus) : "no result in $6000";
+    }
+
+    std::string display_name(const stdfs::path& rom)
+    {
+        return (rom.parent_path().filename() / rom.filename()).generic_string();
+    }
+
+    std::string xml_escape(std::string_view text)
+    {
+        std::string out;
+        for (char c : text)
+        {
+            switch (c)
+            {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            case '\'': out += "&apos;"; break;
+            default:
+                // Control characters are not allowed in XML 1.0
+                if (static_cast<unsigned char>(c) >= 0x20)
+                    out += c;
+                break;
+            }
+        }
+        return out;
+    }
+}
+
+TestRomRunner::TestRomRunner(const TestRomConfig& config)
+    : config_(config)
+{
+}
+
+std::vector<TestRomResult> TestRomRunner::run(std::span<const stdfs::path> roms) const
+{
+    std::vector<TestRomResult> results(roms.size());
+
+    size_t threads = config_.threads_ ? config_.threads_ : std::thread::hardware_concurrency();
+    threads = std::clamp<size_t>(threads, 1, std::max<size_t>(roms.size(), 1));
+
+    // The ROMs are picked in order by whichever thread is free
+    std::atomic<size_t> next = 0;
+    auto work = [&]
+    {
+        for (size_t idx = next++; idx < roms.size(); idx = next++)
+            results[idx] = run_one(roms[idx]);
+    };
+
+    std::vector<std::jthread> workers;
+    for (size_t i = 1; i < threads; ++i)
+        workers.emplace_back(work);
+
+    work();
+    return results;
+}
+
+TestRomResult TestRomRunner::run_one(const stdfs::path& rom) const
+{
+    const auto start = clock::now();
+
+    TestRomResult result;
+    result.rom_ = rom;
+
+    try
+    {
+        Emulator emulator;
+        emulator.set_verbose(false);
+        emulator.set_host_break(false);
+        emulator.read_rom(rom.wstring());
+
+        if (rom.filename() == "nestest.nes")
+            run_nestest(emulator, config_, result);
+        else
+            run_blargg(emulator, config_, result);
+    }
+    catch (const std::exception& e)
+    {
+        result.status_ = TestRomStatus::Error;
+        result.message_ = e.what();
+    }
+
+    result.elapsed_ms_ = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    return result;
+}
+
+std::vector<stdfs::path> TestRomRunner::find_roms(const stdfs::path& dir)
+{
+    std::vector<stdfs::path> roms;
+    for (const auto& entry : stdfs::recursive_directory_iterator(dir))
+    {
+        std::string ext = entry.path().extension().string();
+        std::ranges::transform(ext, ext.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (entry.is_regular_file() && ext == ".nes")
+            roms.push_back(entry.path());
+    }
+
+    std::ranges::sort(roms);
+    return roms;
+}
+
+std::string_view TestRomRunner::status_name(TestRomStatus status)
+{
+    switch (status)
+    {
+    case TestRomStatus::Passed: return "PASS";
+    case TestRomStatus::Failed: return "FAIL";
+    case TestRomStatus::Timeout: return "TIMEOUT";
+    case TestRomStatus::Error: return "ERROR";
+    }
+
+    return "?";
+}
+
+void TestRomRunner::print_summary(std::ostream& os, std::span<const TestRomResult> results)
+{
+    size_t width = 3;
+    for (const TestRomResult& result : results)
+        width = std::max(width, display_name(result.rom_).size());
+
+    os << fmt::format("{:<8} {:<{}} {:>7} {:>9}  {}\n", "STATUS", "ROM", width, "FRAMES", "MS", "MESSAGE");
+
+    std::array<size_t, 4> counts {};
+    for (const TestRomResult& result : results)
+    {
+        ++counts[static_cast<size_t>(result.status_)];
+        os << fmt::format("{:<8} {:<{}} {:>7} {:>9.1f}  {}\n",
+            status_name(result.status_), display_name(result.rom_), width, result.frames_, result.elapsed_ms_, result.message_);
+    }
+
+    os << fmt::format("\n{} passed, {} failed, {} timed out, {} errors\n",
+        counts[static_cast<size_t>(TestRomStatus::Passed)],
+        counts[static_cast<size_t>(TestRomStatus::Failed)],
+        counts[static_cast<size_t>(TestRomStatus::Timeout)],
+        counts[static_cast<size_t>(TestRomStatus::Error)]);
+}
+
+// Failed and timed out ROMs are failures, ROMs that could not run are errors.
+void TestRomRunner::write_junit(std::ostream& os, std::span<const TestRomResult> results, std::string_view suite_name)
+{
+    size_t failures = 0;
+    size_t errors = 0;
+    double total_ms = 0.0;
+
+    for (const TestRomResult& result : results)
+    {
+        failures += (result.status_ == TestRomStatus::Failed || result.status_ == TestRomStatus::Timeout) ? 1 : 0;
+        errors += result.status_ == TestRomStatus::Error ? 1 : 0;
+        total_ms += result.elapsed_ms_;
+    }
+
+    os << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    os << fmt::format("<testsuite name=\"{}\" tests=\"{}\" failures=\"{}\" errors=\"{}\" time=\"{:.3f}\">\n",
+        xml_escape(suite_name), results.size(), failures, errors, total_ms / 1000.0);
+
+    for (const TestRomResult& result : results)
+    {
+        os << fmt::format("  <testcase classname=\"{}\" name=\"{}\" time=\"{:.3f}\"",
+            xml_escape(result.rom_.parent_path().filename().string()), xml_escape(result.rom_.stem().string()), result.elapsed_ms_ / 1000.0);
+
+        if (result.status_ == TestRomStatus::Passed)
+        {
+            os << "/>\n";
+            continue;
+        }
+
+        const char* tag = result.status_ == TestRomStatus::Error ? "error" : "failure";
+        os << fmt::format(">\n    <{} type=\"{}\" message=\"{}\"/>\n  </testcase>\n",
+            tag, status_name(result.status_), xml_escape(result.message_));
+    }
+
+    os << "</testsuite>\n";
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+enum class TestRomStatus : byte_t
+{
+    Passed,
+    Failed,  // the ROM reported a failure
+    Timeout, // no result within the frame or time budget
+    Error,   // could not load, or the CPU halted
+};
+
+struct TestRomResult
+{
+    stdfs::path rom_;
+    TestRomStatus status_ = TestRomStatus::Error;
+    int code_ = -1; // result code reported by the ROM
+    std::string message_;
+    uint64_t frames_ = 0;
+    double elapsed_ms_ = 0.0;
+};
+
+struct TestRomConfig
+{
+    uint64_t max_frames_ = 60 * 60; // emulated time
+    double timeout_s_ = 60.0; // wall clock, per ROM
+    size_t threads_ = 0; // 0 for hardware concurrency
+};
+
+// Runs accuracy test ROMs headlessly and reads their verdict.
+// - nestest.nes: automation mode from $C000, until the final RTS at $C66E; $02 and $03 hold
+//   the official and unofficial opcode error codes.
+// - blargg: once $6001-$6003 hold DE B0 61, $6000 is the status (0x80 running, 0x81 reset
+//   requested, below that the result code) and $6004 a zero terminated message.
+class TestRomRunner
+{
+public:
+    explicit TestRomRunner(const TestRomConfig& config = {});
+
+    // One ROM per task, results in the same order.
+    std::vector<TestRomResult> run(std::span<const stdfs::path> roms) const;
+
+    TestRomResult run_one(const stdfs::path& rom) const;
+
+    // .nes files under the directory, sorted
+    static std::vector<stdfs::path> find_roms(const stdfs::path& dir);
+
+    static std::string_view status_name(TestRomStatus status);
+
+    static void print_summary(std::ostream& os, std::span<const TestRomResult> results);
+    static void write_junit(std::ostream& os, std::span<const TestRomResult> results, std::string_view suite_name);
+
+private:
+    TestRomConfig config_;
+};
@@ -0,0 +1,228 @@
+#include "trace_diff.h"
+
+#include <fmt/format.h>
+
+#include <charconv>
+#include <istream>
+#include <ostream>
+
+namespace
+{
+    template <typename T>
+    bool parse_hex(std::string_view sv, T& value)
+    {
+        auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value, 16);
+        return ec == std::errc{} && ptr == sv.data() + sv.size();
+    }
+
+    bool is_hex_byte(std::string_view token)
+    {
+        byte_t value;
+        return token.size() == 2 && parse_hex(token, value);
+    }
+
+    // The hex value after " KEY:", nestest pads the numbers it does not write in hex
+    template <typename T>
+    bool find_field(std::string_view line, std::string_view key, T& value, int base = 16)
+    {
+        const std::string key_str = fmt::format(" {}:", key);
+        const size_t pos = line.find(key_str);
+        if (pos == std::string_view::npos)
+            return false;
+
+        std::string_view rest = line.substr(pos + key_str.size());
+        rest = rest.substr(0, rest.find(' '));
+
+        auto [ptr, ec] = std::from_chars(rest.data(), rest.data() + rest.size(), value, base);
+        return ec == std::errc{} && ptr == rest.data() + rest.size();
+    }
+
+    std::string_view next_token(std::string_view& sv)
+    {
+        const size_t start = sv.find_first_not_of(' ');
+        if (start == std::string_view::npos)
+        {
+            sv = {};
+            return {};
+        }
+
+        sv.remove_prefix(start);
+        const size_t end = std::min(sv.find(' '), sv.size());
+        const std::string_view token = sv.substr(0, end);
+        sv.remove_prefix(end);
+        return token;
+    }
+
+    std::string hex_bytes(const TraceRecord& record)
+    {
+        std::string out;
+        for (byte_t i = 0; i < record.size_; ++i)
+            out += fmt::format("{}{:02X}", i ? " " : "", record.bytes_[i]);
+        return out;
+    }
+}
+
+bool TraceRecord::parse(std::string_view line, TraceRecord& record)
+{
+    record = {};
+
+    std::string_view rest = line;
+    if (!parse_hex(next_token(rest), record.pc_))
+        return false;
+
+    // Up to 3 opcode bytes, the mnemonic is never two characters long
+    std::string_view probe = rest;
+    for (std::string_view token = next_token(probe); record.size_ < 3 && is_hex_byte(token); token = next_token(probe))
+    {
+        parse_hex(token, record.bytes_[record.size_++]);
+        rest = probe;
+    }
+
+    if (record.size_ == 0)
+        return false;
+
+    if (!find_field(line, "A", record.a_) || !find_field(line, "X", record.x_) || !find_field(line, "Y", record.y_) ||
+        !find_field(line, "P", record.p_) || !find_field(line, "SP", record.sp_))
+        return false;
+
+    uint64_t cycle = 0;
+    if (find_field(line, "CYC", cycle, 10))
+        record.cycle_ = cycle;
+
+    return true;
+}
+
+TraceDiff::TraceDiff(std::istream& reference, size_t context)
+    : reference_(reference)
+    , context_(context)
+{
+}
+
+void TraceDiff::on_instruction(std::string_view line)
+{
+    if (stopped_)
+        return;
+
+    std::string expected_line;
+    TraceRecord expected;
+    if (!next_reference_(expected_line, expected))
+    {
+        stop_();
+        return;
+    }
+
+    TraceRecord actual;
+    if (!TraceRecord::parse(line, actual))
+    {
+        diverge_("format", "", std::string(line), std::move(expected_line), line);
+        return;
+    }
+
+    auto check = [&](std::string_view field, auto expected_value, auto actual_value, std::string_view fmt_spec)
+    {
+        if (expected_value == actual_value)
+            return true;
+
+        diverge_(field, fmt::format(fmt::runtime(fmt_spec), expected_value), fmt::format(fmt::runtime(fmt_spec), actual_value), expected_line, line);
+        return false;
+    };
+
+    const bool same_bytes = expected.size_ == actual.size_ &&
+        std::equal(expected.bytes_.begin(), expected.bytes_.begin() + expected.size_, actual.bytes_.begin());
+
+    if (!check("PC", expected.pc_, actual.pc_, "{:04X}"))
+        return;
+
+    if (!same_bytes)
+    {
+        diverge_("opcode", hex_bytes(expected), hex_bytes(actual), expected_line, line);
+        return;
+    }
+
+    if (!check("A", expected.a_, actual.a_, "{:02X}") || !check("X", expected.x_, actual.x_, "{:02X}") ||
+        !check("Y", expected.y_, actual.y_, "{:02X}") || !check("P", expected.p_, actual.p_, "{:02X}") ||
+        !check("SP", expected.sp_, actual.sp_, "{:02X}"))
+        return;
+
+    if (expected.cycle_ && actual.cycle_)
+    {
+        const int64_t offset = static_cast<int64_t>(*expected.cycle_) - static_cast<int64_t>(*actual.cycle_);
+        if (!cycle_offset_)
+            cycle_offset_ = offset;
+
+        if (!check("CYC", *expected.cycle_, *actual.cycle_ + *cycle_offset_, "{}"))
+            return;
+    }
+
+    ++matched_;
+
+    history_.emplace_back(std::move(expected_line), std::string(line));
+    if (history_.size() > context_)
+        history_.pop_front();
+}
+
+void TraceDiff::print_report(std::ostream& os) const
+{
+    if (!divergence_)
+    {
+        os << fmt::format("trace matches the reference over {} lines{}\n", matched_, stopped_ ? "" : " so far");
+        return;
+    }
+
+    const TraceDivergence& d = *divergence_;
+    os << fmt::format("trace diverges at reference line {}: {} expected {}, got {}\n\n", d.line_, d.field_, d.expected_, d.actual_);
+
+    for (const auto& [expected, actual] : d.before_)
+        os << fmt::format("    {}\n", expected);
+
+    os << fmt::format("  - {}\n  + {}\n", d.expected_line_, d.actual_line_);
+
+    for (const std::string& expected : d.after_)
+        os << fmt::format("    {}\n", expected);
+}
+
+// Lines that don't parse (headers, blanks) are skipped
+bool TraceDiff::next_reference_(std::string& line, TraceRecord& record)
+{
+    while (std::getline(reference_, line))
+    {
+        ++line_;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (TraceRecord::parse(line, record))
+            return true;
+    }
+
+    return false;
+}
+
+void TraceDiff::diverge_(std::string_view field, std::string expected, std::string actual, std::string reference, std::string_view line)
+{
+    TraceDivergence d;
+    d.line_ = line_;
+    d.field_ = field;
+    d.expected_ = std::move(expected);
+    d.actual_ = std::move(actual);
+    d.expected_line_ = std::move(reference);
+    d.actual_line_ = line;
+    d.before_.assign(history_.begin(), history_.end());
+
+    std::string next;
+    for (size_t i = 0; i < context_ / 2 && std::getline(reference_, next); ++i)
+    {
+        if (!next.empty() && next.back() == '\r')
+            next.pop_back();
+        d.after_.push_back(next);
+    }
+
+    divergence_ = std::move(d);
+    stop_();
+}
+
+void TraceDiff::stop_()
+{
+    stopped_ = true;
+    if (on_stop_)
+        on_stop_();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "types.h"
+#include "cpu.h"
+
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Fields of one trace line, from nestest.log or CPU::log_.
+struct TraceRecord
+{
+    address_t pc_ = 0;
+    std::array<byte_t, 3> bytes_ {};
+    byte_t size_ = 0;
+    byte_t a_ = 0;
+    byte_t x_ = 0;
+    byte_t y_ = 0;
+    byte_t p_ = 0;
+    byte_t sp_ = 0;
+    std::optional<uint64_t> cycle_;
+
+    // False when the line does not start with a PC and carry the registers
+    static bool parse(std::string_view line, TraceRecord& record);
+};
+
+struct TraceDivergence
+{
+    uint64_t line_ = 0; // 1-based, in the reference
+    std::string field_;
+    std::string expected_;
+    std::string actual_;
+    std::string expected_line_;
+    std::string actual_line_;
+
+    // Matching lines before the divergence (reference, trace), and the reference lines after it
+    std::vector<std::pair<std::string, std::string>> before_;
+    std::vector<std::string> after_;
+};
+
+// Compares the CPU trace against a reference log one line at a time, neither trace is kept
+// beyond the context window. Opcode bytes and registers must match exactly, cycles must keep
+// the offset they had on the first line (the reset cycle count differs between emulators).
+// The disassembly text is not compared.
+class TraceDiff final : public CpuTracer
+{
+public:
+    explicit TraceDiff(std::istream& reference, size_t context = 8);
+
+    void on_instruction(std::string_view line) override;
+
+    // Called once, on the divergence or at the end of the reference; typically breaks the emulation.
+    void set_on_stop(std::function<void()> on_stop) { on_stop_ = std::move(on_stop); }
+
+    bool is_stopped() const { return stopped_; }
+    bool has_diverged() const { return divergence_.has_value(); }
+    const std::optional<TraceDivergence>& divergence() const { return divergence_; }
+
+    uint64_t matched_lines() const { return matched_; }
+
+    void print_report(std::ostream& os) const;
+
+private:
+    bool next_reference_(std::string& line, TraceRecord& record);
+    void diverge_(std::string_view field, std::string expected, std::string actual, std::string reference, std::string_view line);
+    void stop_();
+
+    std::istream& reference_;
+    size_t context_;
+
+    uint64_t line_ = 0;
+    uint64_t matched_ = 0;
+    std::optional<int64_t> cycle_offset_;
+
+    std::deque<std::pair<std::string, std::string>> history_;
+    std::optional<TraceDivergence> divergence_;
+    std::function<void()> on_stop_;
+    bool stopped_ = false;
+};
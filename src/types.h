@@ -28,12 +28,12 @@ inline constexpr address_t operator "" _addr(unsigned long long v)
 }
 
 template <std::unsigned_integral T>
-struct register_t
+struct reg_t
 {
     using base_t = T;
 
-    register_t() { set(base_t{}); }
-    register_t(base_t value) { set(value); }
+    reg_t() { set(base_t{}); }
+    reg_t(base_t value) { set(value); }
 
     base_t get() const { return *reinterpret_cast<base_t const*>(this); }
     void set(base_t value) { memcpy(this, &value, sizeof(base_t)); }
@@ -44,12 +44,12 @@ struct register_t
     void set_h(byte_t value) { static_assert(sizeof(base_t) > 1); set((int_cast<base_t>(value) << 8) | (get() & 0xFF)); }
     void set_l(byte_t value) { set((get() & 0xFF00) | int_cast<base_t>(value) & 0xFF); }
 
-    register_t& operator=(base_t value) { set(value); return *this; }
-    register_t& operator+=(base_t value) { set(get() + value); return *this; }
-    register_t& operator-=(base_t value) { set(get() - value); return *this; }
-    register_t& operator&=(base_t value) { set(get() & value); return *this; }
-    register_t& operator|=(base_t value) { set(get() | value); return *this; }
-    register_t& operator^=(base_t value) { set(get() ^ value); return *this; }
+    reg_t& operator=(base_t value) { set(value); return *this; }
+    reg_t& operator+=(base_t value) { set(get() + value); return *this; }
+    reg_t& operator-=(base_t value) { set(get() - value); return *this; }
+    reg_t& operator&=(base_t value) { set(get() & value); return *this; }
+    reg_t& operator|=(base_t value) { set(get() | value); return *this; }
+    reg_t& operator^=(base_t value) { set(get() ^ value); return *this; }
 };
 
 enum class NT_Mirroring : byte_t
@@ -1,6 +1,5 @@
 #include "game_viewport.h"
 
-#include "emulator.h"
 #include "ppu.h"
 
 constexpr int line_buf_size = 256 * 4;
@@ -22,12 +21,11 @@ GameViewport::GameViewport()
     setTexture(&texture_, true);
 }
 
-void GameViewport::update(PPU const& ppu)
+void GameViewport::update(PPU const& ppu, bool show_scanline)
 {
     texture_.update(ppu.output().data());
 
-    Emulator* emulator = Emulator::instance();
-    if (emulator->is_debugging())
+    if (show_scanline)
     {
         auto scanline = ppu.get_state().scanline_;
         if (scanline >= 0 && scanline < 240)
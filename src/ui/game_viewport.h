@@ -8,7 +8,7 @@ class GameViewport : public sf::RectangleShape
 {
 public:
     GameViewport();
-    void update(PPU const& ppu);
+    void update(PPU const& ppu, bool show_scanline);
 
 private:
     sf::Texture texture_;
@@ -1,5 +1,6 @@
 #include "global.h"
 
+#include "emulator.h"
 #include "imgui.h"
 #include "imgui_cpu.h"
 #include "imgui_ppu.h"
@@ -83,6 +84,12 @@ std::optional<ui::RecentFile> ui::get_recent_file(int idx)
     return rf;
 }
 
+void ui::load_rom(Emulator& emulator, std::wstring_view path)
+{
+    emulator.read_rom(path);
+    ui::push_recent_file(path);
+}
+
 void ui::push_recent_file(std::wstring_view path)
 {
     auto& recent_files = Globals::get().recent_files_;
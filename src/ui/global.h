@@ -8,6 +8,7 @@
 #include <string>
 #include <optional>
 
+class Emulator;
 class Serializer;
 
 namespace ui
@@ -47,4 +48,7 @@ namespace ui
 
     std::optional<RecentFile> get_recent_file(int idx);
     void push_recent_file(std::wstring_view path);
+
+    // Loads a ROM and adds it to the recent files, throws on failure.
+    void load_rom(Emulator& emulator, std::wstring_view path);
 }
\ No newline at end of file
@@ -25,7 +25,7 @@ void open_rom_dialog(Emulator& emulator)
     {
         try
         {
-            emulator.read_rom(filepath);
+            ui::load_rom(emulator, filepath);
         }
         catch (const std::exception& e)
         {
@@ -46,10 +46,9 @@ std::string ws2s(std::wstring_view ws)
     return s;
 }
 
-void ui::imgui_mainmenu()
+void ui::imgui_mainmenu(Emulator& emulator)
 {
-    Emulator& emulator = *Emulator::instance();
-    
+
     if (imgui::BeginMainMenuBar())
     {
         if (imgui::BeginMenu("Emulation"))
@@ -63,7 +62,7 @@ void ui::imgui_mainmenu()
             if (imgui::BeginMenu("Recent"))
             {
                 if (recent_file.has_value() && imgui::MenuItem(ws2s(recent_file.value().basename_).c_str()))
-                    emulator.read_rom(stdfs::path(recent_file.value().fullpath_).wstring());
+                    ui::load_rom(emulator, stdfs::path(recent_file.value().fullpath_).wstring());
 
                 for (int i = 1; i < 5; ++i)
                 {
@@ -73,7 +72,7 @@ void ui::imgui_mainmenu()
                         break;
 
                     if (imgui::MenuItem(ws2s(recent_file.value().basename_).c_str()))
-                        emulator.read_rom(stdfs::path(recent_file.value().fullpath_).wstring());
+                        ui::load_rom(emulator, stdfs::path(recent_file.value().fullpath_).wstring());
                 }
 
                 imgui::EndMenu();
@@ -111,22 +110,21 @@ void ui::imgui_mainmenu()
 
         // Status information (right-side)
         FPSCounter& counter = Globals::get().fps_counter_;
-        auto mode_str = []
+        auto mode_str = [&emulator]
         {
-            Emulator* emulator = Emulator::instance();
-            if (emulator->is_paused())
+            if (emulator.is_paused())
                 return "PAUSED";
 
-            if (emulator->is_debugging())
+            if (emulator.is_debugging())
                 return "BREAK";
 
-            if (emulator->is_ready())
+            if (emulator.is_ready())
                 return "RUN";
 
             return "IDLE";
         };
 
-        std::string status_text = fmt::format("{} | {} FPS", mode_str(), counter.get_ppu_fps());
+        std::string status_text = fmt::format("{} | {} FPS", mode_str(), counter.get_ppu_fps(*emulator.get_ppu()));
         float text_width = imgui::CalcTextSize(status_text.c_str()).x;
 
         imgui::SameLine(imgui::GetWindowWidth() - text_width - 20.f);
@@ -136,10 +134,10 @@ void ui::imgui_mainmenu()
     }
 }
 
-void ui::imgui_debugwindows()
+void ui::imgui_debugwindows(Emulator& emulator)
 {
-    imgui_cpu_window();
-    imgui_ppu_window();
+    imgui_cpu_window(emulator);
+    imgui_ppu_window(emulator);
 
     if (imgui_examples)
         imgui::ShowDemoWindow();
@@ -14,8 +14,10 @@ namespace imgui
     }
 }
 
+class Emulator;
+
 namespace ui
 {
-    void imgui_mainmenu();
-    void imgui_debugwindows();
+    void imgui_mainmenu(Emulator& emulator);
+    void imgui_debugwindows(Emulator& emulator);
 }
\ No newline at end of file
@@ -12,10 +12,10 @@
 
 static ui::CPUData& globals() { return *ui::Globals::get().cpu_data_; }
 
-void cpu_tab();
-void ram_tab();
+void cpu_tab(Emulator& emulator);
+void ram_tab(Emulator& emulator);
 
-void ui::imgui_cpu_window()
+void ui::imgui_cpu_window(Emulator& emulator)
 {
     using namespace imgui;
 
@@ -28,13 +28,13 @@ void ui::imgui_cpu_window()
         {
             if (BeginTabItem("CPU"))
             {
-                cpu_tab();
+                cpu_tab(emulator);
                 EndTabItem();
             }
 
             if (BeginTabItem("RAM"))
             {
-                ram_tab();
+                ram_tab(emulator);
                 EndTabItem();
             }
 
@@ -45,16 +45,15 @@ void ui::imgui_cpu_window()
     }
 }
 
-void cpu_tab()
+void cpu_tab(Emulator& emulator)
 {
     using namespace imgui;
 
     if (BeginChild("-"))
     {
-        Emulator& emulator = *Emulator::instance();
         const BUS& bus = *emulator.get_bus();
 
-        ui::imgui_debugger();
+        ui::imgui_debugger(emulator);
 
         if (CollapsingHeader("Timings & VRAM", ImGuiTreeNodeFlags_DefaultOpen))
         {
@@ -83,6 +82,37 @@ void cpu_tab()
 
             TextFmt("VRAM N:{} X:{} Y:{} x:{} y:{}\n", N, X, Y, x, y);
             NewLine();
+
+            bool instrumented = emulator.is_instrumented();
+            if (Checkbox("Subsystem timings", &instrumented))
+                emulator.set_instrumented(instrumented);
+
+            if (instrumented)
+            {
+                const Instrumentation& timings = emulator.get_instrumentation();
+                const FrameCounters& last = timings.last_frame();
+                const int offset = static_cast<int>(timings.history_offset());
+                const ImVec2 size(0.0f, 40.0f);
+
+                const std::string frame_label = fmt::format("frame {:.2f} ms", last.frame_ns_ / 1e6);
+                PlotLines("##frame", timings.frame_history().data(), Instrumentation::history_size, offset, frame_label.c_str(), 0.0f, FLT_MAX, size);
+
+                for (size_t i = 0; i < subsystem_count; ++i)
+                {
+                    const auto subsystem = static_cast<Subsystem>(i);
+                    const std::string label = fmt::format("{} {:.2f} ms, {} calls", subsystem_name(subsystem), last.ns_[i] / 1e6, last.calls_[i]);
+
+                    PushID(static_cast<int>(i));
+                    PlotLines("##subsystem", timings.history(subsystem).data(), Instrumentation::history_size, offset, label.c_str(), 0.0f, FLT_MAX, size);
+                    PopID();
+                }
+
+                for (size_t region = 0; region < BusCounters::region_count; ++region)
+                    TextFmt("{:<5} reads {:>6} writes {:>6}", BusCounters::region_name(region), last.bus_.reads_[region], last.bus_.writes_[region]);
+
+                TextFmt("Bank switches: {}   Debugger hooks: {}", last.bank_switches_, last.debugger_hooks_);
+                NewLine();
+            }
         }
 
         if (CollapsingHeader("Test outputs"))
@@ -117,11 +147,11 @@ void cpu_tab()
     }
 }
 
-void ram_tab()
+void ram_tab(Emulator& emulator)
 {
     if (ImGui::BeginChild("-"))
     {
-        ui::imgui_mem_view();
+        ui::imgui_mem_view(emulator);
         ImGui::EndChild();
     }
 }
\ No newline at end of file
@@ -8,7 +8,9 @@ namespace ui
     };
 }
 
+class Emulator;
+
 namespace ui
 {
-    void imgui_cpu_window();
+    void imgui_cpu_window(Emulator& emulator);
 }
\ No newline at end of file
@@ -2,14 +2,22 @@
 #include "ui/imgui.h"
 
 #include "emulator.h"
+#include "call_profiler.h"
 #include "cartridge.h"
 #include "cpu.h"
+#include "hotspot_profiler.h"
 #include "ops.h"
 
 #include "types.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
 #include <ranges>
+#include <span>
+#include <vector>
 
 struct PrgModel
 {
@@ -31,15 +39,13 @@ struct PrgModel
         ops_.fill({ nullptr, 0, 0 });
     }
 
-    void reset(const BUS& bus, int prg_idx)
+    void reset(const BUS& bus, const Disassembler& disassembler, int prg_idx)
     {
         clear();
 
         if (bus.cart_ == nullptr)
             return;
 
-        Disassembler& disassembler = Emulator::instance()->disassembler_;
-
         if (prg_idx == 0)
         {
             const MemoryMap& prg_map = bus.cart_->get_mapped_prg();
@@ -116,20 +122,12 @@ struct PrgModel
 
     int size() const
     {
-        return std::ranges::fold_left(ops_, 0, [](int init, const OpRange& rhs) { return init + rhs.size_; });
+        return std::accumulate(ops_.begin(), ops_.end(), 0, [](int init, const OpRange& rhs) { return init + rhs.size_; });
     }
 
     Op get_op(int idx)
     {
-        int idx_bank = 0;
-
-        while (idx > ops_[idx_bank].size_)
-        {
-            idx -= ops_[idx_bank].size_;
-            idx_bank++;
-        }
-
-        const OpRange& range = ops_[idx_bank];
+        const OpRange& range = get_range_(idx);
         const PrgBank* decoded_bank = range.decoded_bank_;
 
         Op op = decoded_bank->ops_[range.first_idx_ + idx];
@@ -138,6 +136,15 @@ struct PrgModel
         return op;
     }
 
+    // The PRG ROM byte the op was decoded from
+    const byte_t* get_rom(int idx)
+    {
+        const OpRange& range = get_range_(idx);
+        const PrgBank* decoded_bank = range.decoded_bank_;
+
+        return decoded_bank->rom_ + decoded_bank->ops_[range.first_idx_ + idx].addr_;
+    }
+
     int get_idx(address_t addr)
     {
         for (int i = 0; i < ops_.size(); ++i)
@@ -153,6 +160,21 @@ struct PrgModel
 
 
     void* cart_check = nullptr;
+
+private:
+    // idx becomes the index in the range
+    const OpRange& get_range_(int& idx) const
+    {
+        int idx_bank = 0;
+
+        while (idx > ops_[idx_bank].size_)
+        {
+            idx -= ops_[idx_bank].size_;
+            idx_bank++;
+        }
+
+        return ops_[idx_bank];
+    }
 };
 
 std::string cpu_flags_str(byte_t state_flags)
@@ -302,21 +324,214 @@ void breakpoints(Debugger& debugger)
     }
 }
 
-void ui::imgui_debugger()
+// Faint orange to red, on a log scale: a hot loop takes most of the cycles and the
+// code around it would not show on a linear one
+ImU32 heat_color(uint64_t cycles, uint64_t max_cycles)
+{
+    const float heat = max_cycles > 1 ? std::log(static_cast<float>(cycles)) / std::log(static_cast<float>(max_cycles)) : 1.f;
+    return ImGui::GetColorU32(ImVec4(1.f, 0.6f * (1.f - heat), 0.f, 0.15f + 0.45f * heat));
+}
+
+void hotspot_tooltip(const HotSpot& spot, uint64_t total_cycles)
+{
+    using namespace imgui;
+
+    if (!IsItemHovered(ImGuiHoveredFlags_ForTooltip))
+        return;
+
+    BeginTooltip();
+    TextFmt("Cycles: {} ({:.2f}%)", spot.cycles_, 100.0 * spot.cycles_ / total_cycles);
+    TextFmt("Executed: {}", spot.count_);
+    if (spot.count_ > 0)
+        TextFmt("Cycles per execution: {:.2f}", static_cast<double>(spot.cycles_) / spot.count_);
+    EndTooltip();
+}
+
+void hotspots(Emulator& emulator, std::span<const HotSpot> top)
+{
+    using namespace imgui;
+    const float textHeight = GetTextLineHeightWithSpacing();
+
+    HotspotProfiler& profiler = emulator.get_profiler();
+
+    BeginDisabled(!emulator.is_ready());
+
+    bool profiling = emulator.is_profiling();
+    if (Checkbox("Profile cycles", &profiling))
+        emulator.set_profiling(profiling);
+
+    SameLine();
+    if (Button("Clear"))
+        profiler.clear();
+
+    EndDisabled();
+
+    const uint64_t total_cycles = profiler.total_cycles();
+    TextFmt("Cycles: {}, DMA: {}", total_cycles, profiler.dma_cycles());
+
+    if (top.empty())
+        return;
+
+    static constexpr ImGuiTableFlags table_flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+
+    if (BeginTable("hotspots", 5, table_flags, ImVec2(0.f, textHeight * 12)))
+    {
+        TableSetupScrollFreeze(0, 1);
+        TableSetupColumn("Address");
+        TableSetupColumn("Bank");
+        TableSetupColumn("Cycles");
+        TableSetupColumn("%");
+        TableSetupColumn("Executed");
+        TableHeadersRow();
+
+        for (const HotSpot& spot : top)
+        {
+            TableNextRow();
+            TableSetBgColor(ImGuiTableBgTarget_RowBg1, heat_color(spot.cycles_, top.front().cycles_));
+
+            TableNextColumn();
+            TextFmt("{:04X}", spot.pc_);
+            hotspot_tooltip(spot, total_cycles);
+
+            TableNextColumn();
+            if (spot.bank_ >= 0)
+                TextFmt("{:02X}", spot.bank_);
+            else
+                TextUnformatted("--");
+
+            TableNextColumn();
+            TextFmt("{}", spot.cycles_);
+
+            TableNextColumn();
+            TextFmt("{:5.2f}", 100.0 * spot.cycles_ / total_cycles);
+
+            TableNextColumn();
+            TextFmt("{}", spot.count_);
+        }
+
+        EndTable();
+    }
+}
+
+void call_tree_node(const CallProfiler& profiler, uint32_t idx, uint64_t total_cycles)
+{
+    using namespace imgui;
+
+    const std::vector<CallNode>& nodes = profiler.nodes();
+    const CallNode& node = nodes[idx];
+
+    // Hottest callees first
+    std::vector<uint32_t> children;
+    for (uint32_t child = node.first_child_; child != CallNode::none; child = nodes[child].next_sibling_)
+        children.push_back(child);
+
+    std::ranges::sort(children, std::ranges::greater {}, [&](uint32_t child) { return nodes[child].inclusive_; });
+
+    ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth;
+    if (children.empty())
+        flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+    if (idx == CallProfiler::root)
+        flags |= ImGuiTreeNodeFlags_DefaultOpen;
+
+    TableNextRow();
+    TableNextColumn();
+    const bool open = TreeNodeEx(reinterpret_cast<void*>(static_cast<uintptr_t>(idx)), flags, "%s", profiler.node_name(idx).c_str());
+
+    TableNextColumn();
+    TextFmt("{}", node.calls_);
+
+    TableNextColumn();
+    TextFmt("{:6.2f}", 100.0 * node.inclusive_ / total_cycles);
+
+    TableNextColumn();
+    TextFmt("{:6.2f}", 100.0 * node.exclusive_ / total_cycles);
+
+    if (open && !children.empty())
+    {
+        for (uint32_t child : children)
+            call_tree_node(profiler, child, total_cycles);
+
+        TreePop();
+    }
+}
+
+void call_tree(Emulator& emulator)
+{
+    using namespace imgui;
+    const float textHeight = GetTextLineHeightWithSpacing();
+
+    CallProfiler& profiler = emulator.get_call_profiler();
+    static std::string export_status;
+
+    BeginDisabled(!emulator.is_ready());
+
+    bool profiling = emulator.is_call_profiling();
+    if (Checkbox("Profile calls", &profiling))
+        emulator.set_call_profiling(profiling);
+
+    SameLine();
+    if (Button("Clear##calls"))
+        profiler.clear();
+
+    SameLine();
+    if (Button("Export folded stacks"))
+    {
+        // Next to the ROM, for flamegraph.pl or speedscope
+        const stdfs::path path = stdfs::path(emulator.get_rom_path()).replace_extension(".folded");
+        std::ofstream ofs(path);
+        profiler.write_folded(ofs);
+        export_status = ofs ? path.string() : fmt::format("Can't write {}", path.string());
+    }
+
+    EndDisabled();
+
+    const uint64_t total_cycles = profiler.total_cycles();
+    TextFmt("Cycles: {}, depth: {}", total_cycles, profiler.depth());
+
+    if (!export_status.empty())
+        TextUnformatted(export_status.c_str());
+
+    if (total_cycles == 0)
+        return;
+
+    profiler.update_inclusive();
+
+    static constexpr ImGuiTableFlags table_flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+
+    if (BeginTable("call_tree", 4, table_flags, ImVec2(0.f, textHeight * 12)))
+    {
+        TableSetupScrollFreeze(0, 1);
+        TableSetupColumn("Function");
+        TableSetupColumn("Calls");
+        TableSetupColumn("Incl %");
+        TableSetupColumn("Excl %");
+        TableHeadersRow();
+
+        call_tree_node(profiler, CallProfiler::root, total_cycles);
+
+        EndTable();
+    }
+}
+
+void ui::imgui_debugger(Emulator& emulator)
 {
     using namespace imgui;
-    Emulator& emulator = *Emulator::instance();
     BUS& bus = *emulator.get_bus();
     CPU& cpu = *emulator.get_cpu();
     CPU_State const& cpu_state = cpu.get_state();
 
     static PrgModel model;
-    model.reset(bus, 0);
+    model.reset(bus, emulator.disassembler_, 0);
 
     address_t program_counter = bus.map_cpu_addr(cpu_state.program_counter_);
 
     int sticky_idx = model.get_idx(program_counter);
 
+    // Also after the profiling was turned off, until the counts are cleared
+    HotspotProfiler& profiler = emulator.get_profiler();
+    const uint64_t total_cycles = profiler.total_cycles();
+    const std::vector<HotSpot> top = total_cycles > 0 ? profiler.top(50) : std::vector<HotSpot> {};
+
     const float textHeight = GetTextLineHeightWithSpacing();
 
     if (BeginTable("layout_columns", 2))
@@ -328,7 +543,7 @@ void ui::imgui_debugger()
             SeparatorText("Instructions");
             
             static ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
-            if (BeginTable("disassembly", 5, flags, ImVec2(0.f, textHeight * 16)))
+            if (BeginTable("disassembly", 6, flags, ImVec2(0.f, textHeight * 16)))
             {
                 constexpr ImGuiTableColumnFlags op_flags = ImGuiTableColumnFlags_NoResize;
 
@@ -337,6 +552,7 @@ void ui::imgui_debugger()
                 TableSetupColumn("operand1", op_flags, 0.f);
                 TableSetupColumn("operand2", op_flags, 0.f);
                 TableSetupColumn("Assembly", 0, 0.f);
+                TableSetupColumn("Cycles", 0, 0.f);
 
                 StringBuilder sb;
 
@@ -384,6 +600,18 @@ void ui::imgui_debugger()
                         sb.buf.clear();
                         emulator.disassembler_.asm_str(sb, op);
                         TextUnformatted(sb.buf.data(), sb.buf.data() + sb.buf.size());
+
+                        TableNextColumn();
+                        if (total_cycles > 0)
+                        {
+                            const HotSpot spot = profiler.get_rom(model.get_rom(row) - bus.cart_->prg_rom_.data());
+                            if (spot.cycles_ > 0)
+                            {
+                                TableSetBgColor(ImGuiTableBgTarget_RowBg1, heat_color(spot.cycles_, top.front().cycles_));
+                                TextFmt("{:5.2f}%", 100.0 * spot.cycles_ / total_cycles);
+                                hotspot_tooltip(spot, total_cycles);
+                            }
+                        }
                     }
                 }
 
@@ -431,6 +659,14 @@ void ui::imgui_debugger()
             breakpoints(emulator.debugger_);
 
             EndDisabled();
+
+            NewLine();
+            SeparatorText("Hottest addresses");
+            hotspots(emulator, top);
+
+            NewLine();
+            SeparatorText("Call tree");
+            call_tree(emulator);
         }
 
         EndTable();
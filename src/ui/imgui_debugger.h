@@ -1,4 +1,6 @@
+class Emulator;
+
 namespace ui
 {
-    void imgui_debugger();
+    void imgui_debugger(Emulator& emulator);
 }
\ No newline at end of file
@@ -6,11 +6,11 @@
 
 #include "ui/imgui.h"
 
-void ui::imgui_mem_view()
+void ui::imgui_mem_view(Emulator& emulator)
 {
     using namespace imgui;
 
-    std::span<byte_t> ram = {Emulator::instance()->get_bus()->ram_.data(), 0x800};
+    std::span<byte_t> ram = {emulator.get_bus()->ram_.data(), 0x800};
     const float textHeight = GetTextLineHeightWithSpacing();
 
     constexpr ImGuiTableFlags table_flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
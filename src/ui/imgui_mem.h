@@ -1,6 +1,8 @@
 #pragma once
 
+class Emulator;
+
 namespace ui
 {
-    void imgui_mem_view();
+    void imgui_mem_view(Emulator& emulator);
 }
\ No newline at end of file
@@ -10,10 +10,8 @@
 
 #include <fmt/format.h>
 
-void ui::PATData::update()
+void ui::PATData::update(const BUS& bus)
 {
-    Emulator& emulator = *Emulator::instance();
-    const BUS& bus = *emulator.get_bus();
     const Cartridge* cart = bus.cart_;
 
     if (dirty_cart_check_ != cart)
@@ -25,7 +23,7 @@ void ui::PATData::update()
 
         if (cart != nullptr)
         {
-            for (size_t i = 0; i < std::size(cart->get_chr_banks()); ++i)
+            for (size_t i = 0; i < cart->get_chr_bank_count(); ++i)
             {
                 chrbnk_combo_model_.add_option(fmt::format("CHR bank {}", i));
             }
@@ -88,11 +86,11 @@ void ui::PATData::update()
 
 ui::PPUData& globals() { return *ui::Globals::get().ppu_data_; }
 
-void debug_oam();
-void debug_pat();
-void debug_nam();
+void debug_oam(const BUS& bus);
+void debug_pat(const BUS& bus);
+void debug_nam(const BUS& bus);
 
-void ui::imgui_ppu_window()
+void ui::imgui_ppu_window(Emulator& emulator)
 {
     using namespace imgui;
 
@@ -105,19 +103,19 @@ void ui::imgui_ppu_window()
         {
             if (BeginTabItem("OAM"))
             {
-                debug_oam();
+                debug_oam(*emulator.get_bus());
                 EndTabItem();
             }
 
             if (BeginTabItem("PAT"))
             {
-                debug_pat();
+                debug_pat(*emulator.get_bus());
                 EndTabItem();
             }
 
             if (BeginTabItem("NAM"))
             {
-                debug_nam();
+                debug_nam(*emulator.get_bus());
                 EndTabItem();
             }
 
@@ -127,14 +125,14 @@ void ui::imgui_ppu_window()
     }
 }
 
-void debug_oam()
+void debug_oam(const BUS& bus)
 {
     using namespace imgui;
 
     if (BeginChild("-"))
     {
         ui::OAMData& oam_data = globals().oam_data_;
-        oam_data.update();
+        oam_data.update(bus);
 
         auto entry = [&](int index)
         {
@@ -176,13 +174,13 @@ void debug_oam()
     }
 }
 
-void debug_pat()
+void debug_pat(const BUS& bus)
 {
     using namespace imgui;
     if (BeginChild("-"))
     {
         ui::PATData& pat_data = globals().pat_data_;
-        pat_data.update();
+        pat_data.update(bus);
 
         SeparatorText("Palettes");
         {
@@ -236,7 +234,7 @@ void debug_pat()
     }
 }
 
-void debug_nam()
+void debug_nam(const BUS& bus)
 {
     using namespace imgui;
 
@@ -244,7 +242,7 @@ void debug_nam()
     {
         ui::NAMData& nam_data = globals().nam_data_;
 
-        nam_data.update();
+        nam_data.update(bus);
 
         imgui::Image(nam_data.texture_, sf::Vector2f(512.f, 480.f));
 
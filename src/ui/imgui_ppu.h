@@ -32,7 +32,7 @@ namespace ui
     {
         OAMData() { texture_.create(64, 64); }
 
-        void update() { ui::ppu_oam_texture(texture_, sprites_); }
+        void update(const BUS& bus) { ui::ppu_oam_texture(texture_, sprites_, bus); }
 
         std::array<OAMSprite, 64> sprites_;
         sf::Texture texture_;
@@ -49,7 +49,7 @@ namespace ui
                 tex.create(128, 128);
         }
 
-        void update();
+        void update(const BUS& bus);
 
         std::array<sf::Texture, 8> pal_textures_;
         std::array<sf::Texture, 2> pat_textures_;
@@ -63,7 +63,7 @@ namespace ui
     {
         NAMData() { texture_.create(512, 480); }
 
-        void update() { ui::ppu_nametable_texture(texture_); }
+        void update(const BUS& bus) { ui::ppu_nametable_texture(texture_, bus); }
 
         sf::Texture texture_;
     };
@@ -78,7 +78,9 @@ namespace ui
     };
 }
 
+class Emulator;
+
 namespace ui
 {
-    void imgui_ppu_window();   
+    void imgui_ppu_window(Emulator& emulator);   
 }
@@ -1,37 +1,10 @@
 #include "ppu_utils.h"
 
-#include "emulator.h"
 #include "bus.h"
+#include "ppu.h"
 
 #include <SFML/Graphics.hpp>
 
-Palette ppu_read_palette(const BUS& bus, int idx)
-{
-    NES_ASSERT(idx >= 0 && idx < 8);
-    if (idx < 4)
-    {
-        static constexpr address_t palette_bg[] = {0x3F01, 0x3F05, 0x3F09, 0x3F0D};
-        address_t paladdr = palette_bg[idx];
-        return Palette(
-            g_palette[bus.read_ppu(0x3F00)],
-            g_palette[bus.read_ppu(paladdr + 0)],
-            g_palette[bus.read_ppu(paladdr + 1)],
-            g_palette[bus.read_ppu(paladdr + 2)]
-        );
-    }
-    else
-    {
-        static constexpr address_t palette_fg[] = {0x3F11, 0x3F15, 0x3F19, 0x3F1D};
-        address_t paladdr = palette_fg[idx - 4];
-        return Palette(
-            {0xFF, 0xFF, 0xFF, 0x00},
-            g_palette[bus.read_ppu(paladdr + 0)],
-            g_palette[bus.read_ppu(paladdr + 1)],
-            g_palette[bus.read_ppu(paladdr + 2)]
-        );
-    }
-}
-
 // extract a single pixel value [0-3] from tile data
 byte_t ppu_tile_pixel(const BUS& bus, Tile tile, int x, int y, byte_t flip_mask = 0)
 {
@@ -117,13 +90,11 @@ void ppu_fill_nametable_tile(NAMImage& image, const BUS& bus, Tile tile, int ntc
     }
 }
 
-void ppu_fill_nametable_image(NAMImage& image, address_t ntaddr)
+void ppu_fill_nametable_image(NAMImage& image, const BUS& bus, address_t ntaddr)
 {
     static constexpr address_t bg_palette_addr[] = {0x3F01, 0x3F05, 0x3F09, 0x3F0D};
 
-    Emulator& emulator = *Emulator::instance();
-    const BUS& bus = *emulator.get_bus();
-    const PPU& ppu = *emulator.get_ppu();
+    const PPU& ppu = bus.ppu_;
 
     Tile tile;
 
@@ -142,7 +113,7 @@ void ppu_fill_nametable_image(NAMImage& image, address_t ntaddr)
     }
 }
 
-void ui::ppu_nametable_texture(sf::Texture &tex)
+void ui::ppu_nametable_texture(sf::Texture &tex, const BUS& bus)
 {
     static constexpr address_t nametable_addr[] = {0x2000, 0x2400, 0x2800, 0x2C00};
     NES_ASSERT(tex.getSize().x >= NAMImage::Width * 2 && tex.getSize().y >= NAMImage::Height * 2);
@@ -152,7 +123,7 @@ void ui::ppu_nametable_texture(sf::Texture &tex)
     for (int i = 0; i < 4; ++i)
     {
         const address_t ntaddr = nametable_addr[i];
-        ppu_fill_nametable_image(image, ntaddr);
+        ppu_fill_nametable_image(image, bus, ntaddr);
     
         const int x = (i % 2) * NAMImage::Width;
         const int y = (i / 2) * NAMImage::Height;
@@ -185,11 +156,8 @@ OAMSprite ppu_read_sprite_image(SpriteImage& image, const BUS& bus, int oam_idx)
     return sprite;
 }
 
-void ui::ppu_oam_texture(sf::Texture& tex, std::span<OAMSprite> sprites)
+void ui::ppu_oam_texture(sf::Texture& tex, std::span<OAMSprite> sprites, const BUS& bus)
 {
-    Emulator &emulator = *Emulator::instance();
-    BUS &bus = *emulator.get_bus();
-
     SpriteImage image;
 
     for (int i = 0; i < 64; ++i)
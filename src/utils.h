@@ -7,10 +7,18 @@
 #include <span>
 #include <utility>
 
+#if defined(_MSC_VER)
 #define NES_BREAKPOINT __debugbreak()
 #define NES_DEOPTIMIZE __pragma(optimize("",off))
-
-#define NES_ASSERT(X) { if(!(X)) { __debugbreak(); } }
+#elif defined(__clang__)
+#define NES_BREAKPOINT __builtin_debugtrap()
+#define NES_DEOPTIMIZE [[clang::optnone]]
+#else
+#define NES_BREAKPOINT __builtin_trap()
+#define NES_DEOPTIMIZE
+#endif
+
+#define NES_ASSERT(X) { if(!(X)) { NES_BREAKPOINT; } }
 
 #define EXPAND(...) EXPAND1(EXPAND1(EXPAND1(EXPAND1(__VA_ARGS__))))
 #define EXPAND1(...) EXPAND2(EXPAND2(EXPAND2(EXPAND2(__VA_ARGS__))))
@@ -0,0 +1,98 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#include "emulator.h"
+
+// NROM, code at $C000 (the reset vector), the IRQ handler at $C100
+static stdfs::path write_rom(std::span<const byte_t> code, std::span<const byte_t> irq)
+{
+    std::vector<byte_t> image(16 + 0x4000 + 0x2000, 0);
+
+    constexpr std::array<byte_t, 8> header = { 'N', 'E', 'S', 0x1A, 1, 1, 0, 0 };
+    std::ranges::copy(header, image.begin());
+
+    byte_t* prg = image.data() + 16;
+    std::ranges::copy(code, prg);
+    std::ranges::copy(irq, prg + 0x100);
+    prg[0x3FFC] = 0x00; // reset
+    prg[0x3FFD] = 0xC0;
+    prg[0x3FFE] = 0x00; // IRQ
+    prg[0x3FFF] = 0xC1;
+
+    const stdfs::path path = stdfs::temp_directory_path() / "nesemul_test_apu.nes";
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(image.data()), image.size());
+    return path;
+}
+
+// Plays a one byte DMC sample at the fastest rate with its IRQ on, then counts loops in $10-$11
+// until the IRQ. $00 is $4015 right after the start, $01 in the IRQ handler.
+constexpr std::array<byte_t, 0x2C> dmc_irq_code = {
+    0xA9, 0x40, 0x8D, 0x17, 0x40, // LDA #$40, STA $4017 (no frame IRQ)
+    0xA9, 0x8F, 0x8D, 0x10, 0x40, // LDA #$8F, STA $4010 (IRQ, rate 15: 54 cycles)
+    0xA9, 0x00, 0x8D, 0x12, 0x40, // LDA #0, STA $4012 (sample at $C000)
+    0x8D, 0x13, 0x40, // STA $4013 (1 byte)
+    0xA9, 0x10, 0x8D, 0x15, 0x40, // LDA #$10, STA $4015 (start)
+    0xAD, 0x15, 0x40, 0x85, 0x00, // LDA $4015, STA $00
+    0xA9, 0x00, 0x85, 0x10, 0x85, 0x11, // LDA #0, STA $10, STA $11
+    0x58, // CLI
+    0xE6, 0x10, 0xD0, 0xFC, // INC $10, BNE $C023
+    0xE6, 0x11, 0x4C, 0x23, 0xC0, // INC $11, JMP $C023
+};
+
+constexpr std::array<byte_t, 8> dmc_irq_handler = {
+    0xAD, 0x15, 0x40, 0x85, 0x01, // LDA $4015, STA $01
+    0x4C, 0x05, 0xC1, // JMP $C105
+};
+
+TEST_CASE("APU DMC IRQ Timing", "[apu]")
+{
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.read_rom(write_rom(dmc_irq_code, dmc_irq_handler).wstring());
+
+    for (int i = 0; i < 2; ++i)
+        emulator.update();
+
+    const byte_t* ram = emulator.get_ram()->data();
+
+    // Playing, then done with its IRQ flag up
+    CHECK(ram[0x00] == 0x10);
+    CHECK(ram[0x01] == 0x80);
+
+    // The fetch is 54 cycles after the start, a loop is 8 cycles
+    const int loops = ram[0x10] | ram[0x11] << 8;
+    CHECK(loops <= 8);
+}
+
+TEST_CASE("APU DMC After Reset", "[apu]")
+{
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.read_rom(write_rom(dmc_irq_code, dmc_irq_handler).wstring());
+
+    // A long run, then a reset while a looping sample plays
+    for (int i = 0; i < 100; ++i)
+        emulator.update();
+
+    BUS& bus = *emulator.get_bus();
+    bus.write_cpu(0x4010, 0x4F); // loop, no IRQ
+    bus.write_cpu(0x4015, 0x10);
+    emulator.update();
+
+    bus.write_cpu(0x0001, 0);
+    emulator.reset();
+    for (int i = 0; i < 2; ++i)
+        emulator.update();
+
+    const byte_t* ram = emulator.get_ram()->data();
+    CHECK(ram[0x00] == 0x10);
+    CHECK(ram[0x01] == 0x80);
+    CHECK((ram[0x10] | ram[0x11] << 8) <= 8);
+}
@@ -0,0 +1,123 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "batch_cpu.h"
+#include "emulator.h"
+
+// Sums the input bytes at $0300 of every lane into $0400, skipping the zeros (BEQ) and
+// counting the even ones in $10 (BCS). ADC $02F1,X crosses a page from X = $0F.
+static stdfs::path write_rom()
+{
+    constexpr std::array<byte_t, 0x1B> code = {
+        0xA2, 0x00, // LDX #0
+        0xA0, 0x00, // LDY #0
+        0xBD, 0x00, 0x03, // $C004: LDA $0300,X
+        0xF0, 0x06, // BEQ $C00F
+        0x7D, 0xF1, 0x02, // ADC $02F1,X
+        0x9D, 0x00, 0x04, // STA $0400,X
+        0xC8, // $C00F: INY
+        0x4A, // LSR A
+        0xB0, 0x02, // BCS $C015
+        0xE6, 0x10, // INC $10
+        0xE8, // $C015: INX
+        0xD0, 0xEC, // BNE $C004
+        0x4C, 0x00, 0xC0, // JMP $C000
+    };
+
+    std::vector<byte_t> image(16 + 0x4000 + 0x2000, 0);
+
+    constexpr std::array<byte_t, 8> header = { 'N', 'E', 'S', 0x1A, 1, 1, 0, 0 };
+    std::ranges::copy(header, image.begin());
+
+    byte_t* prg = image.data() + 16;
+    std::ranges::copy(code, prg);
+    prg[0x3FFC] = 0x00; // reset
+    prg[0x3FFD] = 0xC0;
+
+    const stdfs::path path = stdfs::temp_directory_path() / "nesemul_test_batch_cpu.nes";
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(image.data()), image.size());
+    return path;
+}
+
+TEST_CASE("Batch CPU Matches CPU", "[batch_cpu]")
+{
+    constexpr size_t lanes = 4;
+    const stdfs::path rom = write_rom();
+
+    // A reference CPU per lane, each with its own machine
+    std::array<std::unique_ptr<Emulator>, lanes> emulators;
+    for (auto& emulator : emulators)
+    {
+        emulator = std::make_unique<Emulator>();
+        emulator->set_verbose(false);
+        emulator->read_rom(rom.wstring());
+    }
+
+    BatchCPU batch(lanes, *emulators[0]->get_cart());
+
+    // Different inputs per lane, so the branches diverge
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        std::span<byte_t> ram = batch.get_ram(lane);
+        std::ranges::copy(std::span<const byte_t>(emulators[lane]->get_ram()->data(), 0x800), ram.begin());
+
+        for (size_t i = 0; i < 0x100; ++i)
+            ram[0x300 + i] = (i % (lane + 2) == 0) ? 0 : static_cast<byte_t>(i * (lane * 2 + 1));
+
+        std::ranges::copy(ram, emulators[lane]->get_ram()->data());
+    }
+
+    auto step_cpu = [](CPU& cpu)
+    {
+        do
+            cpu.step();
+        while (cpu.get_state().state_ != CPU_State::kFetching);
+    };
+
+    // The CPU runs the reset sequence and the first instruction in one go
+    for (auto& emulator : emulators)
+        step_cpu(*emulator->get_cpu());
+    batch.step();
+
+    for (int n = 0; n < 5000; ++n)
+    {
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            const CPU_State& expected = emulators[lane]->get_cpu()->get_state();
+            const CPU_State actual = batch.get_lane_state(lane);
+
+            INFO("lane " << lane << ", instruction " << n);
+            REQUIRE(actual.program_counter_ == expected.program_counter_);
+            REQUIRE(actual.accumulator_ == expected.accumulator_);
+            REQUIRE(actual.register_x_ == expected.register_x_);
+            REQUIRE(actual.register_y_ == expected.register_y_);
+            REQUIRE(actual.status_ == expected.status_);
+            REQUIRE(actual.stack_pointer_ == expected.stack_pointer_);
+
+            // The CPU fetches the next instruction on the last cycle of the previous one
+            REQUIRE(actual.cycle_ == expected.cycle_ + 1);
+        }
+
+        for (auto& emulator : emulators)
+            step_cpu(*emulator->get_cpu());
+        batch.step();
+    }
+
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        INFO("lane " << lane);
+        CHECK(std::ranges::equal(batch.get_ram(lane), std::span<const byte_t>(emulators[lane]->get_ram()->data(), 0x800)));
+    }
+
+    // The lanes went apart and back together
+    CHECK(batch.get_stats().groups_ > batch.get_stats().steps_);
+    CHECK(batch.get_stats().lockstep_steps_ > 0);
+}
@@ -0,0 +1,162 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "batch_env.h"
+#include "capi/nesemul_env.h"
+
+// NROM, background on. The NMI handler reads the controller into $00, counts the frames in $01
+// and sets the backdrop color to the buttons.
+static stdfs::path write_rom()
+{
+    constexpr std::array<byte_t, 13> code = {
+        0xA9, 0x80, 0x8D, 0x00, 0x20, // LDA #$80, STA $2000 (NMI on)
+        0xA9, 0x0A, 0x8D, 0x01, 0x20, // LDA #$0A, STA $2001 (background on)
+        0x4C, 0x0A, 0xC0, // JMP $C00A
+    };
+
+    constexpr std::array<byte_t, 0x31> nmi = {
+        0xA9, 0x01, 0x8D, 0x16, 0x40, // LDA #1, STA $4016
+        0xA9, 0x00, 0x8D, 0x16, 0x40, // LDA #0, STA $4016
+        0xA2, 0x08, // LDX #8
+        0xAD, 0x16, 0x40, 0x4A, 0x66, 0x00, // $C10C: LDA $4016, LSR A, ROR $00
+        0xCA, 0xD0, 0xF7, // DEX, BNE $C10C
+        0xE6, 0x01, // INC $01
+        0xA9, 0x3F, 0x8D, 0x06, 0x20, 0xA9, 0x00, 0x8D, 0x06, 0x20, // $3F00: the backdrop
+        0xA5, 0x00, 0x29, 0x3F, 0x8D, 0x07, 0x20, // LDA $00, AND #$3F, STA $2007
+        0xA9, 0x00, 0x8D, 0x06, 0x20, 0x8D, 0x06, 0x20, // back to $0000
+        0x40, // RTI
+    };
+
+    std::vector<byte_t> image(16 + 0x4000 + 0x2000, 0);
+
+    constexpr std::array<byte_t, 8> header = { 'N', 'E', 'S', 0x1A, 1, 1, 0, 0 };
+    std::ranges::copy(header, image.begin());
+
+    byte_t* prg = image.data() + 16;
+    std::ranges::copy(code, prg);
+    std::ranges::copy(nmi, prg + 0x100);
+    prg[0x3FFA] = 0x00; // NMI
+    prg[0x3FFB] = 0xC1;
+    prg[0x3FFC] = 0x00; // reset
+    prg[0x3FFD] = 0xC0;
+
+    const stdfs::path path = stdfs::temp_directory_path() / "nesemul_test_batch_env.nes";
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(image.data()), image.size());
+    return path;
+}
+
+TEST_CASE("Batch Env Step", "[batch_env]")
+{
+    BatchEnvConfig config;
+    config.instances_ = 3;
+    config.frame_skip_ = 2;
+    config.observation_ = EnvObservation::RGBA;
+    config.threads_ = 2;
+
+    BatchEnv env(write_rom(), config);
+    REQUIRE(env.size() == 3);
+    CHECK(env.grey_batch().empty());
+
+    constexpr std::array<byte_t, 3> actions = { 0, Controller::A, Controller::Start | Controller::Right };
+    env.step(actions);
+
+    for (size_t i = 0; i < env.size(); ++i)
+    {
+        const EnvView view = env.observe(i);
+        CHECK(view.frame_.size() == PPU::Output::Width * PPU::Output::Height * 4);
+        REQUIRE(view.ram_.size() == 0x800);
+        CHECK(view.ram_[0x00] == actions[i]);
+        CHECK(env.frame(i) == 2);
+        CHECK(!env.is_halted(i));
+    }
+
+    // The backdrop follows the buttons
+    CHECK(!std::ranges::equal(env.observe(0).frame_, env.observe(1).frame_));
+
+    CHECK_THROWS_AS(env.step(std::span(actions).first(2)), std::runtime_error);
+
+    env.reset();
+    CHECK(env.frame(0) == 0);
+}
+
+TEST_CASE("Batch Env C API", "[batch_env]")
+{
+    CHECK(nesemul_env_abi_version() == NESEMUL_ENV_ABI_VERSION);
+
+    const std::string rom = write_rom().string();
+
+    nesemul_env_config config {};
+    config.instances = 4;
+    config.frame_skip = 2;
+    config.observation = NESEMUL_OBS_GREYSCALE84;
+    config.threads = 2;
+
+    CHECK(nesemul_env_create("nesemul_no_such_rom.nes", &config) == nullptr);
+    CHECK(std::string(nesemul_env_last_error()) != "");
+
+    nesemul_env* env = nesemul_env_create(rom.c_str(), &config);
+    nesemul_env* twin = nesemul_env_create(rom.c_str(), &config);
+    REQUIRE(env != nullptr);
+    REQUIRE(twin != nullptr);
+    REQUIRE(nesemul_env_size(env) == 4);
+
+    // One contiguous greyscale buffer, [instance][y][x]
+    size_t batch_size = 0;
+    const uint8_t* batch = nesemul_env_greyscale_batch(env, &batch_size);
+    REQUIRE(batch != nullptr);
+    CHECK(batch_size == 4 * 84 * 84);
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        size_t size = 0;
+        CHECK(nesemul_env_frame(env, i, &size) == batch + i * 84 * 84);
+        CHECK(size == 84 * 84);
+
+        CHECK(nesemul_env_ram(env, i, &size) != nullptr);
+        CHECK(size == 0x800);
+    }
+    CHECK(nesemul_env_frame(env, 4, nullptr) == nullptr);
+
+    CHECK(nesemul_env_reset(env) == 0);
+    CHECK(nesemul_env_frame_count(env, 0) == 0);
+
+    // Per instance actions, the same sequence on both envs
+    for (uint8_t step = 0; step < 10; ++step)
+    {
+        const std::array<uint8_t, 4> actions = { 0, uint8_t(step * 7), uint8_t(1 << (step % 8)), uint8_t(~step) };
+        REQUIRE(nesemul_env_step(env, actions.data(), actions.size()) == 0);
+        REQUIRE(nesemul_env_step(twin, actions.data(), actions.size()) == 0);
+
+        for (size_t i = 0; i < 4; ++i)
+            CHECK(nesemul_env_ram(env, i, nullptr)[0x00] == actions[i]);
+    }
+
+    CHECK(nesemul_env_frame_count(env, 3) == 20);
+    CHECK(nesemul_env_is_halted(env, 0) == 0);
+
+    // Deterministic: same inputs, same observations
+    size_t twin_size = 0;
+    const uint8_t* twin_batch = nesemul_env_greyscale_batch(twin, &twin_size);
+    REQUIRE(twin_size == batch_size);
+    CHECK(std::equal(batch, batch + batch_size, twin_batch));
+    for (size_t i = 0; i < 4; ++i)
+        CHECK(std::equal(nesemul_env_ram(env, i, nullptr), nesemul_env_ram(env, i, nullptr) + 0x800, nesemul_env_ram(twin, i, nullptr)));
+
+    // Different buttons, different backdrops
+    CHECK(!std::equal(batch, batch + 84 * 84, batch + 3 * 84 * 84));
+
+    const uint8_t action = 0;
+    CHECK(nesemul_env_step(env, &action, 1) == -1);
+    CHECK(std::string(nesemul_env_last_error()).find("Expected 4 actions") != std::string::npos);
+
+    nesemul_env_destroy(twin);
+    nesemul_env_destroy(env);
+}
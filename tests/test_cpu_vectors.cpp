@@ -0,0 +1,96 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "cpu_test_vectors.h"
+#include "emulator.h"
+
+TEST_CASE("CPU Vectors Check Registers Memory And Cycles", "[cpu_vectors]")
+{
+    // LDA #$80, STA $0200, then a taken BNE crossing a page
+    std::istringstream vectors(R"([
+        { "name": "a9 80",
+          "initial": { "pc": 4096, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36, "ram": [[4096, 169], [4097, 128]] },
+          "final":   { "pc": 4098, "s": 253, "a": 128, "x": 0, "y": 0, "p": 164, "ram": [[4096, 169], [4097, 128]] },
+          "cycles": [[4096, 169, "read"], [4097, 128, "read"]] },
+        { "name": "8d 00 02",
+          "initial": { "pc": 4096, "s": 253, "a": 66, "x": 0, "y": 0, "p": 36, "ram": [[4096, 141], [4097, 0], [4098, 2]] },
+          "final":   { "pc": 4099, "s": 253, "a": 66, "x": 0, "y": 0, "p": 36, "ram": [[512, 66], [4096, 141], [4097, 0], [4098, 2]] },
+          "cycles": [[4096, 141, "read"], [4097, 0, "read"], [4098, 2, "read"], [512, 66, "write"]] },
+        { "name": "d0 10",
+          "initial": { "pc": 4334, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36, "ram": [[4334, 208], [4335, 16]] },
+          "final":   { "pc": 4352, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36, "ram": [[4334, 208], [4335, 16]] },
+          "cycles": [[4334, 208, "read"], [4335, 16, "read"], [4336, 0, "read"], [4336, 0, "read"]] }
+    ])");
+
+    const CpuVectorStats stats = CpuTestVectors().run_stream(vectors, "inline");
+    INFO((stats.failures_.empty() ? std::string() : stats.failures_.front()));
+    CHECK(stats.vectors_ == 3);
+    CHECK(stats.passed_ == 3);
+    CHECK(stats.failed_ == 0);
+}
+
+TEST_CASE("CPU Vectors Report Mismatches", "[cpu_vectors]")
+{
+    // Wrong A and cycle count, then an opcode the CPU does not implement
+    std::istringstream vectors(R"([
+        { "name": "a9 80",
+          "initial": { "pc": 4096, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36, "ram": [[4096, 169], [4097, 128]] },
+          "final":   { "pc": 4098, "s": 253, "a": 127, "x": 0, "y": 0, "p": 164, "ram": [] },
+          "cycles": [[4096, 169, "read"], [4097, 128, "read"], [4098, 0, "read"]] },
+        { "name": "02",
+          "initial": { "pc": 4096, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36, "ram": [[4096, 2]] },
+          "final":   { "pc": 4097, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36, "ram": [] },
+          "cycles": [[4096, 2, "read"]] }
+    ])");
+
+    const CpuVectorStats stats = CpuTestVectors().run_stream(vectors, "inline");
+    CHECK(stats.failed_ == 1);
+    CHECK(stats.skipped_ == 1);
+    REQUIRE(stats.failures_.size() == 1);
+    CHECK(stats.failures_[0] == "inline: a9 80: A $80 expected $7F; 2 cycles expected 3");
+}
+
+// The single-step vectors (one JSON file per opcode, NES variant without decimal mode) are not
+// shipped, point NESEMUL_SINGLE_STEP_TESTS at the directory holding them.
+TEST_CASE("Single Step CPU Vectors", "[cpu_vectors]")
+{
+    const char* dir = std::getenv("NESEMUL_SINGLE_STEP_TESTS");
+    if (dir == nullptr || !stdfs::is_directory(dir))
+        SKIP("NESEMUL_SINGLE_STEP_TESTS is not set");
+
+    const std::vector<stdfs::path> files = CpuTestVectors::find_files(dir);
+    REQUIRE_FALSE(files.empty());
+
+    const CpuVectorStats stats = CpuTestVectors().run(files);
+    for (const std::string& failure : stats.failures_)
+        UNSCOPED_INFO(failure);
+
+    CHECK(stats.errors_ == 0);
+    CHECK(stats.failed_ == 0);
+}
+
+TEST_CASE("Flat Memory Page Read", "[cpu_vectors]")
+{
+    std::vector<byte_t> memory(0x10000);
+    for (size_t i = 0; i < memory.size(); ++i)
+        memory[i] = static_cast<byte_t>(i ^ (i >> 8));
+
+    Emulator emulator;
+    BUS& bus = *emulator.get_bus();
+    bus.set_flat_memory(memory.data());
+
+    // OAM DMA sees the flat memory too, RAM and I/O pages alike
+    std::array<byte_t, 0x100> page;
+    for (const byte_t idx : { 0x02, 0x40 })
+    {
+        REQUIRE(bus.read_cpu_page(idx, page));
+        CHECK(std::equal(page.begin(), page.end(), memory.begin() + idx * 0x100));
+    }
+
+    bus.set_flat_memory(nullptr);
+}
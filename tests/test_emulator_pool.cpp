@@ -0,0 +1,68 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#include "emulator_pool.h"
+
+// NROM, code at $C000 (the reset vector), the NMI handler at $C100
+static stdfs::path write_rom(std::string_view name, std::span<const byte_t> code, std::span<const byte_t> nmi)
+{
+    std::vector<byte_t> image(16 + 0x4000 + 0x2000, 0);
+
+    constexpr std::array<byte_t, 8> header = { 'N', 'E', 'S', 0x1A, 1, 1, 0, 0 };
+    std::ranges::copy(header, image.begin());
+
+    byte_t* prg = image.data() + 16;
+    std::ranges::copy(code, prg);
+    std::ranges::copy(nmi, prg + 0x100);
+    prg[0x3FFA] = 0x00; // NMI
+    prg[0x3FFB] = 0xC1;
+    prg[0x3FFC] = 0x00; // reset
+    prg[0x3FFD] = 0xC0;
+
+    const stdfs::path path = stdfs::temp_directory_path() / name;
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(image.data()), image.size());
+    return path;
+}
+
+TEST_CASE("Emulator Pool Halted Job", "[pool]")
+{
+    // NOP, then an opcode the CPU doesn't know
+    constexpr std::array<byte_t, 2> bad = { 0xEA, 0x02 };
+
+    // NMI on, loop, the NMI handler counts the frames in $00
+    constexpr std::array<byte_t, 8> good = { 0xA9, 0x80, 0x8D, 0x00, 0x20, 0x4C, 0x05, 0xC0 };
+    constexpr std::array<byte_t, 3> count = { 0xE6, 0x00, 0x40 }; // INC $00, RTI
+
+    const stdfs::path bad_rom = write_rom("nesemul_test_pool_bad.nes", bad, count);
+    const stdfs::path good_rom = write_rom("nesemul_test_pool_good.nes", good, count);
+
+    // A single worker, the good job reuses the emulator of the failed one
+    EmulatorPool pool(1);
+
+    EmulatorJob failing;
+    failing.rom_ = bad_rom;
+    failing.frames_ = 10;
+
+    EmulatorJob passing;
+    passing.rom_ = good_rom;
+    passing.frames_ = 10;
+    passing.ram_dump_ = true;
+
+    std::future<EmulatorJobResult> failed = pool.submit(failing);
+    std::future<EmulatorJobResult> passed = pool.submit(passing);
+
+    CHECK_THROWS_AS(failed.get(), std::runtime_error);
+
+    const EmulatorJobResult result = passed.get();
+    CHECK(result.frames_ == 10);
+    REQUIRE(result.ram_.size() == 0x800);
+    CHECK(result.ram_[0] >= 9);
+    CHECK(result.ram_[0] <= 10);
+}
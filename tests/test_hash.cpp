@@ -0,0 +1,22 @@
+#include <catch2/catch_all.hpp>
+
+#include <string>
+#include <string_view>
+
+#include "hash.h"
+
+static uint64_t hash_string(std::string_view s, uint64_t seed = 0)
+{
+    return hash_bytes({ reinterpret_cast<const byte_t*>(s.data()), s.size() }, seed);
+}
+
+TEST_CASE("XXH64 Reference Values", "[hash]")
+{
+    CHECK(hash_string("") == 0xEF46DB3751D8E999ull);
+    CHECK(hash_string("a") == 0xD24EC4F1A98C6E5Bull);
+    CHECK(hash_string("abc") == 0x44BC2CF5AD770999ull);
+
+    // Exercises the 32 byte stripes, the 8 and 4 byte tails and the seed
+    CHECK(hash_string("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ull);
+    CHECK(hash_string(std::string(37, 'y'), 12345) == 0x1E9348A1D0F4E137ull);
+}
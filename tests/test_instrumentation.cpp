@@ -0,0 +1,84 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+#include "emulator.h"
+
+TEST_CASE("Instrumentation Frame Counters", "[instrumentation]")
+{
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.set_instrumented(true);
+
+    Instrumentation& timings = emulator.get_instrumentation();
+    timings.set_sample_period(1);
+    timings.begin_frame(10, 100);
+
+    BUS& bus = *emulator.get_bus();
+    bus.read_cpu(0x0000);
+    bus.read_cpu(0x0800);
+    bus.write_cpu(0x0001, 0x42);
+    bus.read_cpu(0x2002);
+    bus.read_cpu(0xFFFC);
+
+    int calls = 0;
+    for (int i = 0; i < 5; ++i)
+        timings.run(Subsystem::CPU, [&] { ++calls; });
+
+    timings.end_frame(7, 13, 160);
+
+    const FrameCounters& last = timings.last_frame();
+    CHECK(calls == 5);
+    CHECK(last.frame_ == 7);
+    CHECK(last.calls_[static_cast<size_t>(Subsystem::CPU)] == 5);
+    CHECK(last.calls_[static_cast<size_t>(Subsystem::PPU)] == 0);
+    CHECK(last.bus_.reads_[BusCounters::region(0x0000)] == 2);
+    CHECK(last.bus_.writes_[BusCounters::region(0x0000)] == 1);
+    CHECK(last.bus_.reads_[BusCounters::region(0x2000)] == 1);
+    CHECK(last.bus_.reads_[BusCounters::region(0xE000)] == 1);
+    CHECK(last.bank_switches_ == 3);
+    CHECK(last.debugger_hooks_ == 60);
+
+    // Stopped, the calls still run but nothing is counted
+    emulator.set_instrumented(false);
+    timings.begin_frame(0, 0);
+    timings.run(Subsystem::CPU, [&] { ++calls; });
+    bus.read_cpu(0x0000);
+    timings.end_frame(8, 0, 0);
+
+    CHECK(calls == 6);
+    CHECK(timings.last_frame().calls_[static_cast<size_t>(Subsystem::CPU)] == 0);
+    CHECK(timings.last_frame().bus_.reads_[0] == 0);
+}
+
+TEST_CASE("Instrumentation CSV Columns", "[instrumentation]")
+{
+    std::ostringstream header;
+    std::ostringstream row;
+    Instrumentation::write_csv_header(header);
+    Instrumentation::write_csv_row(row, FrameCounters {});
+
+    CHECK(std::ranges::count(header.str(), ',') == std::ranges::count(row.str(), ','));
+    CHECK(header.str().starts_with("frame,frame_ns,cpu_ns,cpu_calls"));
+}
+
+TEST_CASE("Perf Sample Rates", "[instrumentation]")
+{
+    PerfSample start;
+    PerfSample end;
+    end.counts_ = { 2000, 3000, 6, 30 };
+
+    const PerfSample frame = end - start;
+    CHECK(frame.ipc() == 1.5);
+    CHECK(frame.branch_mpki() == 2.0);
+    CHECK(frame.l1d_mpki() == 10.0);
+    CHECK(PerfSample {}.ipc() == 0.0);
+
+    // Either counting or saying why not, most CI machines and VMs have no PMU
+    Instrumentation timings;
+    if (timings.set_perf_counters(true))
+        CHECK(timings.has_perf_counters());
+    else
+        CHECK_FALSE(timings.perf_error().empty());
+}
@@ -0,0 +1,60 @@
+#include <catch2/catch_all.hpp>
+
+#include <sstream>
+#include <stdexcept>
+
+#include "controller.h"
+#include "movie.h"
+
+TEST_CASE("Movie Binary Round Trip", "[movie]")
+{
+    Movie movie;
+    movie.rom_hash_ = 0x0123456789ABCDEFull;
+    movie.frames_.assign(1000, { Controller::A });
+    movie.frames_[0].command_ = MovieCommand::PowerOn;
+    movie.frames_[500].buttons_ = Controller::Start | Controller::Right;
+
+    std::stringstream ss;
+    movie.write(ss);
+
+    // Runs of held buttons stay small
+    CHECK(ss.str().size() < 48);
+
+    const Movie read = Movie::read(ss);
+    CHECK(read.rom_hash_ == movie.rom_hash_);
+    CHECK(read.frames_ == movie.frames_);
+}
+
+TEST_CASE("Movie Truncated", "[movie]")
+{
+    Movie movie;
+    movie.frames_.assign(10, { Controller::B });
+
+    std::stringstream ss;
+    movie.write(ss);
+
+    std::string data = ss.str();
+    data.pop_back();
+
+    std::istringstream truncated(data);
+    CHECK_THROWS_AS(Movie::read(truncated), std::runtime_error);
+}
+
+TEST_CASE("Movie FM2 Import", "[movie]")
+{
+    std::istringstream fm2(
+        "version 3\r\n"
+        "port0 1\r\n"
+        "|2|........|||\r\n"
+        "|0|R......A|||\r\n"
+        "|1|...UT...|||\r\n");
+
+    const Movie movie = Movie::read_fm2(fm2);
+    REQUIRE(movie.frames_.size() == 3);
+
+    CHECK(movie.frames_[0].command_ == MovieCommand::PowerOn);
+    CHECK(movie.frames_[0].buttons_ == 0);
+    CHECK(movie.frames_[1].buttons_ == (Controller::Right | Controller::A));
+    CHECK(movie.frames_[2].command_ == MovieCommand::Reset);
+    CHECK(movie.frames_[2].buttons_ == (Controller::Up | Controller::Start));
+}
@@ -0,0 +1,202 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <vector>
+
+#include "emulator.h"
+
+// MMC3, four 8KB PRG banks: INX; RTS at the start of bank 1, NOP; NOP; RTS in bank 2.
+// fixed is the code at $E000, the reset vector, the NMI handler is at nmi.
+static stdfs::path write_banked_rom(std::span<const byte_t> fixed, address_t nmi = 0xE000)
+{
+    std::vector<byte_t> image(16 + 0x8000 + 0x2000, 0);
+
+    constexpr std::array<byte_t, 8> header = { 'N', 'E', 'S', 0x1A, 2, 1, 0x40, 0 };
+    std::ranges::copy(header, image.begin());
+
+    byte_t* prg = image.data() + 16;
+
+    constexpr std::array<byte_t, 2> bank1 = { 0xE8, 0x60 };
+    constexpr std::array<byte_t, 3> bank2 = { 0xEA, 0xEA, 0x60 };
+    std::ranges::copy(bank1, prg + 0x2000);
+    std::ranges::copy(bank2, prg + 0x4000);
+
+    std::ranges::copy(fixed, prg + 0x6000);
+    prg[0x7FFA] = static_cast<byte_t>(nmi);
+    prg[0x7FFB] = static_cast<byte_t>(nmi >> 8);
+    prg[0x7FFC] = 0x00; // reset
+    prg[0x7FFD] = 0xE0;
+
+    const stdfs::path path = stdfs::temp_directory_path() / "nesemul_test_profiler.nes";
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(image.data()), image.size());
+    return path;
+}
+
+TEST_CASE("Hotspot Profiler Banks", "[profiler]")
+{
+    // Alternates banks 1 and 2 at $8000 and calls $8000 in each
+    constexpr std::array<byte_t, 24> fixed = {
+        0xA9, 0x06, 0x8D, 0x00, 0x80, // LDA #6, STA $8000 (R6, the $8000 bank)
+        0xA9, 0x01, 0x8D, 0x01, 0x80, // LDA #1, STA $8001
+        0x20, 0x00, 0x80, // JSR $8000
+        0xA9, 0x02, 0x8D, 0x01, 0x80, // LDA #2, STA $8001
+        0x20, 0x00, 0x80, // JSR $8000
+        0x4C, 0x00, 0xE0, // JMP $E000
+    };
+
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.read_rom(write_banked_rom(fixed).wstring());
+    emulator.set_profiling(true);
+
+    for (int i = 0; i < 3; ++i)
+        emulator.update();
+
+    const HotspotProfiler& profiler = emulator.get_profiler();
+
+    // Same address, told apart by bank
+    const HotSpot inx = profiler.get_rom(0x2000);
+    const HotSpot nop = profiler.get_rom(0x4000);
+    CHECK(inx.pc_ == 0x8000);
+    CHECK(inx.bank_ == 1);
+    CHECK(nop.pc_ == 0x8000);
+    CHECK(nop.bank_ == 2);
+    CHECK(inx.count_ > 0);
+    CHECK(inx.cycles_ == 2 * inx.count_);
+    CHECK(nop.cycles_ == 2 * nop.count_);
+    CHECK(nop.count_ + 1 >= inx.count_);
+    CHECK(nop.count_ <= inx.count_);
+
+    // JSR $8000 in the fixed bank, 6 cycles
+    const HotSpot jsr = profiler.get_rom(0x600A);
+    CHECK(jsr.bank_ == 3);
+    CHECK(jsr.cycles_ == 6 * jsr.count_);
+
+    // Every cycle since the reset sequence, the current instruction charged in full
+    const uint64_t cycle = emulator.get_cpu()->get_state().cycle_;
+    CHECK(profiler.total_cycles() >= cycle - 7);
+    CHECK(profiler.total_cycles() < cycle);
+
+    const std::vector<HotSpot> top = profiler.top(50);
+    CHECK(top.size() == 14);
+    CHECK(std::ranges::is_sorted(top, std::ranges::greater {}, &HotSpot::cycles_));
+
+    // Off keeps the counts
+    emulator.set_profiling(false);
+    emulator.update();
+    CHECK(profiler.get_rom(0x2000).count_ == inx.count_);
+
+    emulator.get_profiler().clear();
+    CHECK(profiler.total_cycles() == 0);
+    CHECK(profiler.top(50).empty());
+}
+
+TEST_CASE("Hotspot Profiler New Cartridge", "[profiler]")
+{
+    constexpr std::array<byte_t, 3> fixed = { 0x4C, 0x00, 0xE0 }; // JMP $E000
+
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.read_rom(write_banked_rom(fixed).wstring());
+    emulator.set_profiling(true);
+    emulator.update();
+
+    // Off keeps the counts, a new cartridge drops them even off
+    emulator.set_profiling(false);
+    CHECK(emulator.get_profiler().total_cycles() > 0);
+
+    emulator.read_rom(write_banked_rom(fixed).wstring());
+    CHECK(emulator.get_profiler().total_cycles() == 0);
+    CHECK(emulator.get_profiler().top(10).empty());
+
+    emulator.set_profiling(true);
+    CHECK(emulator.get_profiler().get_cart() == emulator.get_cart());
+    emulator.update();
+    CHECK(emulator.get_profiler().get_rom(0x6000).count_ > 0);
+}
+
+TEST_CASE("Call Profiler Stack", "[profiler]")
+{
+    std::array<byte_t, 0x51> fixed {};
+    auto code = [&](address_t addr, std::initializer_list<byte_t> bytes) { std::ranges::copy(bytes, fixed.begin() + (addr - 0xE000)); };
+
+    code(0xE000, { 0xA2, 0xFF, 0x9A }); // LDX #$FF, TXS
+    code(0xE003, { 0xA9, 0x06, 0x8D, 0x00, 0x80, 0xA9, 0x01, 0x8D, 0x01, 0x80 }); // bank 1 at $8000
+    code(0xE00D, { 0xA9, 0x80, 0x8D, 0x00, 0x20 }); // NMI on
+    code(0xE012, { 0x20, 0x20, 0xE0, 0x20, 0x40, 0xE0, 0x4C, 0x12, 0xE0 }); // JSR $E020, JSR $E040, JMP $E012
+
+    // JSR $8000 twice, then a jump table style RTS to $E02D and the real one
+    code(0xE020, { 0x20, 0x00, 0x80, 0x20, 0x00, 0x80, 0xA9, 0xE0, 0x48, 0xA9, 0x2C, 0x48, 0x60, 0x60 });
+
+    // Drops its return address: PLA, PLA, JMP $E012
+    code(0xE040, { 0x68, 0x68, 0x4C, 0x12, 0xE0 });
+
+    code(0xE050, { 0x40 }); // NMI: RTI
+
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.read_rom(write_banked_rom(fixed, 0xE050).wstring());
+    emulator.set_call_profiling(true);
+
+    for (int i = 0; i < 4; ++i)
+        emulator.update();
+
+    CallProfiler& profiler = emulator.get_call_profiler();
+    CHECK(profiler.depth() <= 3);
+
+    const std::vector<CallFunction> functions = profiler.functions();
+    auto find = [&](address_t entry, int bank) -> const CallFunction&
+    {
+        auto it = std::ranges::find_if(functions, [&](const CallFunction& f) { return f.entry_ == entry && f.bank_ == bank; });
+        REQUIRE(it != functions.end());
+        return *it;
+    };
+
+    const CallFunction& outer = find(0xE020, 3);
+    const CallFunction& leaf = find(0x8000, 1);
+    const CallFunction& dropped = find(0xE040, 3);
+    const CallFunction& nmi = find(0xE050, 3);
+
+    CHECK(functions.size() == 4);
+    CHECK(outer.calls_ > 100);
+    CHECK(leaf.calls_ + 2 >= 2 * outer.calls_);
+    CHECK(leaf.calls_ <= 2 * outer.calls_);
+    CHECK(dropped.calls_ + 1 >= outer.calls_);
+    CHECK(nmi.interrupt_);
+    CHECK(nmi.calls_ >= 3);
+
+    // INX and RTS, the last call may be cut short
+    CHECK(leaf.exclusive_ <= 8 * leaf.calls_);
+    CHECK(leaf.exclusive_ + 8 >= 8 * leaf.calls_);
+    CHECK(leaf.inclusive_ >= leaf.exclusive_);
+    CHECK(outer.inclusive_ >= outer.exclusive_ + leaf.exclusive_);
+
+    // The 7 cycles of the interrupt entry and RTI
+    CHECK(nmi.exclusive_ <= 13 * nmi.calls_);
+    CHECK(nmi.exclusive_ + 6 >= 13 * nmi.calls_);
+
+    uint64_t exclusive = 0;
+    for (const CallNode& node : profiler.nodes())
+        exclusive += node.exclusive_;
+    CHECK(exclusive == profiler.total_cycles());
+    CHECK(profiler.nodes()[CallProfiler::root].inclusive_ == profiler.total_cycles());
+
+    std::ostringstream folded;
+    profiler.write_folded(folded);
+    CHECK(folded.str().find("\nreset;03:E020;01:8000 ") != std::string::npos);
+    CHECK(folded.str().find(";int:03:E050 ") != std::string::npos);
+    CHECK(folded.str().find("E040;03:E020") == std::string::npos); // popped by the PLAs
+
+    // A new cartridge drops the tree, also off
+    emulator.set_call_profiling(false);
+    emulator.read_rom(write_banked_rom(fixed, 0xE050).wstring());
+    CHECK(profiler.total_cycles() == 0);
+    CHECK(profiler.nodes().size() == 1);
+    CHECK(profiler.get_cart() == nullptr);
+}
@@ -0,0 +1,53 @@
+#include <catch2/catch_all.hpp>
+
+#include <vector>
+
+#include "rewind.h"
+
+TEST_CASE("Rewind Delta Round Trip", "[rewind]")
+{
+    std::vector<byte_t> previous(1000);
+    for (size_t i = 0; i < previous.size(); ++i)
+        previous[i] = static_cast<byte_t>(i * 7);
+
+    // Sparse changes, short zero gaps and a change at the very end
+    std::vector<byte_t> current = previous;
+    current[0] ^= 0x01;
+    current[10] ^= 0x80;
+    current[12] ^= 0x80;
+    current[500] = 0;
+    current[999] ^= 0xFF;
+
+    std::vector<byte_t> delta(current.size());
+    for (size_t i = 0; i < delta.size(); ++i)
+        delta[i] = current[i] ^ previous[i];
+
+    std::vector<byte_t> encoded;
+    RewindBuffer::encode(delta, encoded);
+    CHECK(encoded.size() < 32);
+
+    std::vector<byte_t> state = previous;
+    CHECK(RewindBuffer::decode_xor(encoded, state));
+    CHECK(state == current);
+
+    // A keyframe decodes over zeros
+    RewindBuffer::encode(current, encoded);
+    std::vector<byte_t> key(current.size());
+    CHECK(RewindBuffer::decode_xor(encoded, key));
+    CHECK(key == current);
+}
+
+TEST_CASE("Rewind Delta Malformed", "[rewind]")
+{
+    std::vector<byte_t> delta(64, 0);
+    delta[40] = 1;
+
+    std::vector<byte_t> encoded;
+    RewindBuffer::encode(delta, encoded);
+
+    std::vector<byte_t> state(64);
+    CHECK_FALSE(RewindBuffer::decode_xor(std::span(encoded).first(encoded.size() - 1), state));
+
+    std::vector<byte_t> small(32);
+    CHECK_FALSE(RewindBuffer::decode_xor(encoded, small));
+}
@@ -0,0 +1,42 @@
+#include <catch2/catch_all.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test_rom_runner.h"
+
+// The accuracy ROMs are not shipped, point NESEMUL_TEST_ROMS at a directory holding them
+// (nestest.nes, blargg's suites...). Expected failures can be listed one file name per line
+// in known_failures.txt at its root.
+TEST_CASE("Accuracy Test ROMs", "[test_roms]")
+{
+    const char* dir = std::getenv("NESEMUL_TEST_ROMS");
+    if (dir == nullptr || !stdfs::is_directory(dir))
+        SKIP("NESEMUL_TEST_ROMS is not set");
+
+    const std::vector<stdfs::path> roms = TestRomRunner::find_roms(dir);
+    REQUIRE_FALSE(roms.empty());
+
+    std::set<std::string> known_failures;
+    std::ifstream ifs(stdfs::path(dir) / "known_failures.txt");
+    for (std::string line; std::getline(ifs, line);)
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        known_failures.insert(line);
+    }
+
+    const std::vector<TestRomResult> results = TestRomRunner().run(roms);
+    for (const TestRomResult& result : results)
+    {
+        INFO(result.rom_.string() << ": " << TestRomRunner::status_name(result.status_) << " " << result.message_);
+
+        if (known_failures.contains(result.rom_.filename().string()))
+            continue;
+
+        CHECK(result.status_ == TestRomStatus::Passed);
+    }
+}
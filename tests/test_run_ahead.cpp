@@ -0,0 +1,122 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "audio_sink.h"
+#include "emulator.h"
+#include "run_ahead.h"
+
+// Keeps every sample pushed
+class CaptureAudioSink final : public AudioSink
+{
+public:
+    CaptureAudioSink()
+        : AudioSink(44100, 0x1000)
+    {
+    }
+
+    std::vector<int16_t> samples_;
+
+protected:
+    void on_push_() override
+    {
+        std::array<int16_t, 0x400> buffer;
+        while (const size_t count = pull(buffer, false))
+            samples_.insert(samples_.end(), buffer.begin(), buffer.begin() + count);
+    }
+};
+
+// NROM, code at $C000 (the reset vector), the NMI handler at $C100
+static stdfs::path write_rom(std::string_view name, std::span<const byte_t> code, std::span<const byte_t> nmi = {})
+{
+    std::vector<byte_t> image(16 + 0x4000 + 0x2000, 0);
+
+    constexpr std::array<byte_t, 8> header = { 'N', 'E', 'S', 0x1A, 1, 1, 0, 0 };
+    std::ranges::copy(header, image.begin());
+
+    byte_t* prg = image.data() + 16;
+    std::ranges::copy(code, prg);
+    std::ranges::copy(nmi, prg + 0x100);
+    prg[0x3FFA] = 0x00; // NMI
+    prg[0x3FFB] = 0xC1;
+    prg[0x3FFC] = 0x00; // reset
+    prg[0x3FFD] = 0xC0;
+
+    const stdfs::path path = stdfs::temp_directory_path() / name;
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(image.data()), image.size());
+    return path;
+}
+
+// A steady square wave on pulse 1
+static stdfs::path write_tone_rom()
+{
+    constexpr std::array<byte_t, 23> code = {
+        0xA9, 0x01, 0x8D, 0x15, 0x40, // LDA #1, STA $4015 (pulse 1 on)
+        0xA9, 0xBF, 0x8D, 0x00, 0x40, // LDA #$BF, STA $4000 (50% duty, length halted, volume 15)
+        0xA9, 0xFD, 0x8D, 0x02, 0x40, // LDA #$FD, STA $4002
+        0xA9, 0x00, 0x8D, 0x03, 0x40, // LDA #0, STA $4003
+        0x4C, 0x14, 0xC0, // JMP $C014
+    };
+
+    return write_rom("nesemul_test_tone.nes", code);
+}
+
+static std::vector<int16_t> capture_audio(const stdfs::path& rom, int run_ahead_frames, bool shadow)
+{
+    CaptureAudioSink sink;
+
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.read_rom(rom.wstring());
+    emulator.set_audio_sink(&sink);
+
+    RunAhead run_ahead(run_ahead_frames, shadow);
+    for (int i = 0; i < 120; ++i)
+        run_ahead.update(emulator);
+
+    emulator.set_audio_sink(nullptr);
+    return std::move(sink.samples_);
+}
+
+TEST_CASE("Run-Ahead Audio", "[run-ahead]")
+{
+    const stdfs::path rom = write_tone_rom();
+
+    const std::vector<int16_t> reference = capture_audio(rom, 0, false);
+    REQUIRE(reference.size() > 44100);
+    CHECK(std::ranges::minmax(reference).max - std::ranges::minmax(reference).min > 1000);
+
+    // The speculative frames are not heard and the rollbacks leave no seam
+    CHECK(capture_audio(rom, 2, false) == reference);
+    CHECK(capture_audio(rom, 2, true) == reference);
+}
+
+TEST_CASE("Run-Ahead Shadow Failure", "[run-ahead]")
+{
+    // Counts the frames in $00 and runs an opcode the CPU doesn't know on the 8th
+    constexpr std::array<byte_t, 12> code = {
+        0xA9, 0x80, 0x8D, 0x00, 0x20, // LDA #$80, STA $2000 (NMI on)
+        0xA5, 0x00, 0xC9, 0x08, 0xD0, 0xFA, // LDA $00, CMP #8, BNE $C005
+        0x02,
+    };
+    constexpr std::array<byte_t, 3> nmi = { 0xE6, 0x00, 0x40 }; // INC $00, RTI
+
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.read_rom(write_rom("nesemul_test_run_ahead_halt.nes", code, nmi).wstring());
+
+    // The speculation gets there first, the real frame is shown instead
+    RunAhead run_ahead(2, true);
+    for (int i = 0; i < 8 && run_ahead.get_stats().failures_ == 0; ++i)
+        run_ahead.update(emulator);
+
+    CHECK(run_ahead.get_stats().failures_ == 1);
+    CHECK(!emulator.is_debugging());
+}
@@ -0,0 +1,135 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "controller.h"
+#include "emulator.h"
+#include "save_state.h"
+
+struct Fields
+{
+    uint16_t a = 0;
+    std::array<byte_t, 3> b = {};
+    bool c : 1 = false;
+};
+
+static void serialize(StateStream& state, Fields& f, std::span<byte_t> memory)
+{
+    state.process(f);
+    state.process(f.a);
+    state.process(memory);
+}
+
+TEST_CASE("StateStream Round Trip", "[save_state]")
+{
+    std::vector<byte_t> buffer;
+    std::array<byte_t, 16> memory;
+    for (size_t i = 0; i < memory.size(); ++i)
+        memory[i] = static_cast<byte_t>(i * 3);
+
+    Fields out { 0x1234, { 1, 2, 3 }, true };
+    StateStream writer(buffer);
+    serialize(writer, out, memory);
+
+    CHECK(writer.good());
+    CHECK(buffer.size() == sizeof(Fields) + sizeof(uint16_t) + memory.size());
+
+    Fields in;
+    std::array<byte_t, 16> restored {};
+    StateStream reader { std::span<const byte_t>(buffer) };
+    serialize(reader, in, restored);
+
+    CHECK(reader.good());
+    CHECK(reader.position() == buffer.size());
+    CHECK(in.a == 0x1234);
+    CHECK(in.b == std::array<byte_t, 3> { 1, 2, 3 });
+    CHECK(in.c);
+    CHECK(restored == memory);
+}
+
+TEST_CASE("StateStream Truncated", "[save_state]")
+{
+    std::vector<byte_t> buffer;
+    uint64_t value = 0x0123456789ABCDEFull;
+    StateStream writer(buffer);
+    writer.process(value);
+
+    buffer.pop_back();
+
+    uint64_t read = 42;
+    StateStream reader { std::span<const byte_t>(buffer) };
+    reader.process(read);
+
+    CHECK_FALSE(reader.good());
+    CHECK(read == 42);
+}
+
+TEST_CASE("Controller Latches Round Trip", "[save_state]")
+{
+    // Latch A, then hold B without a strobe
+    Controller ctrl;
+    ctrl.set_state(Controller::A);
+    ctrl.on_write(0x4016, 1);
+    ctrl.on_write(0x4016, 0);
+    ctrl.set_state(Controller::B);
+
+    std::vector<byte_t> buffer;
+    StateStream writer(buffer);
+    ctrl.serialize_state(writer);
+
+    // Strobed again after the save
+    ctrl.on_write(0x4016, 1);
+    ctrl.on_write(0x4016, 0);
+    CHECK(ctrl.get_strobe_count() == 2);
+
+    StateStream reader { std::span<const byte_t>(buffer) };
+    ctrl.serialize_state(reader);
+
+    CHECK(reader.good());
+    CHECK(ctrl.get_strobe_count() == 1);
+    CHECK(ctrl.get_latched_state() == Controller::A);
+    CHECK(ctrl.get_state() == Controller::B);
+}
+
+TEST_CASE("Load State Corrupted Body", "[save_state]")
+{
+    // NROM counting in $00: INC $00, JMP $C000
+    std::vector<byte_t> image(16 + 0x4000 + 0x2000, 0);
+    constexpr std::array<byte_t, 8> header = { 'N', 'E', 'S', 0x1A, 1, 1, 0, 0 };
+    constexpr std::array<byte_t, 5> code = { 0xE6, 0x00, 0x4C, 0x00, 0xC0 };
+    std::ranges::copy(header, image.begin());
+    std::ranges::copy(code, image.begin() + 16);
+    image[16 + 0x3FFD] = 0xC0;
+
+    const stdfs::path path = stdfs::temp_directory_path() / "nesemul_test_save_state.nes";
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(image.data()), image.size());
+
+    Emulator emulator;
+    emulator.set_verbose(false);
+    emulator.read_rom(path.wstring());
+    emulator.update();
+
+    std::vector<byte_t> blob;
+    emulator.save_state(blob);
+
+    emulator.update();
+    const uint64_t hash = emulator.hash_state();
+
+    // The CHR ROM view of NROM (offset, size, address) is followed by the emulator's cycle
+    // counters (13 bytes), its offset is moved past the ROM
+    std::vector<byte_t> corrupted = blob;
+    const int32_t offset = 0x7FFFFF00;
+    std::memcpy(corrupted.data() + corrupted.size() - 13 - 10, &offset, sizeof(offset));
+
+    CHECK_THROWS_AS(emulator.load_state(corrupted), std::runtime_error);
+    CHECK(emulator.hash_state() == hash);
+
+    // Still loads a good one
+    emulator.load_state(blob);
+    CHECK(emulator.hash_state() != hash);
+}
@@ -0,0 +1,58 @@
+#include <catch2/catch_all.hpp>
+
+#include <sstream>
+
+#include "trace_diff.h"
+
+TEST_CASE("Trace Line Parsing", "[trace]")
+{
+    TraceRecord nestest;
+    REQUIRE(TraceRecord::parse("C72C  20 F5 C5  JSR $C5F5                       A:CB X:00 Y:00 P:E4 SP:FB PPU:  1,  5 CYC:29", nestest));
+    CHECK(nestest.pc_ == 0xC72C);
+    CHECK(nestest.size_ == 3);
+    CHECK(nestest.bytes_[2] == 0xC5);
+    CHECK(nestest.a_ == 0xCB);
+    CHECK(nestest.p_ == 0xE4);
+    CHECK(nestest.sp_ == 0xFB);
+    CHECK(nestest.cycle_ == 29u);
+
+    // CPU::log_ layout, with a mnemonic that looks like hex
+    TraceRecord own;
+    REQUIRE(TraceRecord::parse("c5f5    ca          DEC                             A:cb X:00 Y:00 P:e4 SP:f9 CYC:40", own));
+    CHECK(own.pc_ == 0xC5F5);
+    CHECK(own.size_ == 1);
+    CHECK(own.sp_ == 0xF9);
+
+    TraceRecord bad;
+    CHECK_FALSE(TraceRecord::parse("nestest log", bad));
+}
+
+TEST_CASE("Trace Diff Stops At First Divergence", "[trace]")
+{
+    std::istringstream reference(
+        "C000  4C F5 C5  JMP $C5F5  A:00 X:00 Y:00 P:24 SP:FD CYC:7\n"
+        "C5F5  A2 00     LDX #$00   A:00 X:00 Y:00 P:24 SP:FD CYC:10\n"
+        "C5F7  86 00     STX $00    A:00 X:00 Y:00 P:26 SP:FD CYC:12\n"
+        "C5F9  86 10     STX $10    A:00 X:00 Y:00 P:26 SP:FD CYC:15\n");
+
+    TraceDiff diff(reference);
+    int stops = 0;
+    diff.set_on_stop([&] { ++stops; });
+
+    // The cycle offset is taken from the first line
+    diff.on_instruction("c000    4c  f5  c5 JMP  A:00 X:00 Y:00 P:24 SP:fd CYC:6");
+    diff.on_instruction("c5f5    a2  00     LDX  A:00 X:00 Y:00 P:24 SP:fd CYC:9");
+    CHECK_FALSE(diff.is_stopped());
+
+    diff.on_instruction("c5f7    86  00     STX  A:00 X:00 Y:00 P:24 SP:fd CYC:11");
+    REQUIRE(diff.has_diverged());
+    CHECK(stops == 1);
+    CHECK(diff.matched_lines() == 2);
+    CHECK(diff.divergence()->line_ == 3);
+    CHECK(diff.divergence()->field_ == "P");
+    CHECK(diff.divergence()->before_.size() == 2);
+    CHECK(diff.divergence()->after_.size() == 1);
+
+    diff.on_instruction("c5f9    86  10     STX  A:00 X:00 Y:00 P:26 SP:fd CYC:14");
+    CHECK(stops == 1);
+}